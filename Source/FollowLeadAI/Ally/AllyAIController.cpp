@@ -1,18 +1,70 @@
 #include "AllyAIController.h"
 #include "AllyCharacter.h"
+#include "AllyCrowdSubsystem.h"
+#include "AllyStats.h"
 #include "../WaypointActor.h"
+#include "../WaypointGraphSubsystem.h"
+#include "../WaypointRegistrySubsystem.h"
 #include "../Player/PlayerCharacter.h"
 #include "Tasks/AITask_MoveTo.h"
 #include "GameFramework/Character.h"
 #include "Kismet/GameplayStatics.h"
 #include "Kismet/KismetMathLibrary.h"
+#include "NavigationSystem.h"
+#include "HAL/IConsoleManager.h"
+#include "Navigation/CrowdFollowingComponent.h"
 #include "Navigation/PathFollowingComponent.h"
 #include "GameFramework/CharacterMovementComponent.h"
 
+// The seed of every AllyAIController's random choices, 0 picks a different seed every run.
+static TAutoConsoleVariable<int32> CVarAllyRandomSeed(
+	TEXT("ally.Random.Seed"),
+	0,
+	TEXT("The seed of the allies' random choices so that runs can be repeated. 0 picks a different seed every run."),
+	ECVF_Default);
+
+// How strongly allies that use crowd avoidance push away from the allies around them.
+static TAutoConsoleVariable<float> CVarAllyAvoidanceSeparationWeight(
+	TEXT("ally.Avoidance.SeparationWeight"),
+	2.f,
+	TEXT("How strongly allies that use crowd avoidance push away from the allies around them."),
+	ECVF_Default);
+
+// How far, in units, allies that use crowd avoidance look for neighbours to avoid.
+static TAutoConsoleVariable<float> CVarAllyAvoidanceNeighborRange(
+	TEXT("ally.Avoidance.NeighborRange"),
+	400.f,
+	TEXT("How far allies that use crowd avoidance look for neighbours in the crowd's grid. Smaller is cheaper in dense groups."),
+	ECVF_Default);
+
+// How long, in seconds, an ally waits before repathing after its first failed move. Every
+// further failure in a row doubles the wait up to `ally.Move.MaxFailureBackoff`.
+static TAutoConsoleVariable<float> CVarAllyMoveFailureBackoff(
+	TEXT("ally.Move.FailureBackoff"),
+	0.25f,
+	TEXT("How long an ally waits before repathing after a failed move. Doubles with every failure in a row."),
+	ECVF_Default);
+
+// The longest time, in seconds, an ally waits before repathing after failed moves in a row.
+static TAutoConsoleVariable<float> CVarAllyMoveMaxFailureBackoff(
+	TEXT("ally.Move.MaxFailureBackoff"),
+	2.f,
+	TEXT("The longest an ally waits before repathing after failed moves."),
+	ECVF_Default);
+
+// How far, in units, the PlayerCharacter can move away from the goal of a follow move along a
+// prebuilt path before the move is restarted.
+static TAutoConsoleVariable<float> CVarAllyFollowGoalTether(
+	TEXT("ally.Follow.GoalTether"),
+	100.f,
+	TEXT("How far the PlayerCharacter can move before an ally following a cached or shared path repaths, like a regular move request to an actor does."),
+	ECVF_Default);
+
 /**
  * Sets up the default values for the AllyAIController.
  */
-AAllyAIController::AAllyAIController()
+AAllyAIController::AAllyAIController(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer.SetDefaultSubobjectClass<UCrowdFollowingComponent>(TEXT("PathFollowingComponent")))
 {
 	// Starts the AI logic for this AIController as soon as the AllyCharacter
 	// is taken over so that we can issue commands immediately.
@@ -26,13 +78,242 @@ void AAllyAIController::BeginPlay()
 {
 	Super::BeginPlay();
 
-	// Set up the response to the PlayerCharacter's `OnAllyLeadRequest` delegate.
-	AllyCharacter->PlayerCharacter->OnAllyLeadRequest.AddDynamic(this, &AAllyAIController::MakeAllyLead);
+	// Hand the recurring follow, sprint, and lead tasks over to the AllyCrowdSubsystem
+	// so that they get run in the batched update with every other ally.
+	CrowdSubsystem = GetWorld()->GetSubsystem<UAllyCrowdSubsystem>();
+	if (CrowdSubsystem != nullptr) CrowdSubsystem->RegisterAlly(this);
+
+	SeedRandomStream();
+
+	// Look waypoints up in the registry shared by every AllyCharacter.
+	WaypointRegistry = GetWorld()->GetSubsystem<UWaypointRegistrySubsystem>();
+
+	// AllyCharacters placed in the level are taken over before play begins. Ones that are
+	// spawned during play are taken over afterwards and get started from `OnPossess` instead.
+	if (AllyCharacter != nullptr) StartAllyBehavior();
+}
+
+/**
+ * Called once the AllyAIController has started and taken over the AllyCharacter to
+ * start following the PlayerCharacter.
+ */
+void AAllyAIController::StartAllyBehavior()
+{
+	SetUpCrowdAvoidance();
+
+	// Return early if the PlayerCharacter hasn't been assigned to the AllyCharacter.
+	if (AllyCharacter->PlayerCharacter == nullptr) return;
+
+	BindToPlayerCharacter();
 
 	// Move the AllyCharacter to the PlayerCharacter from the start.
 	MoveToPlayerCharacter();
 }
 
+/**
+ * Joins the PlayerCharacter's follow group and binds to its delegates.
+ */
+void AAllyAIController::BindToPlayerCharacter()
+{
+	APlayerCharacter* PlayerCharacter = AllyCharacter->PlayerCharacter;
+	if (PlayerCharacter == nullptr) return;
+
+	// Join the group of allies that share one path to the PlayerCharacter if the
+	// AllyCharacter is set up to follow as part of a group.
+	if (CrowdSubsystem != nullptr && AllyCharacter->bUseGroupFollow) CrowdSubsystem->JoinFollowGroup(this, PlayerCharacter);
+
+	// Set up the response to the PlayerCharacter's `OnAllyLeadRequest` delegate.
+	PlayerCharacter->OnAllyLeadRequest.AddUniqueDynamic(this, &AAllyAIController::MakeAllyLead);
+
+	// Set up the response to the PlayerCharacter starting or stopping moving.
+	PlayerCharacter->OnPlayerMovingChanged.AddUniqueDynamic(this, &AAllyAIController::OnPlayerMovingChanged);
+}
+
+/**
+ * Leaves the PlayerCharacter's follow group and unbinds from its delegates.
+ */
+void AAllyAIController::UnbindFromPlayerCharacter()
+{
+	APlayerCharacter* PlayerCharacter = AllyCharacter != nullptr ? AllyCharacter->PlayerCharacter : nullptr;
+	if (PlayerCharacter == nullptr) return;
+
+	if (CrowdSubsystem != nullptr) CrowdSubsystem->LeaveFollowGroup(this, PlayerCharacter);
+
+	PlayerCharacter->OnAllyLeadRequest.RemoveDynamic(this, &AAllyAIController::MakeAllyLead);
+	PlayerCharacter->OnPlayerMovingChanged.RemoveDynamic(this, &AAllyAIController::OnPlayerMovingChanged);
+}
+
+/**
+ * Seeds `RandomStream` with `ally.Random.Seed` and the AllyAIController's `CrowdIndex`.
+ */
+void AAllyAIController::SeedRandomStream()
+{
+	// Seed the random choices with the order the allies registered in so that every
+	// ally gets a different stream that is the same from run to run.
+	const int32 Seed = CVarAllyRandomSeed.GetValueOnGameThread();
+	RandomStream.Initialize(Seed != 0 ? int32(HashCombine(uint32(Seed), uint32(CrowdIndex))) : FMath::Rand());
+}
+
+/**
+ * Turns the crowd simulation on or off for the AllyCharacter depending on its
+ * `bUseCrowdAvoidance`. This must be called while the AllyCharacter isn't moving.
+ */
+void AAllyAIController::SetUpCrowdAvoidance()
+{
+	UCrowdFollowingComponent* CrowdFollowing = Cast<UCrowdFollowingComponent>(GetPathFollowingComponent());
+	if (CrowdFollowing == nullptr || AllyCharacter == nullptr) return;
+
+	CrowdFollowing->SetCrowdSimulationState(AllyCharacter->bUseCrowdAvoidance ? ECrowdSimulationState::Enabled : ECrowdSimulationState::Disabled);
+	if (!AllyCharacter->bUseCrowdAvoidance) return;
+
+	// The crowd keeps its agents in a grid so each ally only looks at the neighbours
+	// within the query range, and separation keeps allies following the same
+	// PlayerCharacter from bunching up behind them.
+	CrowdFollowing->SetCrowdSeparation(true, false);
+	CrowdFollowing->SetCrowdSeparationWeight(CVarAllyAvoidanceSeparationWeight.GetValueOnGameThread(), false);
+	CrowdFollowing->SetCrowdCollisionQueryRange(CVarAllyAvoidanceNeighborRange.GetValueOnGameThread(), false);
+
+	// Start at the quality of the AllyCharacter's current tier, which also pushes the
+	// settings above to the crowd agent, rather than at the highest quality until the
+	// AllyCrowdSubsystem next changes its tier.
+	UpdateCrowdAvoidanceQuality(AllyCharacter->LODTier);
+}
+
+/**
+ * Returns whether the AllyCharacter is being steered by the crowd simulation.
+ */
+bool AAllyAIController::IsUsingCrowdAvoidance() const
+{
+	const UCrowdFollowingComponent* CrowdFollowing = Cast<UCrowdFollowingComponent>(GetPathFollowingComponent());
+	return CrowdFollowing != nullptr && CrowdFollowing->IsCrowdSimulationEnabled();
+}
+
+/**
+ * Sets how carefully the crowd simulation steers the AllyCharacter around its neighbours.
+ *
+ * @param Tier The AllyCharacter's EAllyLODTier.
+ */
+void AAllyAIController::UpdateCrowdAvoidanceQuality(EAllyLODTier Tier)
+{
+	if (!IsUsingCrowdAvoidance()) return;
+
+	UCrowdFollowingComponent* CrowdFollowing = Cast<UCrowdFollowingComponent>(GetPathFollowingComponent());
+
+	switch (Tier)
+	{
+	case EAllyLODTier::HIGH: CrowdFollowing->SetCrowdAvoidanceQuality(ECrowdAvoidanceQuality::High); break;
+	case EAllyLODTier::MEDIUM: CrowdFollowing->SetCrowdAvoidanceQuality(ECrowdAvoidanceQuality::Medium); break;
+	default: CrowdFollowing->SetCrowdAvoidanceQuality(ECrowdAvoidanceQuality::Low); break;
+	}
+}
+
+/**
+ * Moves along a path that was put together from points, or makes a regular move request
+ * that finds its own path if the AllyCharacter is steered by the crowd simulation.
+ *
+ * @param MoveRequest The move request.
+ * @param Path The path to move along.
+ */
+void AAllyAIController::RequestMoveAlongPoints(const FAIMoveRequest& MoveRequest, FNavPathSharedPtr Path)
+{
+	if (!IsUsingCrowdAvoidance())
+	{
+		RequestMove(MoveRequest, Path);
+		return;
+	}
+
+	MoveTo(MoveRequest);
+	FAllyAICounters::Increment(EAllyAICounter::PathQueries);
+}
+
+/**
+ * Returns how long to wait before repathing after `ConsecutiveFailedMoves` failed moves.
+ */
+float AAllyAIController::GetFailedMoveBackoff() const
+{
+	if (ConsecutiveFailedMoves <= 0) return 0.f;
+
+	const float Backoff = CVarAllyMoveFailureBackoff.GetValueOnGameThread() * (1 << FMath::Min(ConsecutiveFailedMoves - 1, 8));
+	return FMath::Min(Backoff, CVarAllyMoveMaxFailureBackoff.GetValueOnGameThread());
+}
+
+/**
+ * Switches the PlayerCharacter that the AllyCharacter follows and leads.
+ *
+ * @param NewPlayerCharacter The PlayerCharacter to follow.
+ */
+void AAllyAIController::SetPlayerCharacter(APlayerCharacter* NewPlayerCharacter)
+{
+	if (AllyCharacter == nullptr || AllyCharacter->PlayerCharacter == NewPlayerCharacter) return;
+
+	UnbindFromPlayerCharacter();
+	AllyCharacter->PlayerCharacter = NewPlayerCharacter;
+
+	// The previous path led to the old PlayerCharacter.
+	PathCache.Invalidate();
+
+	if (!HasActorBegunPlay() || NewPlayerCharacter == nullptr) return;
+
+	BindToPlayerCharacter();
+
+	// A following AllyCharacter heads for its new PlayerCharacter straight away while a
+	// leading one finishes its lead first.
+	if (AllyCharacter->State == AllyStates::FOLLOW) StartFollowingPlayer();
+}
+
+/**
+ * Called by the AllyPoolSubsystem when a pooled AllyCharacter is put back in the world.
+ *
+ * @param NewPlayerCharacter The PlayerCharacter to follow.
+ */
+void AAllyAIController::ActivateAlly(APlayerCharacter* NewPlayerCharacter)
+{
+	if (AllyCharacter == nullptr) return;
+
+	if (CrowdSubsystem != nullptr) CrowdSubsystem->RegisterAlly(this);
+	SeedRandomStream();
+
+	AllyCharacter->PlayerCharacter = NewPlayerCharacter;
+	StartAllyBehavior();
+}
+
+/**
+ * Called by the AllyPoolSubsystem when the AllyCharacter is returned to the pool.
+ */
+void AAllyAIController::DeactivateAlly()
+{
+	StopMovement();
+
+	UnbindFromPlayerCharacter();
+
+	// Unregistering drops every task the AllyCrowdSubsystem was running for the ally.
+	if (CrowdSubsystem != nullptr) CrowdSubsystem->UnregisterAlly(this);
+
+	ClearLeadRoute();
+	PathCache.Invalidate();
+	bIsWaitingForPlayerToMove = false;
+	ConsecutiveFailedMoves = 0;
+
+	if (AllyCharacter != nullptr)
+	{
+		AllyCharacter->ResetAllyState();
+		AllyCharacter->PlayerCharacter = nullptr;
+	}
+}
+
+/**
+ * Called when the AllyAIController is removed from the world.
+ *
+ * @param EndPlayReason Why the AllyAIController is being removed.
+ */
+void AAllyAIController::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UnbindFromPlayerCharacter();
+	if (CrowdSubsystem != nullptr) CrowdSubsystem->UnregisterAlly(this);
+
+	Super::EndPlay(EndPlayReason);
+}
+
 /**
  * Called when the AllyAIController takes over the AllyCharacter.
  *
@@ -45,6 +326,10 @@ void AAllyAIController::OnPossess(APawn* AllyPawn)
 	// Attempt to cast the Pawn that was taken over to an AllyCharacter and if
 	// successful then we assign it to our `AllyCharacter` variable.
 	AllyCharacter = Cast<AAllyCharacter>(AllyPawn);
+
+	// If the AllyCharacter was spawned during play then `BeginPlay` has already run
+	// without it so the AllyCharacter's behavior is started here.
+	if (AllyCharacter != nullptr && HasActorBegunPlay()) StartAllyBehavior();
 }
 
 /**
@@ -52,144 +337,304 @@ void AAllyAIController::OnPossess(APawn* AllyPawn)
  */
 void AAllyAIController::OnMoveCompleted(FAIRequestID RequestID, const FPathFollowingResult& Result)
 {
+	ALLY_AI_SCOPE(STAT_AllyOnMoveCompleted);
+
 	Super::OnMoveCompleted(RequestID, Result);
 
+	// A move that was replaced by a newer one didn't end, the newer one just took over.
+	if (Result.HasFlag(FPathFollowingResultFlags::NewRequest)) return;
+
+	// A failed move means the previous path can't be trusted anymore. Being stopped on
+	// purpose doesn't count as failing.
+	const bool bDidMoveFail = Result.IsFailure() && !Result.HasFlag(FPathFollowingResultFlags::UserAbort);
+	if (Result.IsFailure()) PathCache.Invalidate();
+
+	if (bDidMoveFail)
+	{
+		++ConsecutiveFailedMoves;
+		FAllyAICounters::Increment(EAllyAICounter::FailedMoves);
+	}
+	else if (Result.IsSuccess())
+	{
+		ConsecutiveFailedMoves = 0;
+	}
+
 	if (AllyCharacter->State == AllyStates::FOLLOW)
 	{
+		// An AllyCharacter that is stuck would otherwise fail and repath straight away over
+		// and over, so it waits a little longer after every failure in a row.
+		if (bDidMoveFail && CrowdSubsystem != nullptr)
+		{
+			CrowdSubsystem->RequestFollowRepath(this, GetFailedMoveBackoff());
+			return;
+		}
+
 		// Check to see if the AllyCharacter is moving with a simple velocity check.
 		bool bIsAllyCharacterMoving = AllyCharacter->GetCharacterMovement()->Velocity.Size() > 0.f;
 
 		if (bIsAllyCharacterMoving)
 		{
 			// If the AllyCharacter is moving then it means that the PlayerCharacter is still moving
-			// so we call `MoveToPlayerCharacter` to keep moving towards the PlayerCharacter.
-			MoveToPlayerCharacter();
+			// so we keep moving towards the PlayerCharacter. The AllyCrowdSubsystem holds the repath
+			// back a little for allies that are far from the camera or off screen.
+			if (CrowdSubsystem != nullptr) CrowdSubsystem->RequestFollowRepath(this);
+			else MoveToPlayerCharacter();
 		}
 		else
 		{
-			UWorld* World = GetWorld();
-			if (World == nullptr) return;
-
 			// Otherwise if the AllyCharacter is no longer moving then `OnMoveCompleted` will not run
-			// again so we need to set up a repeating timer that checks to see if the PlayerCharacter
-			// has started moving again and if so we cancel this timer and call `MoveToPlayerCharacter`
-			// which just restarts this whole process.
-			World->GetTimerManager().SetTimer(AllyFollowTimer, this, &AAllyAIController::CheckIfPlayerIsMoving, 0.05f, true);
-			World->GetTimerManager().ClearTimer(AllySprintTimer);
+			// again so we wait for the PlayerCharacter's `OnPlayerMovingChanged` to tell us that they
+			// started moving again and then call `MoveToPlayerCharacter` which just restarts this
+			// whole process. Waiting costs nothing while the PlayerCharacter is standing still.
+			bIsWaitingForPlayerToMove = true;
+			if (CrowdSubsystem != nullptr) CrowdSubsystem->SetTaskActive(this, EAllyCrowdTask::Sprint, false);
+
+			// If the PlayerCharacter is already moving then the event has already been broadcast
+			// so we start following them straight away.
+			if (AllyCharacter->PlayerCharacter != nullptr && AllyCharacter->PlayerCharacter->bIsMoving) StartFollowingPlayer();
 		}
 	}
 	else if (AllyCharacter->State == AllyStates::LEAD)
 	{
 		if (AllyCharacter->CurrentWaypoint == AllyCharacter->EndWaypoint && AllyCharacter->bIsAtCurrentWaypoint)
 		{
-			// If the AllyCharacter is at the last waypoint then we can clear the lead timer and set
+			// If the AllyCharacter is at the last waypoint then we can stop the lead task and set
 			// them back to the FOLLOW state.
-			GetWorld()->GetTimerManager().ClearTimer(AllyLeadTimer);
+			if (CrowdSubsystem != nullptr) CrowdSubsystem->SetTaskActive(this, EAllyCrowdTask::Lead, false);
 			AllyCharacter->State = AllyStates::FOLLOW;
+			FAllyAICounters::Increment(EAllyAICounter::StateTransitions);
+			ClearLeadRoute();
 
 			// Set the AllyCharacter to move to the PlayerCharacter again to keep the follow loop going.
 			MoveToPlayerCharacter();
 		}
 		else if (AllyCharacter->bIsAtCurrentWaypoint)
 		{
-			// Otherwise we set the AllyCharacter to move to the next waypoint.
-			AllyCharacter->CurrentWaypoint = AllyCharacter->Waypoints[AllyCharacter->CurrentWaypoint->WaypointNumber + 1];
+			// Otherwise we set the AllyCharacter to move to the next waypoint. If the route has been
+			// planned then the next waypoint is the next one along the route. Until then we just go
+			// to the next registered WaypointActor towards the `EndWaypoint`, skipping any gaps.
+			AWaypointActor* NextWaypoint = nullptr;
+			if (LeadRoute.WaypointNumbers.IsValidIndex(LeadRouteIndex + 1))
+			{
+				NextWaypoint = WaypointRegistry != nullptr ? WaypointRegistry->FindWaypoint(LeadRoute.WaypointNumbers[++LeadRouteIndex]) : nullptr;
+			}
+			else if (WaypointRegistry != nullptr && AllyCharacter->EndWaypoint != nullptr)
+			{
+				NextWaypoint = WaypointRegistry->FindNextWaypoint(AllyCharacter->CurrentWaypoint->WaypointNumber, AllyCharacter->EndWaypoint->WaypointNumber);
+			}
+			if (NextWaypoint == nullptr) return;
+
+			AllyCharacter->CurrentWaypoint = NextWaypoint;
 			AllyCharacter->bIsAtCurrentWaypoint = false;
 		}
 	}
 }
 
 /**
- * Called to move the AllyCharacter to the PlayerCharacter.
+ * Called to move the AllyCharacter to the PlayerCharacter. The move is queued with the
+ * AllyCrowdSubsystem and sent once it fits in the frame's path query budget.
  */
 void AAllyAIController::MoveToPlayerCharacter()
 {
 	// Return early if the PlayerCharacter hasn't been assigned to the AllyCharacter.
 	if (AllyCharacter->PlayerCharacter == nullptr) return;
 
+	if (CrowdSubsystem != nullptr && CrowdSubsystem->QueueMove(this, EAllyQueuedMove::Follow)) return;
+
+	SendMoveToPlayerCharacter();
+}
+
+/**
+ * Sends the move to the PlayerCharacter straight away.
+ */
+void AAllyAIController::SendMoveToPlayerCharacter()
+{
+	ALLY_AI_SCOPE(STAT_AllyMoveToPlayerCharacter);
+
+	// The AllyCharacter may have lost its PlayerCharacter or started leading while the move was queued.
+	if (AllyCharacter == nullptr || AllyCharacter->PlayerCharacter == nullptr || AllyCharacter->State != AllyStates::FOLLOW) return;
+
+	// If the AllyCharacter follows as part of a group then it walks along the group's
+	// shared path to its own formation slot, which already keeps it between
+	// `MinDistanceFromPlayer` and `MaxDistanceFromPlayer`.
+	if (AllyCharacter->bUseGroupFollow && CrowdSubsystem != nullptr)
+	{
+		FNavPathSharedPtr GroupPath;
+		FVector SlotLocation;
+
+		if (CrowdSubsystem->FindFollowGroupPath(this, AllyCharacter->PlayerCharacter, GroupPath, SlotLocation))
+		{
+			FAIMoveRequest SlotMoveRequest(SlotLocation);
+			SlotMoveRequest.SetAcceptanceRadius(FAllyFollowGroup::SlotSpacing * 0.5f);
+
+			RequestMoveAlongPoints(SlotMoveRequest, GroupPath);
+			FollowPathPlayerLocation = AllyCharacter->PlayerCharacter->GetNavAgentLocation();
+			FAllyAICounters::Increment(EAllyAICounter::MoveRequests);
+			return;
+		}
+	}
+
 	// Get a random value between `MinDistanceFromPlayer` and `MaxDistanceFromPlayer` to use
 	// as the second parameter.
-	float AcceptanceRadius = UKismetMathLibrary::RandomFloatInRange(AllyCharacter->MinDistanceFromPlayer, AllyCharacter->MaxDistanceFromPlayer);
+	float AcceptanceRadius = RandomStream.FRandRange(AllyCharacter->GetMinDistanceFromPlayer(), AllyCharacter->GetMaxDistanceFromPlayer());
+
+	FAIMoveRequest MoveRequest(AllyCharacter->PlayerCharacter);
+	MoveRequest.SetAcceptanceRadius(AcceptanceRadius);
+
+	FVector GoalLocation = AllyCharacter->PlayerCharacter->GetNavAgentLocation();
+
+	// If the AllyCharacter follows predictively then it heads for where the PlayerCharacter is
+	// going to be instead. The predicted location can be off the navmesh, such as inside a wall
+	// the PlayerCharacter is about to turn away from, in which case it falls back to the PlayerCharacter.
+	if (AllyCharacter->bUsePredictiveFollow)
+	{
+		const FVector PredictedLocation = AllyCharacter->PlayerCharacter->PredictLocation(AllyCharacter->GetFollowPredictionTime());
+
+		UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+		FNavLocation PredictedNavLocation;
+		if (NavSys != nullptr && NavSys->ProjectPointToNavigation(PredictedLocation, PredictedNavLocation))
+		{
+			GoalLocation = PredictedNavLocation.Location;
+			MoveRequest.SetGoalLocation(GoalLocation);
+		}
+	}
+
+	// Get the path to the PlayerCharacter from the PathCache, which reuses the previous
+	// path if the PlayerCharacter has barely moved since we last asked. The crowd simulation
+	// can't steer along a reused path so there's no point asking for one.
+	FNavPathSharedPtr Path;
+	if (!IsUsingCrowdAvoidance()) Path = PathCache.FindPath(this, AllyCharacter->GetNavAgentLocation(), GoalLocation);
+
+	// Move to the PlayerCharacter within the AcceptanceRadius, falling back to a regular
+	// move request if the PathCache couldn't come up with a path.
+	if (Path.IsValid()) RequestMove(MoveRequest, Path);
+	else MoveTo(MoveRequest);
+
+	// Only a regular move request to the PlayerCharacter repaths by itself when they move, so
+	// any other move has to be restarted by the AllyCrowdSubsystem once they get too far away.
+	const bool bIsObservingPlayer = !Path.IsValid() && MoveRequest.IsMoveToActorRequest();
+	FollowPathPlayerLocation = bIsObservingPlayer ? FAISystem::InvalidLocation : AllyCharacter->PlayerCharacter->GetNavAgentLocation();
+
+	// A regular move request finds its own path.
+	FAllyAICounters::Increment(EAllyAICounter::MoveRequests);
+	if (!Path.IsValid()) FAllyAICounters::Increment(EAllyAICounter::PathQueries);
+}
+
+/**
+ * Returns whether the AllyCharacter is following a path that doesn't repath by itself and the
+ * PlayerCharacter has moved more than `ally.Follow.GoalTether` since it was sent.
+ */
+bool AAllyAIController::HasPlayerLeftFollowPath() const
+{
+	if (!FAISystem::IsValidLocation(FollowPathPlayerLocation) || AllyCharacter->PlayerCharacter == nullptr) return false;
+	if (GetMoveStatus() != EPathFollowingStatus::Moving) return false;
 
-	// Move to the PlayerCharacter within the AcceptanceRadius.
-	MoveToActor(AllyCharacter->PlayerCharacter, AcceptanceRadius);
+	const float TetherSquared = FMath::Square(CVarAllyFollowGoalTether.GetValueOnGameThread());
+	return FVector::DistSquared(AllyCharacter->PlayerCharacter->GetNavAgentLocation(), FollowPathPlayerLocation) > TetherSquared;
 }
 
 /**
- * Called to move the AllyCharacter to a WaypointActor.
+ * Called by the AllyCrowdSubsystem's lead task to move the AllyCharacter to its
+ * `CurrentWaypoint`. Movement is only started or stopped when the PlayerCharacter
+ * leaves or comes back within `MaxDistanceFromPlayerWhileLeading`, when the
+ * AllyCharacter moves on to another WaypointActor, or when the last move ended.
+ *
+ * @param bShouldWaitForPlayer Whether the PlayerCharacter is too far behind and the AllyCharacter should wait for them.
  */
-void AAllyAIController::MoveToWaypoint()
+void AAllyAIController::MoveToWaypoint(bool bShouldWaitForPlayer)
 {
 	// Make sure that this is only called when the AllyCharacter is in the
 	// LEAD state.
 	if (AllyCharacter->State != AllyStates::LEAD) return;
 
-	// If `AllyCharacter->bShouldWaitForPlayerWhenLeading` is true then we need to check
-	// to see if the PlayerCharacter is too far from the AllyCharacter and if so then we
-	// stop movement until the PlayerCharacter gets closer. Otherwise we just continue to
-	// the WaypointActor.
-	float AllyDistanceFromPlayer = AllyCharacter->GetDistanceTo(AllyCharacter->PlayerCharacter);
-	if (AllyCharacter->bShouldWaitForPlayerWhenLeading && AllyDistanceFromPlayer >= AllyCharacter->MaxDistanceFromPlayerWhileLeading)
+	// The AllyCrowdSubsystem has already checked whether `AllyCharacter->bShouldWaitForPlayerWhenLeading`
+	// is true and the PlayerCharacter is too far from the AllyCharacter. If so then we stop movement
+	// until the PlayerCharacter gets closer. Otherwise we just continue to the WaypointActor.
+	if (bShouldWaitForPlayer)
 	{
+		// Stopping once is enough, the AllyCharacter stays put until the PlayerCharacter catches up.
+		if (bIsWaitingForPlayerWhileLeading) return;
+
+		// A move to the WaypointActor that hasn't been sent yet would start it moving again.
+		bIsWaitingForPlayerWhileLeading = true;
+		if (CrowdSubsystem != nullptr) CrowdSubsystem->CancelQueuedMove(this);
 		StopMovement();
 	}
 	else
 	{
-		MoveToActor(AllyCharacter->CurrentWaypoint);
+		// Nothing has changed if the AllyCharacter is still on its way to the same WaypointActor,
+		// so sending the same move request again would only cost another path.
+		const bool bIsMovingToCurrentWaypoint = LeadMoveWaypoint == AllyCharacter->CurrentWaypoint && GetMoveStatus() == EPathFollowingStatus::Moving;
+		if (!bIsWaitingForPlayerWhileLeading && bIsMovingToCurrentWaypoint) return;
+
+		bIsWaitingForPlayerWhileLeading = false;
+		LeadMoveWaypoint = AllyCharacter->CurrentWaypoint;
+
+		if (CrowdSubsystem != nullptr && CrowdSubsystem->QueueMove(this, EAllyQueuedMove::Lead)) return;
+
+		SendMoveToWaypoint();
 	}
 }
 
 /**
- * Called by the `AllyFollowTimer` to check to see if the PlayerCharacter is
- * is moving or not.
+ * Sends the move to the `CurrentWaypoint` straight away, unless the AllyCharacter has
+ * stopped leading or started waiting for the PlayerCharacter since it was queued.
  */
-void AAllyAIController::CheckIfPlayerIsMoving()
+void AAllyAIController::SendMoveToWaypoint()
 {
-	// Check to see if the PlayerCharacter is moving by a simple velocity check.
-	bool bIsPlayerCharacterMoving = AllyCharacter->PlayerCharacter->GetCharacterMovement()->Velocity.Size() > 0.f;
+	ALLY_AI_SCOPE(STAT_AllyMoveToWaypoint);
 
-	if (bIsPlayerCharacterMoving)
+	if (AllyCharacter == nullptr || AllyCharacter->State != AllyStates::LEAD || AllyCharacter->CurrentWaypoint == nullptr || bIsWaitingForPlayerWhileLeading) return;
+
+	// If the route has been planned then follow its precomputed navmesh path to the
+	// `CurrentWaypoint` so that no path query is needed. Otherwise move to the
+	// WaypointActor like normal.
+	TArray<FVector> LegPoints;
+	TArray<FVector> PointsAhead;
+	if (LeadRoute.GetLegPoints(LeadRouteIndex, LegPoints) && FAllyPathCache::GetPointsAhead(LegPoints, AllyCharacter->GetNavAgentLocation(), PointsAhead))
 	{
-		UWorld* World = GetWorld();
-		if (World == nullptr) return;
+		FNavPathSharedPtr LegPath = MakeShared<FNavigationPath, ESPMode::ThreadSafe>(PointsAhead);
+		LegPath->MarkReady();
 
-		// Clear the timer as the movement is going to get handled by the `OnMoveCompleted`
-		// method until the AllyCharacter stops moving again.
-		World->GetTimerManager().ClearTimer(AllyFollowTimer);
+		RequestMoveAlongPoints(FAIMoveRequest(AllyCharacter->CurrentWaypoint), LegPath);
+	}
+	else
+	{
+		MoveToActor(AllyCharacter->CurrentWaypoint);
+		FAllyAICounters::Increment(EAllyAICounter::PathQueries);
+	}
 
-		// Set the timer that manages the AllyCharacter's movement properties such as walking
-		// and sprinting.
-		World->GetTimerManager().SetTimer(AllySprintTimer, this, &AAllyAIController::ManageAllySprint, 0.5, true);
+	FAllyAICounters::Increment(EAllyAICounter::MoveRequests);
+}
 
-		// Call `MoveToPlayerCharacter` to start this process all over again.
-		MoveToPlayerCharacter();
-	}
+/**
+ * Called when the PlayerCharacter's `OnPlayerMovingChanged` is broadcast to start
+ * following the PlayerCharacter again if the AllyCharacter was waiting for them.
+ *
+ * @param bIsPlayerMoving Whether the PlayerCharacter started or stopped moving.
+ */
+void AAllyAIController::OnPlayerMovingChanged(bool bIsPlayerMoving)
+{
+	ALLY_AI_SCOPE(STAT_AllyOnPlayerMovingChanged);
+
+	if (bIsPlayerMoving && bIsWaitingForPlayerToMove && AllyCharacter->State == AllyStates::FOLLOW) StartFollowingPlayer();
 }
 
 /**
- * Called by the `AllySprintTimer` to make the AllyCharacter start or stop sprinting.
+ * Called to start following the PlayerCharacter again after waiting for them to move.
  */
-void AAllyAIController::ManageAllySprint()
+void AAllyAIController::StartFollowingPlayer()
 {
-	float DistanceFromPlayerCharacter = AllyCharacter->GetDistanceTo(AllyCharacter->PlayerCharacter);
+	// The movement is going to get handled by the `OnMoveCompleted` method until the
+	// AllyCharacter stops moving again.
+	bIsWaitingForPlayerToMove = false;
 
-	UCharacterMovementComponent* Movement = AllyCharacter->GetCharacterMovement();
+	// Start the task that manages the AllyCharacter's movement properties such as walking
+	// and sprinting.
+	if (CrowdSubsystem != nullptr) CrowdSubsystem->SetTaskActive(this, EAllyCrowdTask::Sprint, true);
 
-	if (AllyCharacter->State == AllyStates::FOLLOW)
-	{
-		if (DistanceFromPlayerCharacter >= AllyCharacter->MaxDistanceFromPlayerBeforeSprint && !AllyCharacter->bIsSprinting)
-		{
-			// If the AllyCharacter is out of the `MaxDistanceFromPlayerBeforeSprint` value then
-			// we set the AllyCharacter to sprint.
-			AllyCharacter->SprintStart();
-		}
-		else if (DistanceFromPlayerCharacter < AllyCharacter->MaxDistanceFromPlayerBeforeSprint && AllyCharacter->bIsSprinting)
-		{
-			// If the AllyCharacter is not out of the `MaxDistanceFromPlayerBeforeSprint` value
-			// and it is sprinting then we set it back to the walking speed.
-			AllyCharacter->SprintStop();
-		}
-	}
+	// Call `MoveToPlayerCharacter` to start this process all over again.
+	MoveToPlayerCharacter();
 }
 
 /**
@@ -198,20 +643,86 @@ void AAllyAIController::ManageAllySprint()
  */
 void AAllyAIController::MakeAllyLead(int WaypointA, int WaypointB, bool bShouldWaitForPlayer)
 {
+	ALLY_AI_SCOPE(STAT_AllyMakeAllyLead);
+
+	if (CrowdSubsystem == nullptr) return;
+
 	// Put the AllyCharacter in the LEAD state.
+	if (AllyCharacter->State != AllyStates::LEAD) FAllyAICounters::Increment(EAllyAICounter::StateTransitions);
 	AllyCharacter->State = AllyStates::LEAD;
 
-	// Clear the AllyFollowTimer if the AllyCharacter was in the FOLLOW state before.
-	GetWorld()->GetTimerManager().ClearTimer(AllyFollowTimer);
+	// The AllyCharacter is going to move away from the PlayerCharacter so the previous
+	// path to them won't be any use when it starts following again.
+	PathCache.Invalidate();
+
+	// Stop waiting for the PlayerCharacter to move if the AllyCharacter was in the FOLLOW state before.
+	bIsWaitingForPlayerToMove = false;
 
 	// Set the AllyCharcter's `CurrentWaypoint` to `WaypointA` and `EndWaypoint` to `WaypointB`.
-	AllyCharacter->CurrentWaypoint = AllyCharacter->Waypoints[WaypointA];
-	AllyCharacter->EndWaypoint = AllyCharacter->Waypoints[WaypointB];
+	AllyCharacter->CurrentWaypoint = WaypointRegistry != nullptr ? WaypointRegistry->FindWaypoint(WaypointA) : nullptr;
+	AllyCharacter->EndWaypoint = WaypointRegistry != nullptr ? WaypointRegistry->FindWaypoint(WaypointB) : nullptr;
 
 	AllyCharacter->bShouldWaitForPlayerWhenLeading = bShouldWaitForPlayer;
 
+	// Plan the whole route from `WaypointA` to `WaypointB` on a worker thread. The AllyCharacter
+	// starts moving to `WaypointA` when the lead task first runs and picks the route up once
+	// it is ready.
+	ClearLeadRoute();
+	PlanLeadRoute(WaypointA, WaypointB);
+
 	// Move to the next WaypointActor which could be WaypointA, WaypointB, or a WaypointActor
 	// in between.
-	GetWorld()->GetTimerManager().SetTimer(AllyLeadTimer, this, &AAllyAIController::MoveToWaypoint, 0.5f, true);
+	CrowdSubsystem->SetTaskActive(this, EAllyCrowdTask::Lead, true);
+}
+
+/**
+ * Asks the WaypointGraphSubsystem to plan the route for the current lead on a worker thread.
+ *
+ * @param StartWaypointNumber The `WaypointNumber` of the waypoint to start at.
+ * @param EndWaypointNumber The `WaypointNumber` of the waypoint to end at.
+ */
+void AAllyAIController::PlanLeadRoute(int32 StartWaypointNumber, int32 EndWaypointNumber)
+{
+	UWaypointGraphSubsystem* WaypointGraph = GetWorld()->GetSubsystem<UWaypointGraphSubsystem>();
+	if (WaypointGraph == nullptr) return;
+
+	WaypointGraph->PlanRoute(StartWaypointNumber, EndWaypointNumber, FOnWaypointRoutePlanned::CreateUObject(this, &AAllyAIController::OnLeadRoutePlanned, LeadRouteRequest));
+}
+
+/**
+ * Called by the WaypointGraphSubsystem once the route for a lead has been planned.
+ *
+ * @param Route The planned route.
+ * @param RouteRequest The `LeadRouteRequest` the route was planned for.
+ */
+void AAllyAIController::OnLeadRoutePlanned(const FWaypointRoute& Route, int32 RouteRequest)
+{
+	// Ignore the route if the AllyCharacter has stopped leading or started a different lead.
+	if (RouteRequest != LeadRouteRequest || AllyCharacter == nullptr || AllyCharacter->State != AllyStates::LEAD) return;
+	if (!Route.IsValid() || AllyCharacter->CurrentWaypoint == nullptr) return;
+
+	// Pick the route up from whichever waypoint the AllyCharacter is currently moving to. If it
+	// has already moved on to one that isn't along the route then plan again from there.
+	const int32 CurrentIndex = Route.WaypointNumbers.IndexOfByKey(AllyCharacter->CurrentWaypoint->WaypointNumber);
+	if (CurrentIndex == INDEX_NONE)
+	{
+		if (AllyCharacter->EndWaypoint != nullptr) PlanLeadRoute(AllyCharacter->CurrentWaypoint->WaypointNumber, AllyCharacter->EndWaypoint->WaypointNumber);
+		return;
+	}
+
+	LeadRoute = Route;
+	LeadRouteIndex = CurrentIndex;
+}
+
+/**
+ * Called to stop following the planned lead route.
+ * The next lead move request is always sent, even to the same WaypointActor.
+ */
+void AAllyAIController::ClearLeadRoute()
+{
+	LeadRoute = FWaypointRoute();
+	LeadRouteIndex = INDEX_NONE;
+	++LeadRouteRequest;
+	bIsWaitingForPlayerWhileLeading = false;
+	LeadMoveWaypoint = nullptr;
 }
- 
\ No newline at end of file
@@ -2,9 +2,15 @@
 
 #include "CoreMinimal.h"
 #include "AIController.h"
+#include "AllyLOD.h"
+#include "AllyPathCache.h"
+#include "../WaypointGraphSubsystem.h"
 #include "AllyAIController.generated.h"
 
-class AWaypoint;
+class AWaypointActor;
+class APlayerCharacter;
+class UAllyCrowdSubsystem;
+class UWaypointRegistrySubsystem;
 
 /**
  * The AllyAIController controls the movement and behavior of the AllyCharacter.
@@ -14,22 +20,97 @@ class FOLLOWLEADAI_API AAllyAIController : public AAIController
 {
 	GENERATED_BODY()
 
+	// The AllyCrowdSubsystem runs the follow, sprint, and lead tasks below on
+	// behalf of every AllyAIController.
+	friend class UAllyCrowdSubsystem;
+
+	// The AllyAssignmentSubsystem picks which PlayerCharacter the AllyCharacter follows.
+	friend class UAllyAssignmentSubsystem;
+
+	// The AllyEntitySubsystem turns distant allies into entities and puts leading ones back in the LEAD state.
+	friend class UAllyEntitySubsystem;
+
 public:
-	AAllyAIController();
+	AAllyAIController(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
+
+	/**
+	 * Switches the PlayerCharacter that the AllyCharacter follows and leads, moving the
+	 * delegate bindings and follow group over without restarting the AllyAIController.
+	 *
+	 * @param NewPlayerCharacter The PlayerCharacter to follow.
+	 */
+	void SetPlayerCharacter(APlayerCharacter* NewPlayerCharacter);
+
+	/**
+	 * Called by the AllyPoolSubsystem when a pooled AllyCharacter is put back in the
+	 * world to start following a PlayerCharacter.
+	 *
+	 * @param NewPlayerCharacter The PlayerCharacter to follow.
+	 */
+	void ActivateAlly(APlayerCharacter* NewPlayerCharacter);
+
+	/**
+	 * Called by the AllyPoolSubsystem when the AllyCharacter is returned to the pool to
+	 * stop everything it was doing and reset it to how it was when it was spawned.
+	 */
+	void DeactivateAlly();
 
 protected:
 	// A reference to the AllyCharacter.
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = AI)
 	class AAllyCharacter* AllyCharacter;
 
-	// The repeating timer used to manage the AllyCharacter's sprint state.
-	FTimerHandle AllySprintTimer;
+	// The AllyCrowdSubsystem that runs the recurring follow, sprint, and lead tasks.
+	UPROPERTY()
+	UAllyCrowdSubsystem* CrowdSubsystem;
+
+	// The WaypointRegistrySubsystem that the WaypointActors are looked up in.
+	UPROPERTY()
+	UWaypointRegistrySubsystem* WaypointRegistry;
+
+	// The index of this AllyAIController in the AllyCrowdSubsystem's arrays.
+	int32 CrowdIndex = INDEX_NONE;
+
+	// The previous path to the PlayerCharacter, kept so that repaths while the
+	// PlayerCharacter has barely moved don't need a full path query.
+	FAllyPathCache PathCache;
+
+	// Where the PlayerCharacter was when the last follow move along a cached or shared path was
+	// sent, or `FAISystem::InvalidLocation` if the move repaths by itself.
+	FVector FollowPathPlayerLocation = FAISystem::InvalidLocation;
+
+	// The route planned by the WaypointGraphSubsystem for the current lead.
+	FWaypointRoute LeadRoute;
+
+	// The index in `LeadRoute` of the AllyCharacter's `CurrentWaypoint`.
+	int32 LeadRouteIndex = INDEX_NONE;
+
+	// Incremented for every lead so that a route planned for an earlier lead is ignored.
+	int32 LeadRouteRequest = 0;
 
-	// The repeating timer used to make the AllyCharacter follow the PlayerCharacter.
-	FTimerHandle AllyFollowTimer;
+	// The stream that the AllyAIController's random choices come from, seeded with
+	// `ally.Random.Seed` so that runs can be repeated.
+	FRandomStream RandomStream;
 
-	// The repeating timer used to make the AllyCharacter lead the PlayerCharacter.
-	FTimerHandle AllyLeadTimer;
+	// The world time at which the AllyAssignmentSubsystem last gave the AllyCharacter a
+	// different PlayerCharacter.
+	float LastAssignmentTime = -MAX_FLT;
+
+	// The number of moves in a row that failed, which makes the next repath wait longer.
+	int32 ConsecutiveFailedMoves = 0;
+
+	// Indicates whether the AllyCharacter has caught up to the PlayerCharacter and is
+	// waiting for them to start moving again.
+	bool bIsWaitingForPlayerToMove = false;
+
+	// Indicates whether the AllyCharacter has stopped while leading to wait for the
+	// PlayerCharacter to catch up.
+	bool bIsWaitingForPlayerWhileLeading = false;
+
+	// The WaypointActor that the last lead move request was sent towards, so that the
+	// request is only sent again when the AllyCharacter moves on to another one.
+	UPROPERTY()
+	AWaypointActor* LeadMoveWaypoint = nullptr;
 
 protected:
 	/**
@@ -37,6 +118,68 @@ protected:
 	 */
 	virtual void BeginPlay() override;
 
+	/**
+	 * Called once the AllyAIController has started and taken over the AllyCharacter to
+	 * start following the PlayerCharacter.
+	 */
+	void StartAllyBehavior();
+
+	/**
+	 * Joins the PlayerCharacter's follow group and binds to its delegates.
+	 */
+	void BindToPlayerCharacter();
+
+	/**
+	 * Leaves the PlayerCharacter's follow group and unbinds from its delegates.
+	 */
+	void UnbindFromPlayerCharacter();
+
+	/**
+	 * Seeds `RandomStream` with `ally.Random.Seed` and the AllyAIController's `CrowdIndex`.
+	 */
+	void SeedRandomStream();
+
+	/**
+	 * Turns the crowd simulation on or off for the AllyCharacter depending on its
+	 * `bUseCrowdAvoidance`. This must be called while the AllyCharacter isn't moving.
+	 */
+	void SetUpCrowdAvoidance();
+
+	/**
+	 * Returns whether the AllyCharacter is being steered by the crowd simulation.
+	 */
+	bool IsUsingCrowdAvoidance() const;
+
+	/**
+	 * Sets how carefully the crowd simulation steers the AllyCharacter around its neighbours,
+	 * which is less careful for allies that are far away or off screen.
+	 *
+	 * @param Tier The AllyCharacter's EAllyLODTier.
+	 */
+	void UpdateCrowdAvoidanceQuality(EAllyLODTier Tier);
+
+	/**
+	 * Moves along a path that was put together from points, or makes a regular move request
+	 * that finds its own path if the AllyCharacter is steered by the crowd simulation, which
+	 * can only steer along navmesh paths.
+	 *
+	 * @param MoveRequest The move request.
+	 * @param Path The path to move along.
+	 */
+	void RequestMoveAlongPoints(const FAIMoveRequest& MoveRequest, FNavPathSharedPtr Path);
+
+	/**
+	 * Returns how long to wait before repathing after `ConsecutiveFailedMoves` failed moves.
+	 */
+	float GetFailedMoveBackoff() const;
+
+	/**
+	 * Called when the AllyAIController is removed from the world.
+	 *
+	 * @param EndPlayReason Why the AllyAIController is being removed.
+	 */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	/**
 	 * Called when the AllyAIController takes over the AllyCharacter.
 	 *
@@ -50,27 +193,73 @@ protected:
 	virtual void OnMoveCompleted(FAIRequestID RequestID, const FPathFollowingResult& Result) override;
 
 	/**
-	 * Called to move the AllyCharacter to the PlayerCharacter.
+	 * Called to move the AllyCharacter to the PlayerCharacter. The move is queued with the
+	 * AllyCrowdSubsystem and sent once it fits in the frame's path query budget.
 	 */
 	void MoveToPlayerCharacter();
 
 	/**
-	 * Called to move the AllyCharacter to its `CurrentWaypoint`.
+	 * Sends the move to the PlayerCharacter straight away.
 	 */
-	void MoveToWaypoint();
+	void SendMoveToPlayerCharacter();
 
 	/**
-	 * Called by the `AllyFollowTimer` to check to see if the PlayerCharacter is
-     * is moving or not.
+	 * Returns whether the AllyCharacter is following a path that doesn't repath by itself and the
+	 * PlayerCharacter has moved more than `ally.Follow.GoalTether` since it was sent.
 	 */
-	UFUNCTION()
-	void CheckIfPlayerIsMoving();
+	bool HasPlayerLeftFollowPath() const;
+
+	/**
+	 * Called by the AllyCrowdSubsystem's lead task to move the AllyCharacter to its
+	 * `CurrentWaypoint`. Movement is only started or stopped when the PlayerCharacter
+	 * leaves or comes back within `MaxDistanceFromPlayerWhileLeading`, when the
+	 * AllyCharacter moves on to another WaypointActor, or when the last move ended.
+	 *
+	 * @param bShouldWaitForPlayer Whether the PlayerCharacter is too far behind and the AllyCharacter should wait for them.
+	 */
+	void MoveToWaypoint(bool bShouldWaitForPlayer);
+
+	/**
+	 * Sends the move to the `CurrentWaypoint` straight away, unless the AllyCharacter has
+	 * stopped leading or started waiting for the PlayerCharacter since it was queued.
+	 */
+	void SendMoveToWaypoint();
 
 	/**
-	 * Called by the `AllySprintTimer` to make the AllyCharacter start or stop sprinting.
+	 * Called when the PlayerCharacter's `OnPlayerMovingChanged` is broadcast to start
+	 * following the PlayerCharacter again if the AllyCharacter was waiting for them.
+	 *
+	 * @param bIsPlayerMoving Whether the PlayerCharacter started or stopped moving.
 	 */
 	UFUNCTION()
-	void ManageAllySprint();
+	void OnPlayerMovingChanged(bool bIsPlayerMoving);
+
+	/**
+	 * Called to start following the PlayerCharacter again after waiting for them to move.
+	 */
+	void StartFollowingPlayer();
+
+	/**
+	 * Asks the WaypointGraphSubsystem to plan the route for the current lead on a worker thread.
+	 *
+	 * @param StartWaypointNumber The `WaypointNumber` of the waypoint to start at.
+	 * @param EndWaypointNumber The `WaypointNumber` of the waypoint to end at.
+	 */
+	void PlanLeadRoute(int32 StartWaypointNumber, int32 EndWaypointNumber);
+
+	/**
+	 * Called by the WaypointGraphSubsystem once the route for a lead has been planned.
+	 *
+	 * @param Route The planned route.
+	 * @param RouteRequest The `LeadRouteRequest` the route was planned for.
+	 */
+	void OnLeadRoutePlanned(const FWaypointRoute& Route, int32 RouteRequest);
+
+	/**
+	 * Called to stop following the planned lead route.
+	 * The next lead move request is always sent, even to the same WaypointActor.
+	 */
+	void ClearLeadRoute();
 
 	/**
 	 * Called when`OnAllyLeadRequest` is broadcast to put the AllyCharacter in the LEAD
@@ -1,35 +1,35 @@
 #include "AllyAnimInstance.h"
 #include "AllyCharacter.h"
-#include "Math/Rotator.h"
-#include "Components/CapsuleComponent.h"
-#include "GameFramework/CharacterMovementComponent.h"
 
 /**
- * Used by the animation blueprint to update the animation properties above
- * and decide what animations to play.
+ * Called when the AllyAnimInstance is created to find the AllyCharacter it animates.
  */
-void UAllyAnimInstance::UpdateAnimationProperties()
+void UAllyAnimInstance::NativeInitializeAnimation()
 {
-	// Try to get the Pawn being animated and return if a nullptr.
-	APawn* AllyPawn = TryGetPawnOwner();
-	if (AllyPawn == nullptr) return;
+	Super::NativeInitializeAnimation();
 
-	// Try to cast the Pawn to our AllyCharacter since that's the only
+	// Try to cast the Pawn being animated to our AllyCharacter since that's the only
 	// thing we want to animate.
-	AAllyCharacter* AllyCharacter = Cast<AAllyCharacter>(AllyPawn);
-	if (AllyCharacter == nullptr) return;
+	AllyCharacter = Cast<AAllyCharacter>(Character);
+}
 
-	// Get the AllyCharacter's normalized velocity.
-	UCharacterMovementComponent* AllyCharacterMovement = AllyCharacter->GetCharacterMovement();
-	FVector AllyCharacterMovementVelocity = AllyCharacterMovement->Velocity;
-	AllyCharacterMovementVelocity.Normalize();
+/**
+ * Returns whether the animation properties should be updated this frame, which is only
+ * every few frames for allies that are far away or off screen.
+ */
+bool UAllyAnimInstance::ShouldUpdateProperties() const
+{
+	if (AllyCharacter == nullptr) return false;
 
-	// Get the AllyCharacter's CapsuleComponent rotation and un-rotate it.
-	UCapsuleComponent* AllyCapsule = AllyCharacter->GetCapsuleComponent();
-	FRotator AllyCapsuleRotation = AllyCapsule->GetComponentRotation();
-	FVector AllyVelocityUnrotated = AllyCapsuleRotation.UnrotateVector(AllyCharacterMovementVelocity);
+	// The unique ID staggers the allies so they don't all update on the same frame.
+	const int32 AnimUpdateInterval = FAllyLOD::GetAnimUpdateInterval(AllyCharacter->LODTier);
+	return AnimUpdateInterval <= 1 || (GFrameCounter + AllyCharacter->GetUniqueID()) % AnimUpdateInterval == 0;
+}
 
-	// Set the animation properties based on the unrotated velocity.
-	bIsMoving = AllyVelocityUnrotated.X > 0.1 || AllyVelocityUnrotated.Y > 0.1;
-	bIsSprinting = AllyCharacter->bIsSprinting;
-}
\ No newline at end of file
+/**
+ * Returns whether the AllyCharacter is sprinting.
+ */
+bool UAllyAnimInstance::IsCharacterSprinting() const
+{
+	return AllyCharacter != nullptr && AllyCharacter->bIsSprinting;
+}
@@ -1,29 +1,39 @@
 #pragma once
 
 #include "CoreMinimal.h"
-#include "Animation/AnimInstance.h"
+#include "../FollowLeadAnimInstance.h"
 #include "AllyAnimInstance.generated.h"
 
+class AAllyCharacter;
+
 /**
  * Manages the booleans needed by the animation blueprint to decide what animation
  * needs to be run.
  */
 UCLASS()
-class FOLLOWLEADAI_API UAllyAnimInstance : public UAnimInstance
+class FOLLOWLEADAI_API UAllyAnimInstance : public UFollowLeadAnimInstance
 {
 	GENERATED_BODY()
 
-public:
-	// Indicates whether the AllyCharacter is moving in any direction or not.
-	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	bool bIsMoving;
+protected:
+	/**
+	 * Called when the AllyAnimInstance is created to find the AllyCharacter it animates.
+	 */
+	virtual void NativeInitializeAnimation() override;
+
+	/**
+	 * Returns whether the animation properties should be updated this frame, which is only
+	 * every few frames for allies that are far away or off screen.
+	 */
+	virtual bool ShouldUpdateProperties() const override;
 
-	// Indicates whether the AllyCharacter is sprinting or not.
-	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	bool bIsSprinting;
+	/**
+	 * Returns whether the AllyCharacter is sprinting.
+	 */
+	virtual bool IsCharacterSprinting() const override;
 
-	// Used by the animation blueprint to update the animation properties above
-	// and decide what animations to play.
-	UFUNCTION(BlueprintCallable, Category = "UpdateAnimationProperties")
-	void UpdateAnimationProperties();
+private:
+	// The AllyCharacter being animated, found once instead of every frame.
+	UPROPERTY(Transient)
+	AAllyCharacter* AllyCharacter;
 };
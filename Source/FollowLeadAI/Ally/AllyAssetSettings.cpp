@@ -0,0 +1,34 @@
+#include "AllyAssetSettings.h"
+
+/**
+ * Sets the default values for the AllyAssetSettings.
+ */
+UAllyAssetSettings::UAllyAssetSettings()
+{
+	CategoryName = TEXT("Game");
+
+	// The same assets that the characters used to load in their constructors.
+	const FSoftObjectPath MannequinPath(TEXT("/Game/Mannequin/Character/Mesh/SK_Mannequin.SK_Mannequin"));
+
+	PlayerMesh = TSoftObjectPtr<USkeletalMesh>(MannequinPath);
+	PlayerAnimClass = TSoftClassPtr<UAnimInstance>(FSoftObjectPath(TEXT("/Game/Blueprints/PlayerAnimBlueprint.PlayerAnimBlueprint_C")));
+
+	FAllyVariant& DefaultVariant = AllyVariants.AddDefaulted_GetRef();
+	DefaultVariant.Name = TEXT("Default");
+	DefaultVariant.Mesh = TSoftObjectPtr<USkeletalMesh>(MannequinPath);
+	DefaultVariant.AnimClass = TSoftClassPtr<UAnimInstance>(FSoftObjectPath(TEXT("/Game/Blueprints/AllyAnimBlueprint.AllyAnimBlueprint_C")));
+}
+
+/**
+ * Returns the variant with a name, or the first variant if there isn't one with that
+ * name. Returns nullptr if there are no variants.
+ *
+ * @param Name The name of the variant.
+ */
+const FAllyVariant* UAllyAssetSettings::FindAllyVariant(FName Name) const
+{
+	if (AllyVariants.Num() == 0) return nullptr;
+
+	const FAllyVariant* Variant = Name.IsNone() ? nullptr : AllyVariants.FindByPredicate([Name](const FAllyVariant& Candidate) { return Candidate.Name == Name; });
+	return Variant != nullptr ? Variant : &AllyVariants[0];
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DeveloperSettings.h"
+#include "AllyAssetSettings.generated.h"
+
+class UAnimInstance;
+class USkeletalMesh;
+
+/**
+ * A kind of AllyCharacter, made up of the mesh and animations it is drawn with.
+ */
+USTRUCT(BlueprintType)
+struct FOLLOWLEADAI_API FAllyVariant
+{
+	GENERATED_BODY()
+
+	// The name that an AllyCharacter's `VariantName` picks this variant with.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Ally)
+	FName Name;
+
+	// The SkeletalMesh that the AllyCharacter is drawn with.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Ally)
+	TSoftObjectPtr<USkeletalMesh> Mesh;
+
+	// The AnimBlueprint class that animates the `Mesh`.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Ally)
+	TSoftClassPtr<UAnimInstance> AnimClass;
+};
+
+/**
+ * The meshes and animations of the PlayerCharacter and every kind of AllyCharacter.
+ * They are only referenced softly so that nothing is loaded when the classes are,
+ * and the AllyAssetSubsystem streams them in ahead of time instead.
+ */
+UCLASS(config = Game, defaultconfig, meta = (DisplayName = "Ally Assets"))
+class FOLLOWLEADAI_API UAllyAssetSettings : public UDeveloperSettings
+{
+	GENERATED_BODY()
+
+public:
+	// Sets the default values for the AllyAssetSettings.
+	UAllyAssetSettings();
+
+	// The SkeletalMesh that the PlayerCharacter is drawn with.
+	UPROPERTY(config, EditAnywhere, Category = Player)
+	TSoftObjectPtr<USkeletalMesh> PlayerMesh;
+
+	// The AnimBlueprint class that animates the `PlayerMesh`.
+	UPROPERTY(config, EditAnywhere, Category = Player)
+	TSoftClassPtr<UAnimInstance> PlayerAnimClass;
+
+	// Every kind of AllyCharacter. The first one is used by AllyCharacters that don't pick one.
+	UPROPERTY(config, EditAnywhere, Category = Ally)
+	TArray<FAllyVariant> AllyVariants;
+
+	/**
+	 * Returns the variant with a name, or the first variant if there isn't one with that
+	 * name. Returns nullptr if there are no variants.
+	 *
+	 * @param Name The name of the variant.
+	 */
+	const FAllyVariant* FindAllyVariant(FName Name) const;
+};
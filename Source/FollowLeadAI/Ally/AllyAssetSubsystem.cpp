@@ -0,0 +1,140 @@
+#include "AllyAssetSubsystem.h"
+#include "AllyAssetSettings.h"
+#include "Animation/AnimInstance.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/SkeletalMesh.h"
+
+/**
+ * Called when the game starts to begin streaming in every asset in the Ally Assets settings.
+ */
+void UAllyAssetSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	const UAllyAssetSettings* Settings = GetDefault<UAllyAssetSettings>();
+
+	TArray<FSoftObjectPath> Paths;
+	if (!Settings->PlayerMesh.IsNull()) Paths.AddUnique(Settings->PlayerMesh.ToSoftObjectPath());
+	if (!Settings->PlayerAnimClass.IsNull()) Paths.AddUnique(Settings->PlayerAnimClass.ToSoftObjectPath());
+
+	for (const FAllyVariant& Variant : Settings->AllyVariants)
+	{
+		if (!Variant.Mesh.IsNull()) Paths.AddUnique(Variant.Mesh.ToSoftObjectPath());
+		if (!Variant.AnimClass.IsNull()) Paths.AddUnique(Variant.AnimClass.ToSoftObjectPath());
+	}
+
+	if (Paths.Num() == 0) return;
+
+	// The level loads while these stream in, so by the time the characters begin play
+	// their assets are usually already in memory.
+	PreloadStartSeconds = FPlatformTime::Seconds();
+	PreloadHandle = StreamableManager.RequestAsyncLoad(Paths, FStreamableDelegate::CreateUObject(this, &UAllyAssetSubsystem::OnPreloadComplete), FStreamableManager::AsyncLoadHighPriority);
+}
+
+/**
+ * Called when the game shuts down.
+ */
+void UAllyAssetSubsystem::Deinitialize()
+{
+	if (PreloadHandle.IsValid())
+	{
+		PreloadHandle->CancelHandle();
+		PreloadHandle.Reset();
+	}
+
+	Super::Deinitialize();
+}
+
+/**
+ * Gives an AllyCharacter's SkeletalMeshComponent the mesh and animations of one of the variants.
+ *
+ * @param Mesh The SkeletalMeshComponent of the AllyCharacter.
+ * @param VariantName The name of the variant, or None for the first one.
+ */
+void UAllyAssetSubsystem::ApplyAllyVariant(USkeletalMeshComponent* Mesh, FName VariantName)
+{
+	const FAllyVariant* Variant = GetDefault<UAllyAssetSettings>()->FindAllyVariant(VariantName);
+	if (Variant == nullptr) return;
+
+	ApplyAssets(Mesh, Variant->Mesh, Variant->AnimClass);
+}
+
+/**
+ * Gives the PlayerCharacter's SkeletalMeshComponent its mesh and animations.
+ *
+ * @param Mesh The SkeletalMeshComponent of the PlayerCharacter.
+ */
+void UAllyAssetSubsystem::ApplyPlayerAssets(USkeletalMeshComponent* Mesh)
+{
+	const UAllyAssetSettings* Settings = GetDefault<UAllyAssetSettings>();
+	ApplyAssets(Mesh, Settings->PlayerMesh, Settings->PlayerAnimClass);
+}
+
+/**
+ * Returns whether every asset in the Ally Assets settings has been streamed in.
+ */
+bool UAllyAssetSubsystem::IsPreloaded() const
+{
+	return !PreloadHandle.IsValid() || PreloadHandle->HasLoadCompleted();
+}
+
+/**
+ * Blocks until every asset in the Ally Assets settings has been streamed in. Only
+ * meant for when a hitch doesn't matter, like before a benchmark starts.
+ */
+void UAllyAssetSubsystem::WaitForPreload()
+{
+	if (PreloadHandle.IsValid() && PreloadHandle->IsLoadingInProgress()) PreloadHandle->WaitUntilComplete();
+}
+
+/**
+ * Called once every asset in the Ally Assets settings has been streamed in.
+ */
+void UAllyAssetSubsystem::OnPreloadComplete()
+{
+	TArray<UObject*> LoadedAssets;
+	if (PreloadHandle.IsValid()) PreloadHandle->GetLoadedAssets(LoadedAssets);
+
+	UE_LOG(LogTemp, Display, TEXT("Preloaded %d ally assets in %.1f ms"), LoadedAssets.Num(), (FPlatformTime::Seconds() - PreloadStartSeconds) * 1000.0);
+}
+
+/**
+ * Gives a SkeletalMeshComponent a mesh and animations, straight away if they are in
+ * memory and once they have been streamed in otherwise.
+ */
+void UAllyAssetSubsystem::ApplyAssets(USkeletalMeshComponent* Mesh, const TSoftObjectPtr<USkeletalMesh>& MeshAsset, const TSoftClassPtr<UAnimInstance>& AnimClass)
+{
+	if (Mesh == nullptr) return;
+
+	const bool bIsMeshLoaded = MeshAsset.IsNull() || MeshAsset.Get() != nullptr;
+	const bool bIsAnimClassLoaded = AnimClass.IsNull() || AnimClass.Get() != nullptr;
+
+	if (bIsMeshLoaded && bIsAnimClassLoaded)
+	{
+		SetMeshAssets(Mesh, MeshAsset.Get(), AnimClass.Get());
+		return;
+	}
+
+	// The preload hasn't got to these yet, or they aren't part of it, so stream them in
+	// and let the character go without a mesh for a few frames rather than hitch.
+	TArray<FSoftObjectPath> Paths;
+	if (!bIsMeshLoaded) Paths.Add(MeshAsset.ToSoftObjectPath());
+	if (!bIsAnimClassLoaded) Paths.Add(AnimClass.ToSoftObjectPath());
+
+	TWeakObjectPtr<USkeletalMeshComponent> WeakMesh(Mesh);
+	StreamableManager.RequestAsyncLoad(Paths, FStreamableDelegate::CreateWeakLambda(this, [WeakMesh, MeshAsset, AnimClass]()
+	{
+		if (WeakMesh.IsValid()) SetMeshAssets(WeakMesh.Get(), MeshAsset.Get(), AnimClass.Get());
+	}));
+}
+
+/**
+ * Sets the mesh and animations of a SkeletalMeshComponent, skipping any that aren't loaded.
+ */
+void UAllyAssetSubsystem::SetMeshAssets(USkeletalMeshComponent* Mesh, USkeletalMesh* MeshAsset, UClass* AnimClass)
+{
+	// Both of these return early when nothing changes, so a pooled AllyCharacter that keeps
+	// its variant costs nothing to set up again.
+	if (MeshAsset != nullptr) Mesh->SetSkeletalMesh(MeshAsset);
+	if (AnimClass != nullptr) Mesh->SetAnimInstanceClass(AnimClass);
+}
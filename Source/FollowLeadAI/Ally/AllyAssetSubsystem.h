@@ -0,0 +1,86 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/StreamableManager.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "AllyAssetSubsystem.generated.h"
+
+class UAnimInstance;
+class USkeletalMesh;
+class USkeletalMeshComponent;
+
+/**
+ * The AllyAssetSubsystem streams in the meshes and animations from the Ally Assets
+ * project settings as soon as the game starts, in the background, and hands them to
+ * the PlayerCharacter and AllyCharacters as they begin play. Anything that isn't in
+ * memory yet is streamed in and given to the character once it arrives, so spawning
+ * a character never waits on a synchronous load.
+ */
+UCLASS()
+class FOLLOWLEADAI_API UAllyAssetSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/**
+	 * Called when the game starts to begin streaming in every asset in the Ally Assets settings.
+	 */
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	/**
+	 * Called when the game shuts down.
+	 */
+	virtual void Deinitialize() override;
+
+	/**
+	 * Gives an AllyCharacter's SkeletalMeshComponent the mesh and animations of one of the variants.
+	 *
+	 * @param Mesh The SkeletalMeshComponent of the AllyCharacter.
+	 * @param VariantName The name of the variant, or None for the first one.
+	 */
+	void ApplyAllyVariant(USkeletalMeshComponent* Mesh, FName VariantName);
+
+	/**
+	 * Gives the PlayerCharacter's SkeletalMeshComponent its mesh and animations.
+	 *
+	 * @param Mesh The SkeletalMeshComponent of the PlayerCharacter.
+	 */
+	void ApplyPlayerAssets(USkeletalMeshComponent* Mesh);
+
+	/**
+	 * Returns whether every asset in the Ally Assets settings has been streamed in.
+	 */
+	bool IsPreloaded() const;
+
+	/**
+	 * Blocks until every asset in the Ally Assets settings has been streamed in. Only
+	 * meant for when a hitch doesn't matter, like before a benchmark starts.
+	 */
+	void WaitForPreload();
+
+private:
+	// Streams in the assets.
+	FStreamableManager StreamableManager;
+
+	// Keeps every asset in the Ally Assets settings in memory for as long as the game runs.
+	TSharedPtr<FStreamableHandle> PreloadHandle;
+
+	// When the preload started, to log how long it took.
+	double PreloadStartSeconds = 0.0;
+
+	/**
+	 * Called once every asset in the Ally Assets settings has been streamed in.
+	 */
+	void OnPreloadComplete();
+
+	/**
+	 * Gives a SkeletalMeshComponent a mesh and animations, straight away if they are in
+	 * memory and once they have been streamed in otherwise.
+	 */
+	void ApplyAssets(USkeletalMeshComponent* Mesh, const TSoftObjectPtr<USkeletalMesh>& MeshAsset, const TSoftClassPtr<UAnimInstance>& AnimClass);
+
+	/**
+	 * Sets the mesh and animations of a SkeletalMeshComponent, skipping any that aren't loaded.
+	 */
+	static void SetMeshAssets(USkeletalMeshComponent* Mesh, USkeletalMesh* MeshAsset, UClass* AnimClass);
+};
@@ -0,0 +1,390 @@
+#include "AllyAssignmentSubsystem.h"
+#include "AllyAIController.h"
+#include "AllyCharacter.h"
+#include "AllyCrowdSubsystem.h"
+#include "AllyStats.h"
+#include "../Player/PlayerCharacter.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "UObject/UObjectIterator.h"
+
+// Whether allies are spread across every PlayerCharacter instead of keeping the one they were given.
+static TAutoConsoleVariable<int32> CVarAllyAssignEnabled(
+	TEXT("ally.Assign.Enabled"),
+	1,
+	TEXT("Whether allies are assigned to the nearest PlayerCharacter that isn't already overloaded with allies."),
+	ECVF_Default);
+
+// The size, in units, of each cell of the grid that the PlayerCharacters are put in.
+static TAutoConsoleVariable<float> CVarAllyAssignCellSize(
+	TEXT("ally.Assign.CellSize"),
+	2000.f,
+	TEXT("The size of each cell of the grid that PlayerCharacters are put in for ally assignment."),
+	ECVF_Default);
+
+// How often, in seconds, the allies assigned to each PlayerCharacter are counted again.
+static TAutoConsoleVariable<float> CVarAllyAssignLoadCountInterval(
+	TEXT("ally.Assign.LoadCountInterval"),
+	1.f,
+	TEXT("How often the allies assigned to each PlayerCharacter are counted again. In between, the counts are only kept up to date by the reassignments themselves."),
+	ECVF_Default);
+
+// How far, in units, an ally looks for PlayerCharacters to be assigned to.
+static TAutoConsoleVariable<float> CVarAllyAssignSearchRadius(
+	TEXT("ally.Assign.SearchRadius"),
+	6000.f,
+	TEXT("How far an ally looks for PlayerCharacters to be assigned to. Allies without a PlayerCharacter in range keep the one they have."),
+	ECVF_Default);
+
+// How much a PlayerCharacter having more than their share of allies counts against them.
+static TAutoConsoleVariable<float> CVarAllyAssignLoadWeight(
+	TEXT("ally.Assign.LoadWeight"),
+	1.f,
+	TEXT("How much a PlayerCharacter having more than their share of allies counts against them. 0 assigns allies by distance alone."),
+	ECVF_Default);
+
+// How much better another PlayerCharacter has to be before an ally switches to them.
+static TAutoConsoleVariable<float> CVarAllyAssignSwitchMargin(
+	TEXT("ally.Assign.SwitchMargin"),
+	0.25f,
+	TEXT("How much cheaper, as a fraction, another PlayerCharacter has to be before an ally switches to them."),
+	ECVF_Default);
+
+// The shortest time, in seconds, between two reassignments of the same ally.
+static TAutoConsoleVariable<float> CVarAllyAssignMinReassignInterval(
+	TEXT("ally.Assign.MinReassignInterval"),
+	2.f,
+	TEXT("The shortest time between two reassignments of the same ally."),
+	ECVF_Default);
+
+// The maximum number of allies whose assignment is checked per frame.
+static TAutoConsoleVariable<int32> CVarAllyAssignMaxAlliesPerFrame(
+	TEXT("ally.Assign.MaxAlliesPerFrame"),
+	32,
+	TEXT("The maximum number of allies whose assignment is checked per frame. 0 means no limit."),
+	ECVF_Default);
+
+// Logs how many allies each PlayerCharacter has in every world.
+static FAutoConsoleCommand AllyAssignStatsCommand(
+	TEXT("ally.Assign.Stats"),
+	TEXT("Logs how many allies are assigned to each PlayerCharacter and how many have been reassigned."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		for (TObjectIterator<UAllyAssignmentSubsystem> It; It; ++It)
+		{
+			if (It->HasAnyFlags(RF_ClassDefaultObject) || It->GetWorld() == nullptr) continue;
+
+			UE_LOG(LogTemp, Display, TEXT("Ally assignment in %s: %d players, %d reassignments"), *It->GetWorld()->GetName(), It->GetPlayers().Num(), It->GetNumReassignments());
+
+			for (const APlayerCharacter* Player : It->GetPlayers())
+			{
+				if (Player != nullptr) UE_LOG(LogTemp, Display, TEXT("  %s: %d allies"), *Player->GetName(), It->GetNumAssignedAllies(Player));
+			}
+		}
+	}));
+
+/**
+ * Called when the AllyAssignmentSubsystem is created for a world.
+ */
+void UAllyAssignmentSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	CrowdSubsystem = Cast<UAllyCrowdSubsystem>(Collection.InitializeDependency(UAllyCrowdSubsystem::StaticClass()));
+	UpdateCursor = 0;
+}
+
+/**
+ * Called when the world the AllyAssignmentSubsystem belongs to is torn down.
+ */
+void UAllyAssignmentSubsystem::Deinitialize()
+{
+	Players.Reset();
+	PlayerLocations.Reset();
+	PlayerLoads.Reset();
+	PlayerCellKeys.Reset();
+	PlayerCells.Reset();
+
+	Super::Deinitialize();
+}
+
+/**
+ * Adds a PlayerCharacter that allies can be assigned to.
+ *
+ * @param Player The PlayerCharacter to add.
+ */
+void UAllyAssignmentSubsystem::RegisterPlayer(APlayerCharacter* Player)
+{
+	if (Player == nullptr || Players.Contains(Player)) return;
+
+	Players.Add(Player);
+	bPlayersChanged = true;
+}
+
+/**
+ * Removes a PlayerCharacter and assigns its allies to the PlayerCharacters that are left.
+ *
+ * @param Player The PlayerCharacter to remove.
+ */
+void UAllyAssignmentSubsystem::UnregisterPlayer(APlayerCharacter* Player)
+{
+	if (Players.Remove(Player) == 0) return;
+
+	bPlayersChanged = true;
+
+	// The allies that were following the PlayerCharacter are left without one and get
+	// picked up by the next updates. Leading allies are let go as well since the
+	// PlayerCharacter they were leading is gone.
+	if (CrowdSubsystem == nullptr || !CVarAllyAssignEnabled.GetValueOnGameThread()) return;
+
+	for (AAllyAIController* Ally : CrowdSubsystem->GetAllies())
+	{
+		if (Ally != nullptr && Ally->AllyCharacter != nullptr && Ally->AllyCharacter->PlayerCharacter == Player) Ally->SetPlayerCharacter(nullptr);
+	}
+}
+
+/**
+ * Returns how many allies were assigned to a PlayerCharacter as of the last update.
+ */
+int32 UAllyAssignmentSubsystem::GetNumAssignedAllies(const APlayerCharacter* Player) const
+{
+	const int32 Index = Players.IndexOfByKey(Player);
+
+	return PlayerLoads.IsValidIndex(Index) ? PlayerLoads[Index] : 0;
+}
+
+/**
+ * Checks the assignment of as many allies as the per-frame budget allows.
+ */
+void UAllyAssignmentSubsystem::Tick(float DeltaTime)
+{
+	ALLY_AI_SCOPE(STAT_AllyAssignmentTick);
+
+	if (!CVarAllyAssignEnabled.GetValueOnGameThread() || CrowdSubsystem == nullptr) return;
+
+	if (Players.RemoveAll([](const APlayerCharacter* Player) { return Player == nullptr || Player->IsPendingKill(); }) > 0) bPlayersChanged = true;
+	if (Players.Num() == 0) return;
+
+	// The loads have to be counted again whenever `Players` changes since they are
+	// indexed like it.
+	const float Now = GetWorld()->GetTimeSeconds();
+	const bool bShouldCountLoads = bPlayersChanged || Now - LastLoadCountTime >= CVarAllyAssignLoadCountInterval.GetValueOnGameThread();
+
+	UpdatePlayerGrid();
+	if (bShouldCountLoads)
+	{
+		CountPlayerLoads();
+		LastLoadCountTime = Now;
+	}
+
+	const TArray<AAllyAIController*>& Allies = CrowdSubsystem->GetAllies();
+	const int32 NumAllies = Allies.Num();
+	if (NumAllies == 0) return;
+
+	// The share of the allies that each PlayerCharacter would have if they were spread evenly.
+	const float TargetLoad = FMath::Max(1.f, static_cast<float>(NumAllies) / Players.Num());
+
+	const int32 Budget = CVarAllyAssignMaxAlliesPerFrame.GetValueOnGameThread();
+	const int32 NumToUpdate = Budget > 0 ? FMath::Min(Budget, NumAllies) : NumAllies;
+
+	if (UpdateCursor >= NumAllies) UpdateCursor = 0;
+
+	// Reassigning an ally never adds or removes it from the AllyCrowdSubsystem so the
+	// allies can be walked directly.
+	for (int32 Visited = 0; Visited < NumToUpdate; ++Visited)
+	{
+		UpdateAssignment(Allies[UpdateCursor], Now, TargetLoad);
+		UpdateCursor = (UpdateCursor + 1) % NumAllies;
+	}
+}
+
+/**
+ * Moves every PlayerCharacter to the cell they are in now, rebuilding the grid only when
+ * one of them has changed cells or PlayerCharacters were added or removed.
+ */
+void UAllyAssignmentSubsystem::UpdatePlayerGrid()
+{
+	const float NewCellSize = FMath::Max(100.f, CVarAllyAssignCellSize.GetValueOnGameThread());
+	bool bShouldRebuild = bPlayersChanged || NewCellSize != CellSize;
+	CellSize = NewCellSize;
+
+	// The locations are needed every frame for the distances, but the PlayerCharacters
+	// rarely leave their cell so the grid itself can usually be left as it is.
+	PlayerLocations.SetNumUninitialized(Players.Num());
+	PlayerCellKeys.SetNumUninitialized(Players.Num());
+
+	for (int32 Index = 0; Index < Players.Num(); ++Index)
+	{
+		PlayerLocations[Index] = Players[Index]->GetActorLocation();
+
+		const FIntPoint Cell = GetCell(PlayerLocations[Index]);
+		if (!bPlayersChanged && PlayerCellKeys[Index] != Cell) bShouldRebuild = true;
+		PlayerCellKeys[Index] = Cell;
+	}
+
+	bPlayersChanged = false;
+	if (!bShouldRebuild) return;
+
+	// The cells are emptied instead of removed so that their arrays are reused while
+	// the PlayerCharacters stay in the same part of the level.
+	for (TPair<FIntPoint, TArray<int32>>& Cell : PlayerCells) Cell.Value.Reset();
+
+	for (int32 Index = 0; Index < Players.Num(); ++Index) PlayerCells.FindOrAdd(PlayerCellKeys[Index]).Add(Index);
+}
+
+/**
+ * Counts how many allies are assigned to each PlayerCharacter.
+ */
+void UAllyAssignmentSubsystem::CountPlayerLoads()
+{
+	PlayerLoads.SetNumZeroed(Players.Num());
+	for (int32& Load : PlayerLoads) Load = 0;
+
+	// There are far fewer PlayerCharacters than allies so looking each ally's PlayerCharacter
+	// up in `Players` is cheaper than keeping the loads up to date through every path that
+	// can change an ally's PlayerCharacter. Between counts the loads are only changed by
+	// the reassignments made here, which is close enough to spread the allies out.
+	for (const AAllyAIController* Ally : CrowdSubsystem->GetAllies())
+	{
+		const APlayerCharacter* Player = Ally != nullptr && Ally->AllyCharacter != nullptr ? Ally->AllyCharacter->PlayerCharacter : nullptr;
+		const int32 PlayerIndex = Player != nullptr ? Players.IndexOfByKey(Player) : INDEX_NONE;
+		if (PlayerIndex != INDEX_NONE) ++PlayerLoads[PlayerIndex];
+	}
+}
+
+/**
+ * Returns the cell of the grid that a location is in.
+ */
+FIntPoint UAllyAssignmentSubsystem::GetCell(const FVector& Location) const
+{
+	return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+}
+
+/**
+ * Returns how much it would cost for an ally at a location to be assigned to a PlayerCharacter.
+ *
+ * @param PlayerIndex The index of the PlayerCharacter in `Players`.
+ * @param AllyLocation The location of the ally.
+ * @param TargetLoad How many allies each PlayerCharacter would have if they were spread evenly.
+ * @param bIsCurrentPlayer Whether the ally is already assigned to the PlayerCharacter.
+ */
+float UAllyAssignmentSubsystem::GetAssignmentCost(int32 PlayerIndex, const FVector& AllyLocation, float TargetLoad, bool bIsCurrentPlayer) const
+{
+	// The ally is already counted in its own PlayerCharacter's load so it's left out to
+	// compare staying against moving fairly.
+	const int32 Load = PlayerLoads[PlayerIndex] - (bIsCurrentPlayer ? 1 : 0);
+	const float Overload = FMath::Max(0.f, (Load + 1 - TargetLoad) / TargetLoad);
+
+	return FVector::Dist2D(AllyLocation, PlayerLocations[PlayerIndex]) * (1.f + CVarAllyAssignLoadWeight.GetValueOnGameThread() * Overload);
+}
+
+/**
+ * Returns the index in `Players` of the PlayerCharacter an ally should be assigned to.
+ *
+ * @param AllyLocation The location of the ally.
+ * @param CurrentPlayerIndex The index of the PlayerCharacter the ally is assigned to, or INDEX_NONE.
+ * @param TargetLoad How many allies each PlayerCharacter would have if they were spread evenly.
+ */
+int32 UAllyAssignmentSubsystem::FindBestPlayer(const FVector& AllyLocation, int32 CurrentPlayerIndex, float TargetLoad) const
+{
+	int32 BestIndex = INDEX_NONE;
+	float BestCost = MAX_FLT;
+
+	// Staying with the current PlayerCharacter gets a discount so that allies halfway
+	// between two PlayerCharacters don't keep switching back and forth.
+	if (CurrentPlayerIndex != INDEX_NONE)
+	{
+		BestIndex = CurrentPlayerIndex;
+		BestCost = GetAssignmentCost(CurrentPlayerIndex, AllyLocation, TargetLoad, true) * (1.f - CVarAllyAssignSwitchMargin.GetValueOnGameThread());
+	}
+
+	// Only the cells within the search radius are looked at instead of every PlayerCharacter.
+	const float SearchRadius = CVarAllyAssignSearchRadius.GetValueOnGameThread();
+	const int32 CellRadius = FMath::CeilToInt(SearchRadius / CellSize);
+	const FIntPoint Center = GetCell(AllyLocation);
+	bool bFoundPlayerInRange = false;
+
+	for (int32 Y = Center.Y - CellRadius; Y <= Center.Y + CellRadius; ++Y)
+	{
+		for (int32 X = Center.X - CellRadius; X <= Center.X + CellRadius; ++X)
+		{
+			const TArray<int32>* Cell = PlayerCells.Find(FIntPoint(X, Y));
+			if (Cell == nullptr) continue;
+
+			for (const int32 PlayerIndex : *Cell)
+			{
+				if (FVector::DistSquared2D(AllyLocation, PlayerLocations[PlayerIndex]) > SearchRadius * SearchRadius) continue;
+
+				bFoundPlayerInRange = true;
+				if (PlayerIndex == CurrentPlayerIndex) continue;
+
+				const float Cost = GetAssignmentCost(PlayerIndex, AllyLocation, TargetLoad, false);
+				if (Cost < BestCost)
+				{
+					BestCost = Cost;
+					BestIndex = PlayerIndex;
+				}
+			}
+		}
+	}
+
+	// An ally without a PlayerCharacter that has nobody in range goes to whoever is
+	// closest, wherever they are, so that it isn't left standing around.
+	if (!bFoundPlayerInRange && CurrentPlayerIndex == INDEX_NONE)
+	{
+		for (int32 PlayerIndex = 0; PlayerIndex < Players.Num(); ++PlayerIndex)
+		{
+			const float Cost = GetAssignmentCost(PlayerIndex, AllyLocation, TargetLoad, false);
+			if (Cost < BestCost)
+			{
+				BestCost = Cost;
+				BestIndex = PlayerIndex;
+			}
+		}
+	}
+
+	return BestIndex;
+}
+
+/**
+ * Moves an ally over to a PlayerCharacter if it's better off there.
+ *
+ * @param Ally The ally to check.
+ * @param Now The current world time.
+ * @param TargetLoad How many allies each PlayerCharacter would have if they were spread evenly.
+ */
+void UAllyAssignmentSubsystem::UpdateAssignment(AAllyAIController* Ally, float Now, float TargetLoad)
+{
+	AAllyCharacter* AllyCharacter = Ally != nullptr ? Ally->AllyCharacter : nullptr;
+	if (AllyCharacter == nullptr) return;
+
+	// A leading ally finishes leading the PlayerCharacter that asked for it first.
+	if (AllyCharacter->State == AllyStates::LEAD) return;
+
+	const int32 CurrentPlayerIndex = AllyCharacter->PlayerCharacter != nullptr ? Players.IndexOfByKey(AllyCharacter->PlayerCharacter) : INDEX_NONE;
+	if (CurrentPlayerIndex != INDEX_NONE && Now - Ally->LastAssignmentTime < CVarAllyAssignMinReassignInterval.GetValueOnGameThread()) return;
+
+	const int32 BestPlayerIndex = FindBestPlayer(AllyCharacter->GetActorLocation(), CurrentPlayerIndex, TargetLoad);
+	if (BestPlayerIndex == INDEX_NONE || BestPlayerIndex == CurrentPlayerIndex) return;
+
+	// Keep the loads up to date so that the rest of this frame's allies see the move.
+	if (CurrentPlayerIndex != INDEX_NONE)
+	{
+		--PlayerLoads[CurrentPlayerIndex];
+		++NumReassignments;
+	}
+	++PlayerLoads[BestPlayerIndex];
+
+	Ally->LastAssignmentTime = Now;
+	Ally->SetPlayerCharacter(Players[BestPlayerIndex]);
+}
+
+ETickableTickType UAllyAssignmentSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Always;
+}
+
+TStatId UAllyAssignmentSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UAllyAssignmentSubsystem, STATGROUP_Tickables);
+}
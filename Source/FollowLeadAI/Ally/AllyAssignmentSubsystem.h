@@ -0,0 +1,151 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "AllyAssignmentSubsystem.generated.h"
+
+class AAllyAIController;
+class APlayerCharacter;
+class UAllyCrowdSubsystem;
+
+/**
+ * The AllyAssignmentSubsystem spreads the allies across every PlayerCharacter in the
+ * world so that each ally follows and leads whichever PlayerCharacter is closest to it
+ * without one PlayerCharacter ending up with all of them. The PlayerCharacters are put
+ * in a grid so that each ally only looks at the PlayerCharacters near it, and only a
+ * slice of the allies are looked at each frame so that the cost stays flat however many
+ * allies there are.
+ */
+UCLASS()
+class FOLLOWLEADAI_API UAllyAssignmentSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	/**
+	 * Called when the AllyAssignmentSubsystem is created for a world.
+	 */
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	/**
+	 * Called when the world the AllyAssignmentSubsystem belongs to is torn down.
+	 */
+	virtual void Deinitialize() override;
+
+	/**
+	 * Adds a PlayerCharacter that allies can be assigned to.
+	 *
+	 * @param Player The PlayerCharacter to add.
+	 */
+	void RegisterPlayer(APlayerCharacter* Player);
+
+	/**
+	 * Removes a PlayerCharacter and assigns its allies to the PlayerCharacters that are left.
+	 *
+	 * @param Player The PlayerCharacter to remove.
+	 */
+	void UnregisterPlayer(APlayerCharacter* Player);
+
+	/**
+	 * Returns every PlayerCharacter that allies can be assigned to.
+	 */
+	const TArray<APlayerCharacter*>& GetPlayers() const { return Players; }
+
+	/**
+	 * Returns how many allies were assigned to a PlayerCharacter as of the last update.
+	 */
+	int32 GetNumAssignedAllies(const APlayerCharacter* Player) const;
+
+	/**
+	 * Returns how many allies have been moved from one PlayerCharacter to another.
+	 */
+	int32 GetNumReassignments() const { return NumReassignments; }
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual TStatId GetStatId() const override;
+
+private:
+	// Every PlayerCharacter that allies can be assigned to.
+	UPROPERTY()
+	TArray<APlayerCharacter*> Players;
+
+	// The location of each PlayerCharacter as of the last update, indexed like `Players`.
+	TArray<FVector> PlayerLocations;
+
+	// The number of allies assigned to each PlayerCharacter, indexed like `Players`.
+	TArray<int32> PlayerLoads;
+
+	// The cell of the grid that each PlayerCharacter is in, indexed like `Players`.
+	TArray<FIntPoint> PlayerCellKeys;
+
+	// The indices in `Players` of the PlayerCharacters in each cell of the grid.
+	TMap<FIntPoint, TArray<int32>> PlayerCells;
+
+	// Indicates whether PlayerCharacters were added or removed since the grid was built.
+	bool bPlayersChanged = true;
+
+	// The world time at which the allies assigned to each PlayerCharacter were last counted.
+	float LastLoadCountTime = -MAX_FLT;
+
+	// The size of each cell of the grid as of the last update.
+	float CellSize = 2000.f;
+
+	// The index in the AllyCrowdSubsystem's allies that the next update starts from.
+	int32 UpdateCursor = 0;
+
+	// The number of allies that have been moved from one PlayerCharacter to another.
+	int32 NumReassignments = 0;
+
+	// The AllyCrowdSubsystem that every AllyAIController is registered with.
+	UPROPERTY()
+	UAllyCrowdSubsystem* CrowdSubsystem;
+
+	/**
+	 * Moves every PlayerCharacter to the cell they are in now, rebuilding the grid only
+	 * when one of them has changed cells or PlayerCharacters were added or removed.
+	 */
+	void UpdatePlayerGrid();
+
+	/**
+	 * Counts how many allies are assigned to each PlayerCharacter.
+	 */
+	void CountPlayerLoads();
+
+	/**
+	 * Returns the cell of the grid that a location is in.
+	 */
+	FIntPoint GetCell(const FVector& Location) const;
+
+	/**
+	 * Returns how much it would cost for an ally at a location to be assigned to a
+	 * PlayerCharacter, based on the distance to them and how many allies they already have.
+	 *
+	 * @param PlayerIndex The index of the PlayerCharacter in `Players`.
+	 * @param AllyLocation The location of the ally.
+	 * @param TargetLoad How many allies each PlayerCharacter would have if they were spread evenly.
+	 * @param bIsCurrentPlayer Whether the ally is already assigned to the PlayerCharacter.
+	 */
+	float GetAssignmentCost(int32 PlayerIndex, const FVector& AllyLocation, float TargetLoad, bool bIsCurrentPlayer) const;
+
+	/**
+	 * Returns the index in `Players` of the PlayerCharacter an ally should be assigned to.
+	 *
+	 * @param AllyLocation The location of the ally.
+	 * @param CurrentPlayerIndex The index of the PlayerCharacter the ally is assigned to, or INDEX_NONE.
+	 * @param TargetLoad How many allies each PlayerCharacter would have if they were spread evenly.
+	 */
+	int32 FindBestPlayer(const FVector& AllyLocation, int32 CurrentPlayerIndex, float TargetLoad) const;
+
+	/**
+	 * Moves an ally over to a PlayerCharacter if it's better off there.
+	 *
+	 * @param Ally The ally to check.
+	 * @param Now The current world time.
+	 * @param TargetLoad How many allies each PlayerCharacter would have if they were spread evenly.
+	 */
+	void UpdateAssignment(AAllyAIController* Ally, float Now, float TargetLoad);
+};
@@ -1,33 +1,80 @@
 #include "AllyCharacter.h"
+#include "AllyAssetSubsystem.h"
+#include "AllyStats.h"
+#include "AllyTuning.h"
+#include "../Player/PlayerCharacter.h"
 #include "../WaypointActor.h"
-#include "Kismet/GameplayStatics.h"
+#include "../WaypointRegistrySubsystem.h"
 #include "Components/BoxComponent.h"
+#include "Engine/GameInstance.h"
 #include "GameFramework/CharacterMovementComponent.h"
+#include "HAL/IConsoleManager.h"
+#include "Net/UnrealNetwork.h"
+
+// How far, in units, an ally can be from a client's view before it stops being replicated to them.
+static TAutoConsoleVariable<float> CVarAllyNetCullDistance(
+	TEXT("ally.Net.CullDistance"),
+	10000.f,
+	TEXT("How far an ally can be from a client's view before it stops being replicated to that client. Allies are always replicated to the player they follow."),
+	ECVF_Default);
+
+// How much an ally's network priority is scaled by in each of the MEDIUM and LOW distance tiers.
+static TAutoConsoleVariable<float> CVarAllyNetMediumPriorityScale(
+	TEXT("ally.Net.Medium.PriorityScale"),
+	0.5f,
+	TEXT("How much the network priority of allies in the MEDIUM distance tier is scaled by."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarAllyNetLowPriorityScale(
+	TEXT("ally.Net.Low.PriorityScale"),
+	0.25f,
+	TEXT("How much the network priority of allies in the LOW distance tier is scaled by."),
+	ECVF_Default);
+
+// How much an ally's network priority is scaled by for the player it follows.
+static TAutoConsoleVariable<float> CVarAllyNetFollowedPlayerPriorityScale(
+	TEXT("ally.Net.FollowedPlayerPriorityScale"),
+	2.f,
+	TEXT("How much the network priority of an ally is scaled by for the player that it follows."),
+	ECVF_Default);
+
+const FName AAllyCharacter::BoxColliderName(TEXT("BoxCollider"));
+const FVector AAllyCharacter::WaypointArrivalExtent(90.f, 90.f, 85.f);
 
 /**
  * Sets the default values for the AllyCharacter.
  */
-AAllyCharacter::AAllyCharacter()
+AAllyCharacter::AAllyCharacter(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
 {
-	static ConstructorHelpers::FObjectFinder<USkeletalMesh>AllySkeletalMeshAsset(TEXT("SkeletalMesh'/Game/Mannequin/Character/Mesh/SK_Mannequin.SK_Mannequin'"));
-	static ConstructorHelpers::FObjectFinder<UAnimBlueprint>AllyAnimBlueprint(TEXT("AnimBlueprint'/Game/Blueprints/AllyAnimBlueprint.AllyAnimBlueprint'"));
-
-	// Set the SkeletalMeshComponent to the Character's mesh and adjust its properties.
+	// Set the SkeletalMeshComponent to the Character's mesh and adjust its properties. The
+	// mesh and animations themselves come from the AllyAssetSubsystem in `ApplyVariant`.
 	AllySkeletalMesh = GetMesh();
-	AllySkeletalMesh->SetSkeletalMesh(AllySkeletalMeshAsset.Object);
 	AllySkeletalMesh->SetRelativeLocationAndRotation(FVector(0.f, 0.f, -90.f), FRotator(0.f, -90.f, 0.f));
-	AllySkeletalMesh->SetAnimInstanceClass(AllyAnimBlueprint.Object->GeneratedClass);
 
-	// Set the initial speed to the `WalkSpeed`.
-	GetCharacterMovement()->MaxWalkSpeed = WalkSpeed;
+	// Set the initial speed to the default walking speed. `ApplyTuning` moves it to the
+	// `Tuning` asset's once the AllyCharacter begins play.
+	TargetMaxWalkSpeed = GetDefault<UAllyTuning>()->WalkSpeed;
+	GetCharacterMovement()->MaxWalkSpeed = TargetMaxWalkSpeed;
 
-	// Create the BoxComponent, set its extents, and attach it to the Root.
-	AllyBoxCollider = CreateDefaultSubobject<UBoxComponent>(TEXT("BoxCollider"));
-	AllyBoxCollider->SetBoxExtent(FVector(90.f, 90.f, 85.f));
-	AllyBoxCollider->SetGenerateOverlapEvents(true);
-	AllyBoxCollider->SetCollisionProfileName(TEXT("Trigger"));
-	AllyBoxCollider->OnComponentBeginOverlap.AddDynamic(this, &AAllyCharacter::OnComponentEnterBoxCollider);
-	AllyBoxCollider->SetupAttachment(RootComponent);
+	// Create the BoxComponent, set its extents, and attach it to the Root. It's optional so
+	// that compact allies can leave it out.
+	AllyBoxCollider = CreateOptionalDefaultSubobject<UBoxComponent>(BoxColliderName);
+	if (AllyBoxCollider != nullptr)
+	{
+		AllyBoxCollider->SetBoxExtent(WaypointArrivalExtent);
+		AllyBoxCollider->SetGenerateOverlapEvents(true);
+		AllyBoxCollider->SetCollisionProfileName(TEXT("Trigger"));
+		AllyBoxCollider->OnComponentBeginOverlap.AddDynamic(this, &AAllyCharacter::OnComponentEnterBoxCollider);
+		AllyBoxCollider->SetupAttachment(RootComponent);
+	}
+
+	// The AllyCharacter's decisions are only made on the server so clients get the packed
+	// `ReplicatedState` and a less frequent copy of its movement, which the AllyCrowdSubsystem
+	// lowers further for allies in the MEDIUM and LOW tiers.
+	bReplicates = true;
+	NetUpdateFrequency = 20.f;
+	MinNetUpdateFrequency = 2.f;
 }
 
 /**
@@ -37,25 +84,242 @@ void AAllyCharacter::BeginPlay()
 {
 	Super::BeginPlay();
 
-	// Get all of the WaypointActors in the level.
-	TArray<AActor*> FoundActors;
-	UGameplayStatics::GetAllActorsOfClass(GetWorld(), AWaypointActor::StaticClass(), FoundActors);
+	ApplyVariant();
+	ApplyTuning();
+	ApplyWaypointSpatialHash();
 
-	// For each WaypointActor we found we have to try and cast it as a WaypointActor
-	// as they are found as Actors not WaypointActors. If we can successfully cast it
-	// to a WaypointActor then we add it to the WaypointActors map.
-	for (AActor* FoundActor : FoundActors)
-	{
-		AWaypointActor* Waypoint = Cast<AWaypointActor>(FoundActor);
+	const float CullDistance = CVarAllyNetCullDistance.GetValueOnGameThread();
+	NetCullDistanceSquared = CullDistance * CullDistance;
+}
+
+/**
+ * Called every frame, on the server and on clients.
+ *
+ * @param DeltaTime The time since the last frame.
+ */
+void AAllyCharacter::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	// Clients only get told whether the AllyCharacter is sprinting, so the speed is ramped
+	// here rather than by the AllyCrowdSubsystem, which only runs the allies on the server.
+	UpdateWalkSpeed(DeltaTime);
+}
+
+/**
+ * Gives the AllyCharacter the mesh and animations of its `VariantName`, streaming them
+ * in first if they aren't in memory yet.
+ */
+void AAllyCharacter::ApplyVariant()
+{
+	UGameInstance* GameInstance = GetGameInstance();
+	UAllyAssetSubsystem* AllyAssets = GameInstance != nullptr ? GameInstance->GetSubsystem<UAllyAssetSubsystem>() : nullptr;
+	if (AllyAssets != nullptr) AllyAssets->ApplyAllyVariant(AllySkeletalMesh, VariantName);
+}
+
+/**
+ * Called on clients when the server changes the AllyCharacter's `VariantName`.
+ */
+void AAllyCharacter::OnRep_VariantName()
+{
+	ApplyVariant();
+}
+
+/**
+ * Called to set up the properties that are replicated to clients.
+ */
+void AAllyCharacter::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(AAllyCharacter, ReplicatedState);
+	DOREPLIFETIME(AAllyCharacter, VariantName);
+}
+
+/**
+ * Returns whether the AllyCharacter should be replicated to a client.
+ */
+bool AAllyCharacter::IsNetRelevantFor(const AActor* RealViewer, const AActor* ViewTarget, const FVector& SrcLocation) const
+{
+	// The player being followed always needs to see their allies, however far away they are.
+	if (PlayerCharacter != nullptr && (ViewTarget == PlayerCharacter || RealViewer == PlayerCharacter->GetController())) return true;
+
+	return Super::IsNetRelevantFor(RealViewer, ViewTarget, SrcLocation);
+}
+
+/**
+ * Returns how urgently the AllyCharacter should be replicated to a client.
+ */
+float AAllyCharacter::GetNetPriority(const FVector& ViewPos, const FVector& ViewDir, AActor* Viewer, AActor* ViewTarget, UActorChannel* InChannel, float Time, bool bLowBandwidth)
+{
+	float Priority = Super::GetNetPriority(ViewPos, ViewDir, Viewer, ViewTarget, InChannel, Time, bLowBandwidth);
 
-		// If we can successfully cast the Actor to a WaypointActor then we add it to
-		// the map with the WaypointNumber as the key and WaypointActor as the value.
-		if (Waypoint != nullptr) Waypoints.Add(Waypoint->WaypointNumber, Waypoint);
+	switch (FAllyLOD::GetTier(FVector::DistSquared(ViewPos, GetActorLocation()), true))
+	{
+	case EAllyLODTier::MEDIUM: Priority *= CVarAllyNetMediumPriorityScale.GetValueOnGameThread(); break;
+	case EAllyLODTier::LOW: Priority *= CVarAllyNetLowPriorityScale.GetValueOnGameThread(); break;
+	default: break;
 	}
 
-	// After all of the Waypoints have been added to the Waypoints map then we sort the
-	// map by its keys, which are the WaypointNumbers.
-	Waypoints.KeySort([](int A, int B) { return A < B; });
+	if (PlayerCharacter != nullptr && ViewTarget == PlayerCharacter) Priority *= CVarAllyNetFollowedPlayerPriorityScale.GetValueOnGameThread();
+
+	return Priority;
+}
+
+/**
+ * Packs the AllyCharacter's state into `ReplicatedState` if it changed and sets how often
+ * its movement is sent for its EAllyLODTier.
+ *
+ * @param WaypointRegistry The registry used to turn WaypointActors into indices.
+ */
+void AAllyCharacter::UpdateReplicatedState(const UWaypointRegistrySubsystem* WaypointRegistry)
+{
+	const FAllyReplicatedState Packed = FAllyReplicatedState::Pack(*this, WaypointRegistry);
+	if (Packed != ReplicatedState) ReplicatedState = Packed;
+
+	// Movement is most of what an AllyCharacter sends, so allies that are far away or off
+	// screen send it less often.
+	const float BaseNetUpdateFrequency = GetClass()->GetDefaultObject<AAllyCharacter>()->NetUpdateFrequency;
+	NetUpdateFrequency = FMath::Max(BaseNetUpdateFrequency * FAllyLOD::GetNetUpdateFrequencyScale(LODTier), MinNetUpdateFrequency);
+}
+
+/**
+ * Called on clients when a new `ReplicatedState` arrives from the server.
+ */
+void AAllyCharacter::OnRep_ReplicatedState()
+{
+	const UWorld* World = GetWorld();
+	ReplicatedState.Unpack(*this, World != nullptr ? World->GetSubsystem<UWaypointRegistrySubsystem>() : nullptr);
+}
+
+/**
+ * Points the AllyCharacter's maximum speed at its walking or sprinting speed, which may
+ * have changed along with the `Tuning` asset.
+ */
+void AAllyCharacter::ApplyTuning()
+{
+	SetTargetMaxWalkSpeed(bIsSprinting ? GetSprintSpeed() : GetWalkSpeed());
+}
+
+/**
+ * Returns the `Tuning` asset, or the UAllyTuning defaults if there isn't one.
+ */
+const UAllyTuning* AAllyCharacter::GetTuning() const
+{
+	return Tuning != nullptr ? Tuning : GetDefault<UAllyTuning>();
+}
+
+// Returns the AllyCharacter's override of a distance or speed if its `bOverride_` flag is
+// set, and the value from the `Tuning` asset otherwise.
+#define ALLY_TUNED_VALUE(Name) (TuningOverrides != nullptr && TuningOverrides->bOverride_##Name ? TuningOverrides->Name : GetTuning()->Name)
+
+/**
+ * Returns the minimum distance the AllyCharacter should be from the PlayerCharacter.
+ */
+float AAllyCharacter::GetMinDistanceFromPlayer() const
+{
+	return ALLY_TUNED_VALUE(MinDistanceFromPlayer);
+}
+
+/**
+ * Returns the maximum distance the AllyCharacter should be from the PlayerCharacter.
+ */
+float AAllyCharacter::GetMaxDistanceFromPlayer() const
+{
+	return ALLY_TUNED_VALUE(MaxDistanceFromPlayer);
+}
+
+/**
+ * Returns the distance from the PlayerCharacter at which the AllyCharacter starts sprinting.
+ */
+float AAllyCharacter::GetMaxDistanceFromPlayerBeforeSprint() const
+{
+	return ALLY_TUNED_VALUE(MaxDistanceFromPlayerBeforeSprint);
+}
+
+/**
+ * Returns how much closer than `GetMaxDistanceFromPlayerBeforeSprint` the AllyCharacter
+ * has to get to the PlayerCharacter before it stops sprinting.
+ */
+float AAllyCharacter::GetSprintHysteresis() const
+{
+	return ALLY_TUNED_VALUE(SprintHysteresis);
+}
+
+/**
+ * Returns the distance from the PlayerCharacter at which a sprinting AllyCharacter stops sprinting.
+ */
+float AAllyCharacter::GetSprintExitDistance() const
+{
+	return FMath::Max(0.f, GetMaxDistanceFromPlayerBeforeSprint() - GetSprintHysteresis());
+}
+
+/**
+ * Returns the distance from the PlayerCharacter at which a leading AllyCharacter waits for them.
+ */
+float AAllyCharacter::GetMaxDistanceFromPlayerWhileLeading() const
+{
+	return ALLY_TUNED_VALUE(MaxDistanceFromPlayerWhileLeading);
+}
+
+/**
+ * Returns how far ahead, in seconds, the PlayerCharacter's location is predicted.
+ */
+float AAllyCharacter::GetFollowPredictionTime() const
+{
+	return ALLY_TUNED_VALUE(FollowPredictionTime);
+}
+
+/**
+ * Returns the speed at which the AllyCharacter walks.
+ */
+float AAllyCharacter::GetWalkSpeed() const
+{
+	return ALLY_TUNED_VALUE(WalkSpeed);
+}
+
+/**
+ * Returns the speed at which the AllyCharacter sprints.
+ */
+float AAllyCharacter::GetSprintSpeed() const
+{
+	return ALLY_TUNED_VALUE(SprintSpeed);
+}
+
+/**
+ * Returns how quickly the AllyCharacter's maximum speed moves between walking and sprinting.
+ */
+float AAllyCharacter::GetSpeedChangeRate() const
+{
+	return ALLY_TUNED_VALUE(SpeedChangeRate);
+}
+
+#undef ALLY_TUNED_VALUE
+
+/**
+ * Turns the overlap events of the `AllyBoxCollider` off when arriving at waypoints is
+ * checked with the WaypointRegistrySubsystem's grid, or back on when it isn't.
+ */
+void AAllyCharacter::ApplyWaypointSpatialHash()
+{
+	if (AllyBoxCollider == nullptr) return;
+
+	// If arriving at waypoints is checked with the WaypointRegistrySubsystem's grid then
+	// the box collider doesn't need to generate overlap events or collide at all.
+	AllyBoxCollider->SetCollisionEnabled(bUseWaypointSpatialHash ? ECollisionEnabled::NoCollision : ECollisionEnabled::QueryOnly);
+
+	// Clients are told by the server when the AllyCharacter arrives at a waypoint, so
+	// there's no need for them to generate overlaps for it either.
+	AllyBoxCollider->SetGenerateOverlapEvents(!bUseWaypointSpatialHash && HasAuthority());
+}
+
+/**
+ * Returns the box used to check whether the AllyCharacter has arrived at a WaypointActor.
+ */
+FBox AAllyCharacter::GetWaypointArrivalBounds() const
+{
+	const FVector Extent = AllyBoxCollider != nullptr ? AllyBoxCollider->GetScaledBoxExtent() : WaypointArrivalExtent * GetActorScale3D();
+	return FBox::BuildAABB(GetActorLocation(), Extent);
 }
 
 /**
@@ -63,27 +327,57 @@ void AAllyCharacter::BeginPlay()
  */
 void AAllyCharacter::OnComponentEnterBoxCollider(UPrimitiveComponent* OverlappedComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
 {
+	ALLY_AI_SCOPE(STAT_AllyOnComponentEnterBoxCollider);
+
 	// Return early if anything is null so we can avoid a potential crash.
 	if ((OtherActor == nullptr) || (OtherActor == this) || (OtherComp == nullptr)) return;
 
 	// Try to cast the `OtherActor` to a WaypointActor.
 	AWaypointActor* Waypoint = Cast<AWaypointActor>(OtherActor);
 
-	// If the AllyCharacter is in the LEAD state and we were able to successfully cast the `OtherActor`
-	// to a WaypointActor, then we set `bIsAtCurrentWaypoint` to `true`.
-	if (State == AllyStates::LEAD && Waypoint != nullptr) 
+	// If the AllyCharacter is in the LEAD state and the `OtherActor` is the WaypointActor that the
+	// AllyCharacter is moving towards, then we set `bIsAtCurrentWaypoint` to `true`. Passing
+	// through any other WaypointActor on the way doesn't count.
+	if (State == AllyStates::LEAD && Waypoint != nullptr && Waypoint == CurrentWaypoint)
 	{
 		bIsAtCurrentWaypoint = true;
 	}
 }
 
+/**
+ * Puts the AllyCharacter back in the state it was spawned in so that it can be reused
+ * by the AllyPoolSubsystem.
+ */
+void AAllyCharacter::ResetAllyState()
+{
+	State = AllyStates::FOLLOW;
+	CurrentWaypoint = nullptr;
+	EndWaypoint = nullptr;
+	bIsAtCurrentWaypoint = false;
+	bShouldWaitForPlayerWhenLeading = false;
+	LODTier = EAllyLODTier::HIGH;
+	ReplicatedState = FAllyReplicatedState();
+
+	// Going back in the pool isn't a sprint decision so it isn't counted as a toggle.
+	SetSprinting(false);
+
+	// A pooled AllyCharacter comes back at walking speed rather than ramping down to it.
+	TargetMaxWalkSpeed = GetWalkSpeed();
+	if (GetCharacterMovement())
+	{
+		GetCharacterMovement()->MaxWalkSpeed = TargetMaxWalkSpeed;
+		GetCharacterMovement()->StopMovementImmediately();
+	}
+}
+
 /**
  * Called to make the AllyCharacter sprint.
  */
 void AAllyCharacter::SprintStart()
 {
-	bIsSprinting = true;
-	if (GetCharacterMovement()) GetCharacterMovement()->MaxWalkSpeed = SprintSpeed;
+	if (!bIsSprinting) FAllyAICounters::Increment(EAllyAICounter::SprintToggles);
+
+	SetSprinting(true);
 }
 
 /**
@@ -91,6 +385,48 @@ void AAllyCharacter::SprintStart()
  */
 void AAllyCharacter::SprintStop()
 {
-	bIsSprinting = false;
-	if (GetCharacterMovement()) GetCharacterMovement()->MaxWalkSpeed = WalkSpeed;
+	if (bIsSprinting) FAllyAICounters::Increment(EAllyAICounter::SprintToggles);
+
+	SetSprinting(false);
+}
+
+/**
+ * Sets whether the AllyCharacter is sprinting without counting it as a sprint toggle, for
+ * clients copying the server's decision or for allies going into or coming out of the pool.
+ *
+ * @param bSprint Whether the AllyCharacter should be sprinting.
+ */
+void AAllyCharacter::SetSprinting(bool bSprint)
+{
+	bIsSprinting = bSprint;
+	SetTargetMaxWalkSpeed(bSprint ? GetSprintSpeed() : GetWalkSpeed());
+}
+
+/**
+ * Sets the speed that the AllyCharacter's maximum speed moves towards.
+ *
+ * @param Speed The new maximum speed.
+ */
+void AAllyCharacter::SetTargetMaxWalkSpeed(float Speed)
+{
+	TargetMaxWalkSpeed = Speed;
+
+	// Without a rate the speed changes straight away like it used to.
+	if (GetSpeedChangeRate() <= 0.f && GetCharacterMovement()) GetCharacterMovement()->MaxWalkSpeed = Speed;
+}
+
+/**
+ * Moves the AllyCharacter's maximum speed towards the speed it was last told to walk or sprint at.
+ *
+ * @param DeltaTime The time since the last frame.
+ */
+void AAllyCharacter::UpdateWalkSpeed(float DeltaTime)
+{
+	UCharacterMovementComponent* Movement = GetCharacterMovement();
+	if (Movement == nullptr || Movement->MaxWalkSpeed == TargetMaxWalkSpeed) return;
+
+	// Ramping the speed instead of switching it means the AllyCharacter doesn't lurch when
+	// it starts or stops sprinting and its movement blends smoothly between the two.
+	const float ChangeRate = GetSpeedChangeRate();
+	Movement->MaxWalkSpeed = ChangeRate > 0.f ? FMath::FInterpConstantTo(Movement->MaxWalkSpeed, TargetMaxWalkSpeed, DeltaTime, ChangeRate) : TargetMaxWalkSpeed;
 }
@@ -2,6 +2,8 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
+#include "AllyLOD.h"
+#include "AllyReplicatedState.h"
 #include "AllyCharacter.generated.h"
 
 /**
@@ -23,13 +25,21 @@ class FOLLOWLEADAI_API AAllyCharacter : public ACharacter
 
 public:
 	// Sets default values for this character's properties.
-	AAllyCharacter();
+	AAllyCharacter(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
+
+	// The name of the `AllyBoxCollider` subobject, which subclasses can choose not to create.
+	static const FName BoxColliderName;
+
+	// The half size of the box used to check whether the AllyCharacter has arrived at a
+	// WaypointActor, matching the extent of the `AllyBoxCollider`.
+	static const FVector WaypointArrivalExtent;
 
 	// The SkeletalMeshComponent of the AllyCharacter.
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite)
 	class USkeletalMeshComponent* AllySkeletalMesh;
 
-	// The BoxComponent that to use as a trigger for detecting Waypoints.
+	// The BoxComponent that to use as a trigger for detecting Waypoints. Compact allies
+	// don't have one and always use the WaypointRegistrySubsystem's grid instead.
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	class UBoxComponent* AllyBoxCollider;
 
@@ -45,23 +55,35 @@ public:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
 	bool bIsSprinting = false;
 
-	// The minimum distance the AllyCharacter should be from the PlayerCharacter.
+	// The distances and speeds shared by every AllyCharacter of the same kind. Without one
+	// the AllyCharacter uses the defaults of UAllyTuning.
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Ally)
-	float MinDistanceFromPlayer = 100.f;
+	class UAllyTuning* Tuning = nullptr;
+
+	// The distances and speeds that this AllyCharacter uses instead of the ones from `Tuning`.
+	// Only the values whose `bOverride_` flag is set are used, and most AllyCharacters don't
+	// need one at all.
+	UPROPERTY(EditAnywhere, Instanced, BlueprintReadWrite, Category = Ally)
+	class UAllyTuningOverrides* TuningOverrides = nullptr;
 
-	// The maximum distance the AllyCharacter should be from the PlayerCharacter.
+	// Indicates whether the AllyCharacter shares one path to the PlayerCharacter with
+	// every other AllyCharacter following them and walks to its own formation slot
+	// along that path, instead of finding its own path to the PlayerCharacter.
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Ally)
-	float MaxDistanceFromPlayer = 500.f;
+	bool bUseGroupFollow = false;
 
-	// The maximum distance the AllyCharacter can be from the PlayerCharacter before
-	// they start sprinting to catch up to the PlayerCharacter.
+	// Indicates whether the AllyCharacter heads for where the PlayerCharacter is going to be,
+	// predicted from their recent movement, instead of where they are right now, so that it
+	// keeps up without having to repath and sprint as often.
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Ally)
-	float MaxDistanceFromPlayerBeforeSprint = MaxDistanceFromPlayer + 100.f;
+	bool bUsePredictiveFollow = false;
 
-	// The maximum distance the PlayerCharacter can be from the AllyCharacter when
-	// following before the AllyCharacter waits for them to catch up.
+	// Indicates whether the AllyCharacter is steered by the detour crowd simulation so that
+	// it avoids and keeps apart from the allies around it instead of pushing into them.
+	// Paths that were put together from points, such as shared group paths, can't be
+	// steered along so the AllyCharacter finds its own path when this is on.
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Ally)
-	float MaxDistanceFromPlayerWhileLeading = 500.f;
+	bool bUseCrowdAvoidance = false;
 
 	// The WaypointActor that the AllyCharacter is currently moving towards.
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
@@ -76,28 +98,114 @@ public:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
 	bool bIsAtCurrentWaypoint = false;
 
-	// A map of all of the Waypoints in the current level.
-	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
-	TMap<int, AWaypointActor*> Waypoints;
+	// Indicates whether the AllyCharacter checks if it has arrived at its `CurrentWaypoint`
+	// using the WaypointRegistrySubsystem's grid of waypoint bounds instead of overlap events
+	// on the `AllyBoxCollider`, which saves the cost of generating overlaps while moving.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Ally)
+	bool bUseWaypointSpatialHash = false;
+
+	// Which of the AllyVariants in the Ally Assets project settings the AllyCharacter is
+	// drawn as. None is the first one.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, ReplicatedUsing = OnRep_VariantName, Category = Ally)
+	FName VariantName;
 
 	// Indicates whether the AllyCharacter should wait for the PlayerCharacter when leading.
 	// This is set by the AllyAIController.
 	bool bShouldWaitForPlayerWhenLeading = false;
 
+	// How much attention the AllyCharacter gets based on how far it is from the PlayerCharacter's
+	// camera and whether it is on screen. This is set by the AllyCrowdSubsystem.
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Ally)
+	EAllyLODTier LODTier = EAllyLODTier::HIGH;
+
 protected:
-	// The speed at which the AllyCharacter should walk at.
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Movement)
-	float WalkSpeed = 200.f;
+	// The maximum speed that the AllyCharacter's maximum speed is moving towards.
+	float TargetMaxWalkSpeed = 0.f;
 
-	// The speed at which the AllyCharacter should sprint at.
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Movement)
-	float SprintSpeed = 500.f;
+	// The packed copy of the AllyCharacter's state that the server sends to clients.
+	// This is kept up to date by the AllyCrowdSubsystem on the server.
+	UPROPERTY(ReplicatedUsing = OnRep_ReplicatedState)
+	FAllyReplicatedState ReplicatedState;
 
 public:
 	/**
 	 * Called when the AllyCharacter is created.
 	 */
-	void BeginPlay() override;
+	virtual void BeginPlay() override;
+
+	/**
+	 * Called every frame, on the server and on clients.
+	 *
+	 * @param DeltaTime The time since the last frame.
+	 */
+	virtual void Tick(float DeltaTime) override;
+
+	/**
+	 * Called to set up the properties that are replicated to clients.
+	 */
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	/**
+	 * Returns whether the AllyCharacter should be replicated to a client. Allies are always
+	 * relevant to the PlayerCharacter they follow and otherwise only within `ally.Net.CullDistance`.
+	 */
+	virtual bool IsNetRelevantFor(const AActor* RealViewer, const AActor* ViewTarget, const FVector& SrcLocation) const override;
+
+	/**
+	 * Returns how urgently the AllyCharacter should be replicated to a client, which drops
+	 * with the same distance tiers that are used for the AllyCharacter's LOD.
+	 */
+	virtual float GetNetPriority(const FVector& ViewPos, const FVector& ViewDir, AActor* Viewer, AActor* ViewTarget, UActorChannel* InChannel, float Time, bool bLowBandwidth) override;
+
+	/**
+	 * Packs the AllyCharacter's state into `ReplicatedState`, only touching it when the
+	 * packed state actually changed so that nothing is sent for an unchanged ally, and sets
+	 * how often its movement is sent for its EAllyLODTier.
+	 *
+	 * @param WaypointRegistry The registry used to turn WaypointActors into indices.
+	 */
+	void UpdateReplicatedState(const class UWaypointRegistrySubsystem* WaypointRegistry);
+
+	/**
+	 * Called on clients when a new `ReplicatedState` arrives from the server.
+	 */
+	UFUNCTION()
+	void OnRep_ReplicatedState();
+
+	/**
+	 * Gives the AllyCharacter the mesh and animations of its `VariantName`, streaming them
+	 * in first if they aren't in memory yet.
+	 */
+	void ApplyVariant();
+
+	/**
+	 * Called on clients when the server changes the AllyCharacter's `VariantName`.
+	 */
+	UFUNCTION()
+	void OnRep_VariantName();
+
+	/**
+	 * Points the AllyCharacter's maximum speed at its walking or sprinting speed, which may
+	 * have changed along with the `Tuning` asset.
+	 */
+	void ApplyTuning();
+
+	/**
+	 * Turns the overlap events of the `AllyBoxCollider` off when arriving at waypoints is
+	 * checked with the WaypointRegistrySubsystem's grid, or back on when it isn't.
+	 */
+	void ApplyWaypointSpatialHash();
+
+	/**
+	 * Returns whether arriving at waypoints is checked with the WaypointRegistrySubsystem's
+	 * grid, which is always the case for compact allies without an `AllyBoxCollider`.
+	 */
+	bool UsesWaypointSpatialHash() const { return bUseWaypointSpatialHash || AllyBoxCollider == nullptr; }
+
+	/**
+	 * Returns the box used to check whether the AllyCharacter has arrived at a WaypointActor.
+	 */
+	FBox GetWaypointArrivalBounds() const;
 
 	/**
 	 * Called when a component enters the AllyCharacter's box collider.
@@ -105,6 +213,71 @@ public:
 	UFUNCTION()
 	void OnComponentEnterBoxCollider(UPrimitiveComponent* OverlappedComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
 
+	/**
+	 * Puts the AllyCharacter back in the state it was spawned in so that it can be reused
+	 * by the AllyPoolSubsystem.
+	 */
+	void ResetAllyState();
+
+	/**
+	 * Returns the minimum distance the AllyCharacter should be from the PlayerCharacter.
+	 */
+	float GetMinDistanceFromPlayer() const;
+
+	/**
+	 * Returns the maximum distance the AllyCharacter should be from the PlayerCharacter.
+	 */
+	float GetMaxDistanceFromPlayer() const;
+
+	/**
+	 * Returns the distance from the PlayerCharacter at which the AllyCharacter starts sprinting.
+	 */
+	float GetMaxDistanceFromPlayerBeforeSprint() const;
+
+	/**
+	 * Returns how much closer than `GetMaxDistanceFromPlayerBeforeSprint` the AllyCharacter
+	 * has to get to the PlayerCharacter before it stops sprinting.
+	 */
+	float GetSprintHysteresis() const;
+
+	/**
+	 * Returns the distance from the PlayerCharacter at which a sprinting AllyCharacter stops sprinting.
+	 */
+	float GetSprintExitDistance() const;
+
+	/**
+	 * Returns the distance from the PlayerCharacter at which a leading AllyCharacter waits for them.
+	 */
+	float GetMaxDistanceFromPlayerWhileLeading() const;
+
+	/**
+	 * Returns how far ahead, in seconds, the PlayerCharacter's location is predicted.
+	 */
+	float GetFollowPredictionTime() const;
+
+	/**
+	 * Returns the speed at which the AllyCharacter walks.
+	 */
+	float GetWalkSpeed() const;
+
+	/**
+	 * Returns the speed at which the AllyCharacter sprints.
+	 */
+	float GetSprintSpeed() const;
+
+	/**
+	 * Returns how quickly the AllyCharacter's maximum speed moves between walking and sprinting.
+	 */
+	float GetSpeedChangeRate() const;
+
+	/**
+	 * Moves the AllyCharacter's maximum speed towards the speed it was last told to walk
+	 * or sprint at. This is called from `Tick` so that clients ramp the speed too.
+	 *
+	 * @param DeltaTime The time since the last frame.
+	 */
+	void UpdateWalkSpeed(float DeltaTime);
+
 	/**
 	 * Called to make the AllyCharacter sprint.
 	 */
@@ -116,4 +289,27 @@ public:
 	 */
 	UFUNCTION()
 	void SprintStop();
+
+	/**
+	 * Sets whether the AllyCharacter is sprinting without counting it as a sprint toggle,
+	 * for clients copying the decision the server already made and counted, or for allies
+	 * going into or coming back out of the AllyPoolSubsystem.
+	 *
+	 * @param bSprint Whether the AllyCharacter should be sprinting.
+	 */
+	void SetSprinting(bool bSprint);
+
+protected:
+	/**
+	 * Sets the speed that the AllyCharacter's maximum speed moves towards.
+	 *
+	 * @param Speed The new maximum speed.
+	 */
+	void SetTargetMaxWalkSpeed(float Speed);
+
+private:
+	/**
+	 * Returns the `Tuning` asset, or the UAllyTuning defaults if there isn't one.
+	 */
+	const UAllyTuning* GetTuning() const;
 };
@@ -0,0 +1,18 @@
+#include "AllyCompactCharacter.h"
+#include "Components/SkeletalMeshComponent.h"
+
+/**
+ * Sets the default values for the AllyCompactCharacter.
+ */
+AAllyCompactCharacter::AAllyCompactCharacter(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer.DoNotCreateDefaultSubobject(AAllyCharacter::BoxColliderName))
+{
+	bUseWaypointSpatialHash = true;
+
+	// The capsule already collides with the world so the mesh only needs to be drawn, and
+	// there's no point working out a pose that nobody can see.
+	AllySkeletalMesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	AllySkeletalMesh->SetGenerateOverlapEvents(false);
+	AllySkeletalMesh->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::OnlyTickPoseWhenRendered;
+	AllySkeletalMesh->bEnableUpdateRateOptimizations = true;
+}
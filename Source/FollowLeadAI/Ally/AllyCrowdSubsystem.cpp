@@ -0,0 +1,778 @@
+#include "AllyCrowdSubsystem.h"
+#include "AllyAIController.h"
+#include "AllyCharacter.h"
+#include "AllyStats.h"
+#include "../Player/PlayerCharacter.h"
+#include "../WaypointRegistrySubsystem.h"
+#include "Animation/AnimInstance.h"
+#include "Async/ParallelFor.h"
+#include "Camera/CameraComponent.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+#include "Serialization/ArchiveCountMem.h"
+#include "UObject/UObjectIterator.h"
+
+// The maximum number of allies that the batched update will visit in a single
+// frame. Allies that don't fit in the budget are picked up first next frame.
+static TAutoConsoleVariable<int32> CVarAllyCrowdMaxUpdatesPerFrame(
+	TEXT("ally.Crowd.MaxUpdatesPerFrame"),
+	128,
+	TEXT("The maximum number of allies the AllyCrowdSubsystem updates per frame. 0 means no limit."),
+	ECVF_Default);
+
+// The number of threads that the ally decisions are split across.
+static TAutoConsoleVariable<int32> CVarAllyCrowdDecisionWorkers(
+	TEXT("ally.Crowd.DecisionWorkers"),
+	0,
+	TEXT("The number of threads the ally decisions are split across. 0 uses every worker thread and the game thread, 1 makes them on the game thread."),
+	ECVF_Default);
+
+// The fewest allies worth handing to another thread.
+static TAutoConsoleVariable<int32> CVarAllyCrowdMinAlliesPerWorker(
+	TEXT("ally.Crowd.MinAlliesPerWorker"),
+	64,
+	TEXT("The fewest allies that are worth handing to another thread when the ally decisions are split across threads."),
+	ECVF_Default);
+
+// The most navmesh path queries that queued moves can make in a single frame.
+static TAutoConsoleVariable<int32> CVarAllyMoveMaxPathQueriesPerFrame(
+	TEXT("ally.Move.MaxPathQueriesPerFrame"),
+	32,
+	TEXT("The most navmesh path queries that queued ally moves can make per frame. Moves along a reused path don't count. 0 sends every move straight away."),
+	ECVF_Default);
+
+// How long, in seconds, a queued move can wait before it goes ahead of the more urgent ones.
+static TAutoConsoleVariable<float> CVarAllyMoveMaxQueueDelay(
+	TEXT("ally.Move.MaxQueueDelay"),
+	0.5f,
+	TEXT("How long a queued ally move can wait before it is sent ahead of moves that are more urgent."),
+	ECVF_Default);
+
+// The shortest time, in seconds, between an ally starting and stopping sprinting.
+static TAutoConsoleVariable<float> CVarAllySprintMinToggleInterval(
+	TEXT("ally.Sprint.MinToggleInterval"),
+	1.5f,
+	TEXT("The shortest time between an ally starting and stopping sprinting, on top of the distance hysteresis."),
+	ECVF_Default);
+
+// The number of slices that each lead interval is split into. Allies that start leading
+// together are spread across the slices so their lead checks don't all land on one frame.
+static TAutoConsoleVariable<int32> CVarAllyLeadTimeSlices(
+	TEXT("ally.Lead.TimeSlices"),
+	8,
+	TEXT("The number of slices the lead interval is split into so that allies told to lead together are checked on different frames."),
+	ECVF_Default);
+
+// How long ago, in seconds, an ally must have been rendered to count as visible.
+static TAutoConsoleVariable<float> CVarAllyLODVisibilityTolerance(
+	TEXT("ally.LOD.VisibilityTolerance"),
+	0.25f,
+	TEXT("How long ago an ally must have been rendered to count as visible when its LOD tier is picked."),
+	ECVF_Default);
+
+// Logs how many allies are in each LOD tier in every world.
+static FAutoConsoleCommand AllyLODStatsCommand(
+	TEXT("ally.LOD.Stats"),
+	TEXT("Logs how many allies are in each LOD tier."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		for (TObjectIterator<UAllyCrowdSubsystem> It; It; ++It)
+		{
+			if (It->HasAnyFlags(RF_ClassDefaultObject) || It->GetWorld() == nullptr) continue;
+
+			UE_LOG(LogTemp, Display, TEXT("Ally LOD in %s: %d allies, %d HIGH, %d MEDIUM, %d LOW"), *It->GetWorld()->GetName(), It->GetNumAllies(),
+				It->GetNumAlliesInTier(EAllyLODTier::HIGH), It->GetNumAlliesInTier(EAllyLODTier::MEDIUM), It->GetNumAlliesInTier(EAllyLODTier::LOW));
+		}
+	}));
+
+/**
+ * Adds up the memory used by an object the same way the obj list in memreport does.
+ */
+static int64 GetObjectBytes(UObject* Object)
+{
+	FArchiveCountMem CountMem(Object);
+	return int64(CountMem.GetMax()) + int64(Object->GetResourceSizeBytes(EResourceSizeMode::Exclusive));
+}
+
+/**
+ * Adds the memory used by an actor and each of its components to a breakdown by class.
+ */
+static void AddActorBytes(AActor* Actor, TMap<UClass*, int64>& BytesByClass)
+{
+	if (Actor == nullptr) return;
+
+	BytesByClass.FindOrAdd(Actor->GetClass()) += GetObjectBytes(Actor);
+
+	TInlineComponentArray<UActorComponent*> Components(Actor);
+	for (UActorComponent* Component : Components)
+	{
+		BytesByClass.FindOrAdd(Component->GetClass()) += GetObjectBytes(Component);
+
+		// Every SkeletalMeshComponent has its own AnimInstance.
+		const USkeletalMeshComponent* SkeletalMesh = Cast<USkeletalMeshComponent>(Component);
+		UAnimInstance* AnimInstance = SkeletalMesh != nullptr ? SkeletalMesh->GetAnimInstance() : nullptr;
+		if (AnimInstance != nullptr) BytesByClass.FindOrAdd(AnimInstance->GetClass()) += GetObjectBytes(AnimInstance);
+	}
+}
+
+// Logs how much memory each ally takes up on average in every world, broken down by the
+// class of each object an ally is made of, to compare AllyCharacter classes and settings.
+static FAutoConsoleCommand AllyMemReportCommand(
+	TEXT("ally.MemReport"),
+	TEXT("Logs the average number of bytes per ally, broken down by the class of each actor, component, and AnimInstance an ally is made of."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		for (TObjectIterator<UAllyCrowdSubsystem> It; It; ++It)
+		{
+			if (It->HasAnyFlags(RF_ClassDefaultObject) || It->GetWorld() == nullptr || It->GetNumAllies() == 0) continue;
+
+			TMap<UClass*, int64> BytesByClass;
+			for (AAllyAIController* Ally : It->GetAllies())
+			{
+				if (Ally == nullptr) continue;
+
+				AddActorBytes(Ally, BytesByClass);
+				AddActorBytes(Ally->GetPawn(), BytesByClass);
+			}
+
+			BytesByClass.ValueSort(TGreater<int64>());
+
+			const int32 NumAllies = It->GetNumAllies();
+			int64 TotalBytes = 0;
+			for (const TPair<UClass*, int64>& Pair : BytesByClass) TotalBytes += Pair.Value;
+
+			UE_LOG(LogTemp, Display, TEXT("Ally memory in %s: %d allies, %lld bytes per ally"), *It->GetWorld()->GetName(), NumAllies, TotalBytes / NumAllies);
+			for (const TPair<UClass*, int64>& Pair : BytesByClass)
+			{
+				UE_LOG(LogTemp, Display, TEXT("  %s: %lld bytes per ally"), *Pair.Key->GetName(), Pair.Value / NumAllies);
+			}
+		}
+	}));
+
+/**
+ * Called when the AllyCrowdSubsystem is created for a world.
+ */
+void UAllyCrowdSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	WaypointRegistry = Cast<UWaypointRegistrySubsystem>(Collection.InitializeDependency(UWaypointRegistrySubsystem::StaticClass()));
+	UpdateCursor = 0;
+}
+
+/**
+ * Called when the world the AllyCrowdSubsystem belongs to is torn down.
+ */
+void UAllyCrowdSubsystem::Deinitialize()
+{
+	for (AAllyAIController* Ally : Allies)
+	{
+		if (Ally != nullptr) Ally->CrowdIndex = INDEX_NONE;
+	}
+
+	Allies.Reset();
+	ActiveTasks.Reset();
+	NextSprintTimes.Reset();
+	NextLeadTimes.Reset();
+	NextRepathTimes.Reset();
+	LastRepathTimes.Reset();
+	LastSprintToggleTimes.Reset();
+	LODTiers.Reset();
+	QueuedMoves.Reset();
+	QueuedMoveTimes.Reset();
+	StateStore.Reset();
+	ArrivalWaypoints.Reset();
+	ArrivalBounds.Reset();
+	ArrivedAtWaypoints.Reset();
+	FollowGroups.Reset();
+
+	Super::Deinitialize();
+}
+
+/**
+ * Returns the shortest time, in seconds, between two sprint toggles of the same ally.
+ */
+float UAllyCrowdSubsystem::GetMinSprintToggleInterval()
+{
+	return CVarAllySprintMinToggleInterval.GetValueOnGameThread();
+}
+
+/**
+ * Returns the number of slices the lead interval of allies told to lead together is split into.
+ */
+int32 UAllyCrowdSubsystem::GetLeadTimeSlices()
+{
+	return CVarAllyLeadTimeSlices.GetValueOnGameThread();
+}
+
+/**
+ * Adds an AllyAIController to the batched update.
+ *
+ * @param Ally The AllyAIController to add.
+ */
+void UAllyCrowdSubsystem::RegisterAlly(AAllyAIController* Ally)
+{
+	if (Ally == nullptr || Ally->CrowdIndex != INDEX_NONE) return;
+
+	Ally->CrowdIndex = Allies.Add(Ally);
+	ActiveTasks.Add(EAllyCrowdTask::None);
+	NextSprintTimes.Add(0.f);
+	NextLeadTimes.Add(0.f);
+	NextRepathTimes.Add(0.f);
+	LastRepathTimes.Add(-MAX_FLT);
+	LastSprintToggleTimes.Add(-MAX_FLT);
+	LODTiers.Add(EAllyLODTier::HIGH);
+	QueuedMoves.Add(EAllyQueuedMove::None);
+	QueuedMoveTimes.Add(0.f);
+	StateStore.Add();
+}
+
+/**
+ * Removes an AllyAIController from the batched update.
+ *
+ * @param Ally The AllyAIController to remove.
+ */
+void UAllyCrowdSubsystem::UnregisterAlly(AAllyAIController* Ally)
+{
+	if (Ally == nullptr || !Allies.IsValidIndex(Ally->CrowdIndex) || Allies[Ally->CrowdIndex] != Ally) return;
+
+	const int32 Index = Ally->CrowdIndex;
+
+	// Swap the last ally into the removed slot so that the arrays stay packed and
+	// then let the ally that moved know about its new index.
+	Allies.RemoveAtSwap(Index, 1, false);
+	ActiveTasks.RemoveAtSwap(Index, 1, false);
+	NextSprintTimes.RemoveAtSwap(Index, 1, false);
+	NextLeadTimes.RemoveAtSwap(Index, 1, false);
+	NextRepathTimes.RemoveAtSwap(Index, 1, false);
+	LastRepathTimes.RemoveAtSwap(Index, 1, false);
+	LastSprintToggleTimes.RemoveAtSwap(Index, 1, false);
+	LODTiers.RemoveAtSwap(Index, 1, false);
+	QueuedMoves.RemoveAtSwap(Index, 1, false);
+	QueuedMoveTimes.RemoveAtSwap(Index, 1, false);
+	StateStore.RemoveAtSwap(Index);
+
+	if (Allies.IsValidIndex(Index) && Allies[Index] != nullptr) Allies[Index]->CrowdIndex = Index;
+
+	Ally->CrowdIndex = INDEX_NONE;
+}
+
+/**
+ * Starts or stops running one of the recurring tasks for an AllyAIController.
+ *
+ * @param Ally The AllyAIController to change the task of.
+ * @param Task The task to start or stop.
+ * @param bActive Whether the task should be running or not.
+ */
+void UAllyCrowdSubsystem::SetTaskActive(AAllyAIController* Ally, EAllyCrowdTask Task, bool bActive)
+{
+	if (Ally == nullptr || !Allies.IsValidIndex(Ally->CrowdIndex)) return;
+
+	const int32 Index = Ally->CrowdIndex;
+
+	if (!bActive)
+	{
+		ActiveTasks[Index] &= ~Task;
+		return;
+	}
+
+	// Starting a task that is already running leaves its schedule alone, which
+	// matches how the old looping timers were only ever set once per state.
+	if (EnumHasAnyFlags(ActiveTasks[Index], Task)) return;
+
+	ActiveTasks[Index] |= Task;
+
+	// Like a looping timer, the first sprint check happens one interval after it was
+	// started. The first lead check happens within the first interval instead so that a
+	// leading ally doesn't stand around for a whole interval before it starts moving.
+	const float Now = GetWorld()->GetTimeSeconds();
+	if (Task == EAllyCrowdTask::Sprint) NextSprintTimes[Index] = Now + GetTaskInterval(Index, SprintInterval);
+	else if (Task == EAllyCrowdTask::Lead)
+	{
+		// Every ally is usually told to lead at once, so each one starts in its own slice
+		// of the interval.
+		const float Interval = GetTaskInterval(Index, LeadInterval);
+		const int32 NumSlices = FMath::Max(1, GetLeadTimeSlices());
+		NextLeadTimes[Index] = Now + Interval * (Index % NumSlices) / NumSlices;
+	}
+}
+
+/**
+ * Moves a following ally to its PlayerCharacter now, or later if the ally repathed
+ * too recently for its EAllyLODTier.
+ *
+ * @param Ally The AllyAIController that wants to repath.
+ * @param MinDelay The shortest time, in seconds, to wait before repathing, such as after a failed move.
+ */
+void UAllyCrowdSubsystem::RequestFollowRepath(AAllyAIController* Ally, float MinDelay)
+{
+	if (Ally == nullptr) return;
+
+	if (!Allies.IsValidIndex(Ally->CrowdIndex))
+	{
+		Ally->MoveToPlayerCharacter();
+		return;
+	}
+
+	const int32 Index = Ally->CrowdIndex;
+	const float Now = GetWorld()->GetTimeSeconds();
+	const float EarliestRepathTime = FMath::Max(LastRepathTimes[Index] + FAllyLOD::GetMinRepathInterval(LODTiers[Index]), Now + MinDelay);
+
+	if (Now >= EarliestRepathTime)
+	{
+		LastRepathTimes[Index] = Now;
+		Ally->MoveToPlayerCharacter();
+		return;
+	}
+
+	// Distant allies don't need to react to every step the PlayerCharacter takes so
+	// the repath waits until the tier's interval has passed.
+	ActiveTasks[Index] |= EAllyCrowdTask::Repath;
+	NextRepathTimes[Index] = EarliestRepathTime;
+}
+
+/**
+ * Queues a move for an AllyAIController to be sent once it fits in the frame's path query budget.
+ *
+ * @param Ally The AllyAIController to queue the move for.
+ * @param Move The move to queue.
+ *
+ * @return Whether the move was queued. If not, the move should be sent straight away.
+ */
+bool UAllyCrowdSubsystem::QueueMove(AAllyAIController* Ally, EAllyQueuedMove Move)
+{
+	if (Ally == nullptr || !Allies.IsValidIndex(Ally->CrowdIndex) || CVarAllyMoveMaxPathQueriesPerFrame.GetValueOnGameThread() <= 0) return false;
+
+	const int32 Index = Ally->CrowdIndex;
+
+	// Only the latest move matters, but it keeps the time the first one was queued so
+	// that an ally that keeps asking doesn't keep going to the back of the queue.
+	if (QueuedMoves[Index] == EAllyQueuedMove::None) QueuedMoveTimes[Index] = GetWorld()->GetTimeSeconds();
+	QueuedMoves[Index] = Move;
+
+	return true;
+}
+
+/**
+ * Drops the move queued for an AllyAIController, if there is one.
+ *
+ * @param Ally The AllyAIController to drop the move of.
+ */
+void UAllyCrowdSubsystem::CancelQueuedMove(AAllyAIController* Ally)
+{
+	if (Ally != nullptr && QueuedMoves.IsValidIndex(Ally->CrowdIndex)) QueuedMoves[Ally->CrowdIndex] = EAllyQueuedMove::None;
+}
+
+/**
+ * Returns whether one of the recurring tasks is running for an AllyAIController.
+ */
+bool UAllyCrowdSubsystem::IsTaskActive(const AAllyAIController* Ally, EAllyCrowdTask Task) const
+{
+	if (Ally == nullptr || !ActiveTasks.IsValidIndex(Ally->CrowdIndex)) return false;
+
+	return EnumHasAnyFlags(ActiveTasks[Ally->CrowdIndex], Task);
+}
+
+/**
+ * Adds an AllyAIController to the group of allies that share one path to a PlayerCharacter.
+ *
+ * @param Ally The AllyAIController to add.
+ * @param Player The PlayerCharacter the group follows.
+ */
+void UAllyCrowdSubsystem::JoinFollowGroup(AAllyAIController* Ally, APlayerCharacter* Player)
+{
+	if (Ally == nullptr || Player == nullptr) return;
+
+	FollowGroups.FindOrAdd(Player).AddMember(Ally);
+}
+
+/**
+ * Removes an AllyAIController from the group of allies that share one path to a PlayerCharacter.
+ *
+ * @param Ally The AllyAIController to remove.
+ * @param Player The PlayerCharacter the group follows.
+ */
+void UAllyCrowdSubsystem::LeaveFollowGroup(AAllyAIController* Ally, APlayerCharacter* Player)
+{
+	FAllyFollowGroup* Group = FollowGroups.Find(Player);
+	if (Group == nullptr) return;
+
+	Group->RemoveMember(Ally);
+	if (Group->IsEmpty()) FollowGroups.Remove(Player);
+}
+
+/**
+ * Finds the path that a member of a follow group should take to its formation slot.
+ */
+bool UAllyCrowdSubsystem::FindFollowGroupPath(AAllyAIController* Ally, APlayerCharacter* Player, FNavPathSharedPtr& OutPath, FVector& OutSlotLocation)
+{
+	FAllyFollowGroup* Group = FollowGroups.Find(Player);
+	if (Group == nullptr) return false;
+
+	return Group->FindMemberPath(Ally, Player, OutPath, OutSlotLocation);
+}
+
+/**
+ * Runs the batched update for as many allies as the per-frame budget allows.
+ */
+void UAllyCrowdSubsystem::Tick(float DeltaTime)
+{
+	ALLY_AI_SCOPE(STAT_AllyCrowdTick);
+
+	LastTickSeconds = 0.0;
+
+	const int32 NumAllies = Allies.Num();
+	if (NumAllies == 0) return;
+
+	const double StartSeconds = FPlatformTime::Seconds();
+
+	const float Now = GetWorld()->GetTimeSeconds();
+
+	// Pick how much attention each ally gets before any of its tasks are scheduled.
+	UpdateLODTiers();
+
+	// Make the sprint, lead-wait, and arrival decisions for every ally up front, across
+	// as many threads as are worth it, so that the per-ally updates below only have to act
+	// on the ones that changed. Everything that touches an actor happens on this thread.
+	SyncStateStore();
+	EvaluateDecisions(CVarAllyCrowdDecisionWorkers.GetValueOnGameThread());
+
+	// Arrivals are checked for every leading ally each frame, outside of the budget, so
+	// that they are noticed as quickly as an overlap event would be.
+	ApplyWaypointArrivals();
+
+	const int32 Budget = CVarAllyCrowdMaxUpdatesPerFrame.GetValueOnGameThread();
+	const int32 NumToUpdate = Budget > 0 ? FMath::Min(Budget, NumAllies) : NumAllies;
+
+	if (UpdateCursor >= NumAllies) UpdateCursor = 0;
+
+	for (int32 Visited = 0; Visited < NumToUpdate && Allies.Num() > 0; ++Visited)
+	{
+		UpdateAlly(UpdateCursor, Now);
+		UpdateCursor = (UpdateCursor + 1) % Allies.Num();
+	}
+
+	// The updates above, and any move completions since the last frame, only queue their
+	// moves, so the path queries are spread out instead of all landing on one frame.
+	SendQueuedMoves(Now);
+
+	// Pack after the updates so that clients get this frame's decisions.
+	UpdateReplicatedStates();
+
+	LastTickSeconds = FPlatformTime::Seconds() - StartSeconds;
+}
+
+/**
+ * Makes the sprint, lead-wait, and waypoint arrival decisions for every ally from the
+ * last sync, split into ranges of allies across threads.
+ *
+ * @param NumWorkers The number of threads to split the allies across, or 0 for every worker thread and the game thread.
+ *
+ * @return The number of threads the allies were actually split across.
+ */
+int32 UAllyCrowdSubsystem::EvaluateDecisions(int32 NumWorkers)
+{
+	ALLY_AI_SCOPE(STAT_AllyCrowdEvaluate);
+
+	const double StartSeconds = FPlatformTime::Seconds();
+	const int32 NumAllies = StateStore.Num();
+
+	// Don't hand out ranges so small that waking a thread costs more than it saves.
+	if (NumWorkers <= 0) NumWorkers = FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+	const int32 MinAlliesPerWorker = FMath::Max(4, CVarAllyCrowdMinAlliesPerWorker.GetValueOnGameThread());
+	NumWorkers = FMath::Clamp(NumWorkers, 1, FMath::Max(1, NumAllies / MinAlliesPerWorker));
+
+	// Every range starts on one of the StateStore's batches of four allies.
+	const int32 AlliesPerWorker = Align(FMath::DivideAndRoundUp(FMath::Max(NumAllies, 1), NumWorkers), 4);
+
+	ParallelFor(NumWorkers, [this, NumAllies, AlliesPerWorker](int32 Worker)
+	{
+		const int32 StartIndex = Worker * AlliesPerWorker;
+		const int32 EndIndex = FMath::Min(NumAllies, StartIndex + AlliesPerWorker);
+		if (StartIndex >= EndIndex) return;
+
+		StateStore.Evaluate(StartIndex, EndIndex);
+		FindWaypointArrivals(StartIndex, EndIndex);
+	}, NumWorkers == 1);
+
+	LastDecisionSeconds = FPlatformTime::Seconds() - StartSeconds;
+
+	return NumWorkers;
+}
+
+/**
+ * Packs the state of every ally for replication when the world has clients to send it to.
+ */
+void UAllyCrowdSubsystem::UpdateReplicatedStates()
+{
+	if (GetWorld()->GetNetMode() == NM_Standalone) return;
+
+	ALLY_AI_SCOPE(STAT_AllyCrowdReplicatedStates);
+
+	for (AAllyAIController* Ally : Allies)
+	{
+		if (Ally != nullptr && Ally->AllyCharacter != nullptr) Ally->AllyCharacter->UpdateReplicatedState(WaypointRegistry);
+	}
+}
+
+/**
+ * Runs any of the ally's tasks that are due.
+ *
+ * @param Index The index of the ally to update.
+ * @param Now The current world time.
+ */
+void UAllyCrowdSubsystem::UpdateAlly(int32 Index, float Now)
+{
+	AAllyAIController* Ally = Allies[Index];
+	if (Ally == nullptr || Ally->AllyCharacter == nullptr) return;
+
+	// Following the PlayerCharacter is driven by `OnPlayerMovingChanged` so only the
+	// sprint and lead tasks need to be checked here.
+	if (EnumHasAnyFlags(ActiveTasks[Index], EAllyCrowdTask::Sprint) && Now >= NextSprintTimes[Index])
+	{
+		ALLY_AI_SCOPE(STAT_AllyCrowdSprintTask);
+
+		NextSprintTimes[Index] = Now + GetTaskInterval(Index, SprintInterval);
+
+		// Only write back to the AllyCharacter when its sprint decision actually
+		// changed, and only while following since leading allies keep their speed.
+		// An ally that only just switched has to wait a little before switching back.
+		AAllyCharacter* AllyCharacter = Ally->AllyCharacter;
+		const bool bCanToggleSprint = Now - LastSprintToggleTimes[Index] >= GetMinSprintToggleInterval();
+		if (AllyCharacter->State == AllyStates::FOLLOW && StateStore.IsSprintFlipped(Index) && bCanToggleSprint)
+		{
+			LastSprintToggleTimes[Index] = Now;
+
+			if (StateStore.WantsSprint(Index)) AllyCharacter->SprintStart();
+			else AllyCharacter->SprintStop();
+
+			StateStore.SetSprinting(Index, AllyCharacter->bIsSprinting);
+		}
+
+		// Cached and shared follow paths don't watch the PlayerCharacter like a regular move
+		// request does, so the move is restarted once the PlayerCharacter has moved too far.
+		if (AllyCharacter->State == AllyStates::FOLLOW && Ally->HasPlayerLeftFollowPath()) RequestFollowRepath(Ally);
+	}
+
+	if (EnumHasAnyFlags(ActiveTasks[Index], EAllyCrowdTask::Lead) && Now >= NextLeadTimes[Index])
+	{
+		NextLeadTimes[Index] = Now + GetTaskInterval(Index, LeadInterval);
+		Ally->MoveToWaypoint(StateStore.WantsWaitForPlayer(Index));
+	}
+
+	if (EnumHasAnyFlags(ActiveTasks[Index], EAllyCrowdTask::Repath) && Now >= NextRepathTimes[Index])
+	{
+		ActiveTasks[Index] &= ~EAllyCrowdTask::Repath;
+
+		// The ally may have started leading since the repath was deferred.
+		if (Ally->AllyCharacter->State == AllyStates::FOLLOW)
+		{
+			LastRepathTimes[Index] = Now;
+			Ally->MoveToPlayerCharacter();
+		}
+	}
+}
+
+/**
+ * Sends the queued moves, most urgent first, until the frame's path query budget is spent.
+ *
+ * @param Now The current world time.
+ */
+void UAllyCrowdSubsystem::SendQueuedMoves(float Now)
+{
+	ALLY_AI_SCOPE(STAT_AllyCrowdSendQueuedMoves);
+
+	struct FPendingMove
+	{
+		int32 Index;
+		bool bIsOverdue;
+		bool bIsLeading;
+		EAllyLODTier Tier;
+		float DistanceSquared;
+	};
+
+	const float MaxQueueDelay = CVarAllyMoveMaxQueueDelay.GetValueOnGameThread();
+
+	TArray<FPendingMove> PendingMoves;
+	for (int32 Index = 0; Index < QueuedMoves.Num(); ++Index)
+	{
+		if (QueuedMoves[Index] == EAllyQueuedMove::None) continue;
+
+		PendingMoves.Add({ Index, Now - QueuedMoveTimes[Index] >= MaxQueueDelay, QueuedMoves[Index] == EAllyQueuedMove::Lead, LODTiers[Index], StateStore.GetDistanceSquaredToPlayer(Index) });
+	}
+
+	NumQueuedMoves = PendingMoves.Num();
+	if (NumQueuedMoves == 0) return;
+
+	// Leading allies are the ones the PlayerCharacter is waiting on, and allies in a higher
+	// EAllyLODTier are the ones the PlayerCharacter can see.
+	PendingMoves.Sort([](const FPendingMove& A, const FPendingMove& B)
+	{
+		if (A.bIsOverdue != B.bIsOverdue) return A.bIsOverdue;
+		if (A.bIsLeading != B.bIsLeading) return A.bIsLeading;
+		if (A.Tier != B.Tier) return A.Tier < B.Tier;
+		return A.DistanceSquared < B.DistanceSquared;
+	});
+
+	// Only the moves that actually query the navmesh count against the budget. Moves along a
+	// cached, shared, or planned path are cheap enough to send as many of as are queued.
+	const int32 Budget = CVarAllyMoveMaxPathQueriesPerFrame.GetValueOnGameThread();
+	const int64 PathQueriesBefore = FAllyAICounters::GetTotal(EAllyAICounter::PathQueries);
+
+	for (const FPendingMove& PendingMove : PendingMoves)
+	{
+		if (Budget > 0 && FAllyAICounters::GetTotal(EAllyAICounter::PathQueries) - PathQueriesBefore >= Budget) break;
+
+		// Clear the slot before sending so that a move that completes straight away can queue the next one.
+		const EAllyQueuedMove Move = QueuedMoves[PendingMove.Index];
+		QueuedMoves[PendingMove.Index] = EAllyQueuedMove::None;
+		--NumQueuedMoves;
+
+		AAllyAIController* Ally = Allies[PendingMove.Index];
+		if (Ally == nullptr) continue;
+
+		if (Move == EAllyQueuedMove::Follow) Ally->SendMoveToPlayerCharacter();
+		else if (Move == EAllyQueuedMove::Lead) Ally->SendMoveToWaypoint();
+	}
+}
+
+/**
+ * Puts every ally in an EAllyLODTier based on how far it is from its PlayerCharacter's
+ * camera and whether it is on screen.
+ */
+void UAllyCrowdSubsystem::UpdateLODTiers()
+{
+	ALLY_AI_SCOPE(STAT_AllyCrowdUpdateLODTiers);
+
+	const float VisibilityTolerance = CVarAllyLODVisibilityTolerance.GetValueOnGameThread();
+
+	// Nothing is ever rendered on a dedicated server or with -nullrhi, so there every ally
+	// would look off screen. In that case the tiers only go by distance.
+	const bool bCanTellVisibility = !IsRunningDedicatedServer() && FApp::CanEverRender();
+
+	for (int32& TierCount : TierCounts) TierCount = 0;
+
+	for (int32 Index = 0; Index < Allies.Num(); ++Index)
+	{
+		AAllyCharacter* AllyCharacter = Allies[Index] != nullptr ? Allies[Index]->AllyCharacter : nullptr;
+		if (AllyCharacter == nullptr) continue;
+
+		EAllyLODTier Tier = EAllyLODTier::HIGH;
+
+		// Allies without a PlayerCharacter to look at them always get full attention.
+		const APlayerCharacter* PlayerCharacter = AllyCharacter->PlayerCharacter;
+		if (PlayerCharacter != nullptr && PlayerCharacter->PlayerCamera != nullptr)
+		{
+			const float DistanceSquared = FVector::DistSquared(AllyCharacter->GetActorLocation(), PlayerCharacter->PlayerCamera->GetComponentLocation());
+			// A listen server only renders its own PlayerCharacter's view, so allies of remote
+			// PlayerCharacters count as on screen too.
+			const bool bIsVisible = !bCanTellVisibility || !PlayerCharacter->IsLocallyControlled() || AllyCharacter->WasRecentlyRendered(VisibilityTolerance);
+			Tier = FAllyLOD::GetTier(DistanceSquared, bIsVisible);
+		}
+
+		if (LODTiers[Index] != Tier) Allies[Index]->UpdateCrowdAvoidanceQuality(Tier);
+
+		LODTiers[Index] = Tier;
+		AllyCharacter->LODTier = Tier;
+		++TierCounts[static_cast<int32>(Tier)];
+	}
+}
+
+/**
+ * Returns how long an ally waits between two runs of a task in its current EAllyLODTier.
+ */
+float UAllyCrowdSubsystem::GetTaskInterval(int32 Index, float BaseInterval) const
+{
+	return BaseInterval * FAllyLOD::GetDecisionIntervalScale(LODTiers[Index]);
+}
+
+/**
+ * Checks whether a range of the leading allies that use the WaypointRegistrySubsystem's
+ * grid instead of overlap events have arrived at their `CurrentWaypoint`.
+ *
+ * @param StartIndex The index of the first ally.
+ * @param EndIndex The index after the last ally.
+ */
+void UAllyCrowdSubsystem::FindWaypointArrivals(int32 StartIndex, int32 EndIndex)
+{
+	for (int32 Index = StartIndex; Index < EndIndex; ++Index)
+	{
+		// Only the waypoint the AllyCharacter is actually moving towards is checked.
+		ArrivedAtWaypoints[Index] = WaypointRegistry != nullptr && ArrivalWaypoints[Index] != nullptr && WaypointRegistry->IsOverlappingWaypoint(ArrivalWaypoints[Index], ArrivalBounds[Index]);
+	}
+}
+
+/**
+ * Tells the allies found by `FindWaypointArrivals` that they are at their `CurrentWaypoint`.
+ */
+void UAllyCrowdSubsystem::ApplyWaypointArrivals()
+{
+	ALLY_AI_SCOPE(STAT_AllyCrowdWaypointArrivals);
+
+	for (int32 Index = 0; Index < Allies.Num(); ++Index)
+	{
+		if (ArrivedAtWaypoints[Index] && Allies[Index] != nullptr && Allies[Index]->AllyCharacter != nullptr) Allies[Index]->AllyCharacter->bIsAtCurrentWaypoint = true;
+	}
+}
+
+/**
+ * Copies the location, thresholds, and state of every ally into the `StateStore`.
+ */
+void UAllyCrowdSubsystem::SyncStateStore()
+{
+	ALLY_AI_SCOPE(STAT_AllyCrowdSyncStateStore);
+
+	ArrivalWaypoints.SetNumZeroed(Allies.Num(), false);
+	ArrivalBounds.SetNum(Allies.Num(), false);
+	ArrivedAtWaypoints.SetNumZeroed(Allies.Num(), false);
+
+	for (int32 Index = 0; Index < Allies.Num(); ++Index)
+	{
+		const AAllyAIController* Ally = Allies[Index];
+		const AAllyCharacter* AllyCharacter = Ally != nullptr ? Ally->AllyCharacter : nullptr;
+
+		ArrivalWaypoints[Index] = nullptr;
+
+		if (AllyCharacter == nullptr)
+		{
+			StateStore.SetAlly(Index, FVector::ZeroVector, FVector::ZeroVector, 0.f, 0.f, 0.f, FAllyStateStore::State_None);
+			continue;
+		}
+
+		// Leading allies that use the waypoint grid have their arrival checked along with the decisions.
+		if (AllyCharacter->State == AllyStates::LEAD && AllyCharacter->UsesWaypointSpatialHash() && !AllyCharacter->bIsAtCurrentWaypoint)
+		{
+			ArrivalWaypoints[Index] = AllyCharacter->CurrentWaypoint;
+			ArrivalBounds[Index] = AllyCharacter->GetWaypointArrivalBounds();
+		}
+
+		uint8 StateBits = FAllyStateStore::State_None;
+		if (AllyCharacter->State == AllyStates::LEAD) StateBits |= FAllyStateStore::State_Lead;
+		if (AllyCharacter->bIsSprinting) StateBits |= FAllyStateStore::State_Sprinting;
+		if (AllyCharacter->bShouldWaitForPlayerWhenLeading) StateBits |= FAllyStateStore::State_ShouldWaitWhenLeading;
+
+		FVector PlayerLocation = FVector::ZeroVector;
+		if (AllyCharacter->PlayerCharacter != nullptr)
+		{
+			StateBits |= FAllyStateStore::State_HasPlayer;
+			PlayerLocation = AllyCharacter->PlayerCharacter->GetActorLocation();
+		}
+
+		StateStore.SetAlly(Index, AllyCharacter->GetActorLocation(), PlayerLocation, AllyCharacter->GetMaxDistanceFromPlayerBeforeSprint(), AllyCharacter->GetSprintExitDistance(), AllyCharacter->GetMaxDistanceFromPlayerWhileLeading(), StateBits);
+	}
+}
+
+/**
+ * Only the instances that belong to a world tick, not the class default object.
+ */
+ETickableTickType UAllyCrowdSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Always;
+}
+
+TStatId UAllyCrowdSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UAllyCrowdSubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,337 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "AllyStateStore.h"
+#include "AllyFollowGroup.h"
+#include "AllyLOD.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "AllyCrowdSubsystem.generated.h"
+
+class AAllyAIController;
+class APlayerCharacter;
+class AWaypointActor;
+class UWaypointRegistrySubsystem;
+
+/**
+ * The recurring tasks that the AllyCrowdSubsystem can run for an AllyAIController.
+ */
+enum class EAllyCrowdTask : uint8
+{
+	None	= 0,
+	Sprint	= 1 << 0,
+	Lead	= 1 << 1,
+	Repath	= 1 << 2,
+};
+ENUM_CLASS_FLAGS(EAllyCrowdTask);
+
+/**
+ * The moves that the AllyCrowdSubsystem can queue for an AllyAIController.
+ */
+enum class EAllyQueuedMove : uint8
+{
+	None,
+	Follow,
+	Lead,
+};
+
+/**
+ * The AllyCrowdSubsystem owns every AllyAIController in the world and runs their
+ * sprint and lead logic in one batched pass per frame instead of each
+ * AllyAIController owning its own set of timers.
+ */
+UCLASS()
+class FOLLOWLEADAI_API UAllyCrowdSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	// How often, in seconds, an ally acts on the decision of whether it should sprint or not.
+	static constexpr float SprintInterval = 0.5f;
+
+	// How often, in seconds, a leading ally moves towards its current waypoint.
+	static constexpr float LeadInterval = 0.5f;
+
+public:
+	/**
+	 * Called when the AllyCrowdSubsystem is created for a world.
+	 */
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	/**
+	 * Called when the world the AllyCrowdSubsystem belongs to is torn down.
+	 */
+	virtual void Deinitialize() override;
+
+	/**
+	 * Returns the shortest time, in seconds, between two sprint toggles of the same ally,
+	 * which is `ally.Sprint.MinToggleInterval`.
+	 */
+	static float GetMinSprintToggleInterval();
+
+	/**
+	 * Returns the number of slices the lead interval of allies told to lead together is
+	 * split into, which is `ally.Lead.TimeSlices`.
+	 */
+	static int32 GetLeadTimeSlices();
+
+	/**
+	 * Adds an AllyAIController to the batched update.
+	 *
+	 * @param Ally The AllyAIController to add.
+	 */
+	void RegisterAlly(AAllyAIController* Ally);
+
+	/**
+	 * Removes an AllyAIController from the batched update.
+	 *
+	 * @param Ally The AllyAIController to remove.
+	 */
+	void UnregisterAlly(AAllyAIController* Ally);
+
+	/**
+	 * Starts or stops running one of the recurring tasks for an AllyAIController.
+	 *
+	 * @param Ally The AllyAIController to change the task of.
+	 * @param Task The task to start or stop.
+	 * @param bActive Whether the task should be running or not.
+	 */
+	void SetTaskActive(AAllyAIController* Ally, EAllyCrowdTask Task, bool bActive);
+
+	/**
+	 * Returns whether one of the recurring tasks is running for an AllyAIController.
+	 */
+	bool IsTaskActive(const AAllyAIController* Ally, EAllyCrowdTask Task) const;
+
+	/**
+	 * Adds an AllyAIController to the group of allies that share one path to a PlayerCharacter.
+	 *
+	 * @param Ally The AllyAIController to add.
+	 * @param Player The PlayerCharacter the group follows.
+	 */
+	void JoinFollowGroup(AAllyAIController* Ally, APlayerCharacter* Player);
+
+	/**
+	 * Removes an AllyAIController from the group of allies that share one path to a PlayerCharacter.
+	 *
+	 * @param Ally The AllyAIController to remove.
+	 * @param Player The PlayerCharacter the group follows.
+	 */
+	void LeaveFollowGroup(AAllyAIController* Ally, APlayerCharacter* Player);
+
+	/**
+	 * Finds the path that a member of a follow group should take to its formation slot.
+	 *
+	 * @param Ally The member to find the path for.
+	 * @param Player The PlayerCharacter the group follows.
+	 * @param OutPath The path to the member's formation slot.
+	 * @param OutSlotLocation The location of the member's formation slot.
+	 *
+	 * @return Whether a path was found or not. If not, the member should find its own path.
+	 */
+	bool FindFollowGroupPath(AAllyAIController* Ally, APlayerCharacter* Player, FNavPathSharedPtr& OutPath, FVector& OutSlotLocation);
+
+	/**
+	 * Moves a following ally to its PlayerCharacter now, or later if the ally repathed
+	 * too recently for its EAllyLODTier.
+	 *
+	 * @param Ally The AllyAIController that wants to repath.
+	 * @param MinDelay The shortest time, in seconds, to wait before repathing, such as after a failed move.
+	 */
+	void RequestFollowRepath(AAllyAIController* Ally, float MinDelay = 0.f);
+
+	/**
+	 * Queues a move for an AllyAIController to be sent once it fits in the frame's path
+	 * query budget. An AllyAIController only ever has one move queued, so a newer move
+	 * replaces the older one but keeps its place in the queue.
+	 *
+	 * @param Ally The AllyAIController to queue the move for.
+	 * @param Move The move to queue.
+	 *
+	 * @return Whether the move was queued. If not, the move should be sent straight away.
+	 */
+	bool QueueMove(AAllyAIController* Ally, EAllyQueuedMove Move);
+
+	/**
+	 * Drops the move queued for an AllyAIController, if there is one.
+	 *
+	 * @param Ally The AllyAIController to drop the move of.
+	 */
+	void CancelQueuedMove(AAllyAIController* Ally);
+
+	/**
+	 * Returns the number of moves that were still queued after the last update.
+	 */
+	int32 GetNumQueuedMoves() const { return NumQueuedMoves; }
+
+	/**
+	 * Makes the sprint, lead-wait, and waypoint arrival decisions for every ally from the
+	 * last sync, split into ranges of allies across threads. Nothing is changed on the
+	 * allies until the decisions are applied on the game thread.
+	 *
+	 * @param NumWorkers The number of threads to split the allies across, or 0 for every worker thread and the game thread.
+	 *
+	 * @return The number of threads the allies were actually split across, which is fewer
+	 * than asked for when there aren't `ally.Crowd.MinAlliesPerWorker` allies for each one.
+	 */
+	int32 EvaluateDecisions(int32 NumWorkers);
+
+	/**
+	 * Returns every AllyAIController that is registered.
+	 */
+	const TArray<AAllyAIController*>& GetAllies() const { return Allies; }
+
+	/**
+	 * Returns the number of AllyAIControllers that are registered.
+	 */
+	int32 GetNumAllies() const { return Allies.Num(); }
+
+	/**
+	 * Returns the number of AllyAIControllers that were in a tier as of the last update.
+	 */
+	int32 GetNumAlliesInTier(EAllyLODTier Tier) const { return TierCounts[static_cast<int32>(Tier)]; }
+
+	/**
+	 * Returns how long, in seconds, the last batched update took on the game thread.
+	 */
+	double GetLastTickSeconds() const { return LastTickSeconds; }
+
+	/**
+	 * Returns how long, in seconds, the last evaluation of the decisions took.
+	 */
+	double GetLastDecisionSeconds() const { return LastDecisionSeconds; }
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual TStatId GetStatId() const override;
+
+private:
+	// The AllyAIControllers that are updated by the AllyCrowdSubsystem. Each
+	// AllyAIController stores its own index into this array so that lookups
+	// and removals don't need to search.
+	UPROPERTY()
+	TArray<AAllyAIController*> Allies;
+
+	// The tasks that are currently running for each ally.
+	TArray<EAllyCrowdTask> ActiveTasks;
+
+	// The world time at which each ally's sprint task should run next.
+	TArray<float> NextSprintTimes;
+
+	// The world time at which each ally's lead task should run next.
+	TArray<float> NextLeadTimes;
+
+	// The world time at which each ally's deferred repath should run.
+	TArray<float> NextRepathTimes;
+
+	// The world time at which each ally last repathed to its PlayerCharacter.
+	TArray<float> LastRepathTimes;
+
+	// The world time at which each ally last started or stopped sprinting.
+	TArray<float> LastSprintToggleTimes;
+
+	// The EAllyLODTier of each ally as of the last update.
+	TArray<EAllyLODTier> LODTiers;
+
+	// The move that is queued for each ally.
+	TArray<EAllyQueuedMove> QueuedMoves;
+
+	// The world time at which each ally's queued move was first queued.
+	TArray<float> QueuedMoveTimes;
+
+	// The number of moves that were still queued after the last update.
+	int32 NumQueuedMoves = 0;
+
+	// The number of allies in each EAllyLODTier as of the last update.
+	int32 TierCounts[FAllyLOD::NumTiers] = {};
+
+	// How long, in seconds, the last batched update took on the game thread.
+	double LastTickSeconds = 0.0;
+
+	// How long, in seconds, the last evaluation of the decisions took.
+	double LastDecisionSeconds = 0.0;
+
+	// The index of the ally that the next batched update starts from so that
+	// allies that didn't fit in the budget last frame go first this frame.
+	int32 UpdateCursor = 0;
+
+	// The follow groups of the allies that share one path to their PlayerCharacter.
+	TMap<TWeakObjectPtr<APlayerCharacter>, FAllyFollowGroup> FollowGroups;
+
+	// The WaypointRegistrySubsystem used to check whether allies have arrived at their waypoints.
+	UPROPERTY()
+	UWaypointRegistrySubsystem* WaypointRegistry;
+
+	// The packed copy of every ally's state that the sprint and lead-wait decisions
+	// are evaluated from. It uses the same indices as the arrays above.
+	FAllyStateStore StateStore;
+
+	// The WaypointActor that each leading ally using the waypoint grid is moving towards,
+	// as of the last sync, or null if the ally doesn't need its arrival checked. These are
+	// only used within a frame so they aren't kept in step when allies are removed.
+	TArray<const AWaypointActor*> ArrivalWaypoints;
+
+	// The box that each ally in `ArrivalWaypoints` checks against its WaypointActor.
+	TArray<FBox> ArrivalBounds;
+
+	// Whether each ally has arrived at its WaypointActor as of the last evaluation.
+	TArray<bool> ArrivedAtWaypoints;
+
+	/**
+	 * Puts every ally in an EAllyLODTier based on how far it is from its PlayerCharacter's
+	 * camera and whether it is on screen.
+	 */
+	void UpdateLODTiers();
+
+	/**
+	 * Returns how long an ally waits between two runs of a task in its current EAllyLODTier.
+	 *
+	 * @param Index The index of the ally.
+	 * @param BaseInterval How long an ally in the HIGH tier waits between two runs of the task.
+	 */
+	float GetTaskInterval(int32 Index, float BaseInterval) const;
+
+	/**
+	 * Copies the location, thresholds, and state of every ally into the `StateStore`.
+	 */
+	void SyncStateStore();
+
+	/**
+	 * Checks whether a range of the leading allies that use the WaypointRegistrySubsystem's
+	 * grid instead of overlap events have arrived at their `CurrentWaypoint`. This only
+	 * reads the synced arrays and the grid so ranges can be checked on different threads.
+	 *
+	 * @param StartIndex The index of the first ally.
+	 * @param EndIndex The index after the last ally.
+	 */
+	void FindWaypointArrivals(int32 StartIndex, int32 EndIndex);
+
+	/**
+	 * Tells the allies found by `FindWaypointArrivals` that they are at their `CurrentWaypoint`.
+	 */
+	void ApplyWaypointArrivals();
+
+	/**
+	 * Packs the state of every ally for replication when the world has clients to send it to.
+	 */
+	void UpdateReplicatedStates();
+
+	/**
+	 * Sends the queued moves, most urgent first, until the frame's path query budget is spent.
+	 * Allies that are leading, on screen, and close to their PlayerCharacter go first, but a
+	 * move that has waited longer than `ally.Move.MaxQueueDelay` goes before all of them.
+	 *
+	 * @param Now The current world time.
+	 */
+	void SendQueuedMoves(float Now);
+
+	/**
+	 * Runs any of the ally's tasks that are due.
+	 *
+	 * @param Index The index of the ally to update.
+	 * @param Now The current world time.
+	 */
+	void UpdateAlly(int32 Index, float Now);
+};
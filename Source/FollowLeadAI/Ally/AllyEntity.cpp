@@ -0,0 +1,97 @@
+#include "AllyEntity.h"
+#include "AllyTuning.h"
+#include "../WaypointActor.h"
+#include "GameFramework/CharacterMovementComponent.h"
+
+/**
+ * Copies the state of an AllyCharacter.
+ *
+ * @param Ally The AllyCharacter to copy.
+ */
+FAllyEntity FAllyEntity::FromAlly(const AAllyCharacter& Ally)
+{
+	FAllyEntity Entity;
+	Entity.Location = Ally.GetActorLocation();
+	Entity.Velocity = Ally.GetVelocity();
+	Entity.State = Ally.State;
+	Entity.bIsSprinting = Ally.bIsSprinting;
+	Entity.bShouldWaitForPlayer = Ally.bShouldWaitForPlayerWhenLeading;
+	Entity.CurrentWaypoint = Ally.CurrentWaypoint != nullptr ? Ally.CurrentWaypoint->WaypointNumber : INDEX_NONE;
+	Entity.EndWaypoint = Ally.EndWaypoint != nullptr ? Ally.EndWaypoint->WaypointNumber : INDEX_NONE;
+	Entity.WaypointLocation = Ally.CurrentWaypoint != nullptr ? Ally.CurrentWaypoint->GetActorLocation() : Entity.Location;
+
+	// The AllyAIController picks a random acceptance radius in this range for every move.
+	Entity.AcceptanceRadius = (Ally.GetMinDistanceFromPlayer() + Ally.GetMaxDistanceFromPlayer()) * 0.5f;
+	Entity.SprintDistance = Ally.GetMaxDistanceFromPlayerBeforeSprint();
+	Entity.SprintExitDistance = FMath::Min(Ally.GetSprintExitDistance(), Entity.SprintDistance);
+	Entity.LeadWaitDistance = Ally.GetMaxDistanceFromPlayerWhileLeading();
+	Entity.WalkSpeed = Ally.GetWalkSpeed();
+	Entity.SprintSpeed = Ally.GetSprintSpeed();
+
+	Entity.bUseGroupFollow = Ally.bUseGroupFollow;
+	Entity.bUsePredictiveFollow = Ally.bUsePredictiveFollow;
+	Entity.bUseCrowdAvoidance = Ally.bUseCrowdAvoidance;
+	Entity.bUseWaypointSpatialHash = Ally.bUseWaypointSpatialHash;
+
+	Entity.VariantName = Ally.VariantName;
+	Entity.Tuning = Ally.Tuning;
+	Entity.TuningOverrides = Ally.TuningOverrides;
+
+	return Entity;
+}
+
+/**
+ * Moves the entity towards its PlayerCharacter or waypoint, making the same sprint and
+ * wait decisions as the AllyCrowdSubsystem.
+ *
+ * @param PlayerLocation The location of the entity's PlayerCharacter.
+ * @param DeltaTime The time, in seconds, to step forward by.
+ */
+void FAllyEntity::Step(const FVector& PlayerLocation, float DeltaTime)
+{
+	const float PlayerDistanceSquared = FVector::DistSquared2D(Location, PlayerLocation);
+
+	FVector Target;
+	float TargetRadius;
+
+	if (State == AllyStates::FOLLOW)
+	{
+		// The same hysteresis as the FAllyStateStore so an entity doesn't flicker in and out of sprinting.
+		const float SprintThreshold = bIsSprinting ? SprintExitDistance : SprintDistance;
+		bIsSprinting = PlayerDistanceSquared > FMath::Square(SprintThreshold);
+
+		Target = PlayerLocation;
+		TargetRadius = AcceptanceRadius;
+	}
+	else
+	{
+		// Leading allies keep walking and stop for a PlayerCharacter that has fallen behind.
+		bIsSprinting = false;
+
+		if (bShouldWaitForPlayer && PlayerDistanceSquared > FMath::Square(LeadWaitDistance))
+		{
+			Velocity = FVector::ZeroVector;
+			return;
+		}
+
+		Target = WaypointLocation;
+		TargetRadius = AAllyCharacter::WaypointArrivalExtent.X;
+	}
+
+	FVector ToTarget = Target - Location;
+	ToTarget.Z = 0.f;
+
+	const float Distance = ToTarget.Size();
+	if (Distance <= TargetRadius)
+	{
+		Velocity = FVector::ZeroVector;
+		if (State == AllyStates::LEAD) bHasArrived = true;
+		return;
+	}
+
+	const FVector Direction = ToTarget / Distance;
+	const float Speed = bIsSprinting ? SprintSpeed : WalkSpeed;
+
+	Velocity = Direction * Speed;
+	Location += Direction * FMath::Min(Speed * DeltaTime, Distance - TargetRadius);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AllyCharacter.h"
+
+class UAllyTuning;
+class UAllyTuningOverrides;
+
+/**
+ * A lightweight stand-in for an AllyCharacter that is too far from its PlayerCharacter
+ * to need a full character, controller, and CharacterMovementComponent. It keeps just
+ * enough of the AllyCharacter's state to carry on following or leading in a straight
+ * line, and to pick up where it left off when it is turned back into an AllyCharacter.
+ */
+struct FOLLOWLEADAI_API FAllyEntity
+{
+	// Where the entity is. Only X and Y are stepped, so this is put back on the navmesh
+	// when the entity is turned back into an AllyCharacter.
+	FVector Location = FVector::ZeroVector;
+
+	// How fast and in which direction the entity moved on its last step.
+	FVector Velocity = FVector::ZeroVector;
+
+	// Whether the entity is following or leading its PlayerCharacter.
+	AllyStates State = AllyStates::FOLLOW;
+
+	// Indicates whether the entity is sprinting to catch up to its PlayerCharacter.
+	bool bIsSprinting = false;
+
+	// Indicates whether a leading entity waits for its PlayerCharacter to catch up.
+	bool bShouldWaitForPlayer = false;
+
+	// The same ways of following and finding waypoints as the AllyCharacter the entity was made from.
+	bool bUseGroupFollow = false;
+	bool bUsePredictiveFollow = false;
+	bool bUseCrowdAvoidance = false;
+	bool bUseWaypointSpatialHash = false;
+
+	// Set by `Step` once a leading entity reaches its `CurrentWaypoint`.
+	bool bHasArrived = false;
+
+	// The `WaypointNumber` of the WaypointActor the entity is leading to and the one it stops leading at.
+	int32 CurrentWaypoint = INDEX_NONE;
+	int32 EndWaypoint = INDEX_NONE;
+
+	// The location of the `CurrentWaypoint`, looked up when it changes so that `Step` doesn't have to.
+	FVector WaypointLocation = FVector::ZeroVector;
+
+	// The index of the entity's PlayerCharacter in the AllyEntitySubsystem.
+	int32 PlayerIndex = INDEX_NONE;
+
+	// The same distances and speeds as the AllyCharacter the entity was made from.
+	float AcceptanceRadius = 300.f;
+	float SprintDistance = 600.f;
+	float SprintExitDistance = 450.f;
+	float LeadWaitDistance = 500.f;
+	float WalkSpeed = 200.f;
+	float SprintSpeed = 500.f;
+
+	// What the AllyCharacter looked like and was tuned with, to give back to it when it is made again.
+	FName VariantName;
+	TWeakObjectPtr<UAllyTuning> Tuning;
+	TWeakObjectPtr<UAllyTuningOverrides> TuningOverrides;
+
+	/**
+	 * Copies the state of an AllyCharacter.
+	 *
+	 * @param Ally The AllyCharacter to copy.
+	 */
+	static FAllyEntity FromAlly(const AAllyCharacter& Ally);
+
+	/**
+	 * Moves the entity towards its PlayerCharacter or waypoint, making the same sprint and
+	 * wait decisions as the AllyCrowdSubsystem. Only touches the entity itself so that
+	 * entities can be stepped on any thread.
+	 *
+	 * @param PlayerLocation The location of the entity's PlayerCharacter.
+	 * @param DeltaTime The time, in seconds, to step forward by.
+	 */
+	void Step(const FVector& PlayerLocation, float DeltaTime);
+};
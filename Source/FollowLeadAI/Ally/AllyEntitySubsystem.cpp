@@ -0,0 +1,408 @@
+#include "AllyEntitySubsystem.h"
+#include "AllyAIController.h"
+#include "AllyCharacter.h"
+#include "AllyCrowdSubsystem.h"
+#include "AllyPoolSubsystem.h"
+#include "AllyStats.h"
+#include "AllyTuning.h"
+#include "../Player/PlayerCharacter.h"
+#include "../WaypointActor.h"
+#include "../WaypointRegistrySubsystem.h"
+#include "Async/ParallelFor.h"
+#include "Components/CapsuleComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "HAL/IConsoleManager.h"
+#include "NavigationSystem.h"
+#include "UObject/UObjectIterator.h"
+
+// Whether allies far from their PlayerCharacter are turned into lightweight entities.
+static TAutoConsoleVariable<int32> CVarAllyEntityEnabled(
+	TEXT("ally.Entity.Enabled"),
+	0,
+	TEXT("Whether allies far from their PlayerCharacter are turned into lightweight entities until they get close again. Entities aren't drawn. Turning it off turns every entity back into an ally."),
+	ECVF_Default);
+
+// How close, in units, an entity has to get to its PlayerCharacter to be turned back into an ally.
+static TAutoConsoleVariable<float> CVarAllyEntityPromoteDistance(
+	TEXT("ally.Entity.PromoteDistance"),
+	4000.f,
+	TEXT("How close an entity has to get to its PlayerCharacter to be turned back into an ally."),
+	ECVF_Default);
+
+// How far, in units, an ally has to get from its PlayerCharacter to be turned into an entity.
+static TAutoConsoleVariable<float> CVarAllyEntityDemoteDistance(
+	TEXT("ally.Entity.DemoteDistance"),
+	5000.f,
+	TEXT("How far an ally has to get from its PlayerCharacter to be turned into an entity. Never less than ally.Entity.PromoteDistance."),
+	ECVF_Default);
+
+// The maximum number of allies that are turned into entities or back per frame.
+static TAutoConsoleVariable<int32> CVarAllyEntityMaxTransfersPerFrame(
+	TEXT("ally.Entity.MaxTransfersPerFrame"),
+	8,
+	TEXT("The maximum number of allies that are turned into entities or back per frame. 0 means no limit."),
+	ECVF_Default);
+
+// How far, in units, an entity can be from the navmesh and still be put back on it when it is turned back into an ally.
+static TAutoConsoleVariable<float> CVarAllyEntityProjectionExtent(
+	TEXT("ally.Entity.ProjectionExtent"),
+	1000.f,
+	TEXT("How far an entity can be from the navmesh and still be put back on it when it is turned back into an ally. Entities further away come back where they are."),
+	ECVF_Default);
+
+// The number of entities that each task steps.
+static TAutoConsoleVariable<int32> CVarAllyEntityChunkSize(
+	TEXT("ally.Entity.ChunkSize"),
+	256,
+	TEXT("The number of entities that each task steps."),
+	ECVF_Default);
+
+// Logs how many allies are entities in every world.
+static FAutoConsoleCommand AllyEntityStatsCommand(
+	TEXT("ally.Entity.Stats"),
+	TEXT("Logs how many allies are lightweight entities and how many have been turned into entities or back."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		for (TObjectIterator<UAllyEntitySubsystem> It; It; ++It)
+		{
+			if (It->HasAnyFlags(RF_ClassDefaultObject) || It->GetWorld() == nullptr) continue;
+
+			UE_LOG(LogTemp, Display, TEXT("Ally entities in %s: %d entities, %d demotions, %d promotions"), *It->GetWorld()->GetName(), It->GetNumEntities(), It->GetNumDemotions(), It->GetNumPromotions());
+		}
+	}));
+
+/**
+ * Called when the AllyEntitySubsystem is created for a world.
+ */
+void UAllyEntitySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	CrowdSubsystem = Cast<UAllyCrowdSubsystem>(Collection.InitializeDependency(UAllyCrowdSubsystem::StaticClass()));
+	PoolSubsystem = Cast<UAllyPoolSubsystem>(Collection.InitializeDependency(UAllyPoolSubsystem::StaticClass()));
+	WaypointRegistry = Cast<UWaypointRegistrySubsystem>(Collection.InitializeDependency(UWaypointRegistrySubsystem::StaticClass()));
+	DemoteCursor = 0;
+}
+
+/**
+ * Called when the world the AllyEntitySubsystem belongs to is torn down.
+ */
+void UAllyEntitySubsystem::Deinitialize()
+{
+	Entities.Reset();
+	Players.Reset();
+	PlayerLocations.Reset();
+
+	Super::Deinitialize();
+}
+
+/**
+ * Puts every entity of a PlayerCharacter in the LEAD state.
+ *
+ * @param Player The PlayerCharacter that asked for the lead.
+ * @param StartWaypoint The `WaypointNumber` of the WaypointActor to start leading from.
+ * @param EndWaypoint The `WaypointNumber` of the WaypointActor to stop leading at.
+ * @param bShouldWaitForPlayer Whether the entities wait for the PlayerCharacter while leading.
+ */
+void UAllyEntitySubsystem::MakeEntitiesLead(APlayerCharacter* Player, int32 StartWaypoint, int32 EndWaypoint, bool bShouldWaitForPlayer)
+{
+	const int32 PlayerIndex = Players.IndexOfByKey(Player);
+	if (PlayerIndex == INDEX_NONE) return;
+
+	for (FAllyEntity& Entity : Entities)
+	{
+		if (Entity.PlayerIndex != PlayerIndex) continue;
+
+		if (Entity.State != AllyStates::LEAD) FAllyAICounters::Increment(EAllyAICounter::StateTransitions);
+
+		Entity.State = AllyStates::LEAD;
+		Entity.bIsSprinting = false;
+		Entity.bHasArrived = false;
+		Entity.bShouldWaitForPlayer = bShouldWaitForPlayer;
+		Entity.CurrentWaypoint = StartWaypoint;
+		Entity.EndWaypoint = EndWaypoint;
+		UpdateWaypointLocation(Entity);
+	}
+}
+
+/**
+ * Steps the entities and turns as many allies into entities or back as the per-frame budget allows.
+ */
+void UAllyEntitySubsystem::Tick(float DeltaTime)
+{
+	ALLY_AI_SCOPE(STAT_AllyEntityTick);
+
+	// The allies are only controlled on the server so there is nothing to do on clients.
+	if (CrowdSubsystem == nullptr || PoolSubsystem == nullptr || GetWorld()->GetNetMode() == NM_Client) return;
+
+	const bool bIsEnabled = CVarAllyEntityEnabled.GetValueOnGameThread() != 0;
+	if (!bIsEnabled && Entities.Num() == 0) return;
+
+	RemoveInvalidPlayers();
+
+	// Take a copy of where every PlayerCharacter is so that the entities can be stepped
+	// without touching any actors.
+	PlayerLocations.SetNumUninitialized(Players.Num());
+	for (int32 Index = 0; Index < Players.Num(); ++Index)
+	{
+		PlayerLocations[Index] = Players[Index]->GetActorLocation();
+	}
+
+	SimulateEntities(DeltaTime);
+	UpdateWaypointArrivals();
+
+	// Entities coming back near a PlayerCharacter are what the player can see so they go first.
+	const int32 MaxTransfers = CVarAllyEntityMaxTransfersPerFrame.GetValueOnGameThread();
+	int32 Budget = MaxTransfers > 0 ? MaxTransfers : MAX_int32;
+
+	PromoteNearbyEntities(Budget, !bIsEnabled);
+	if (bIsEnabled) DemoteDistantAllies(Budget);
+}
+
+/**
+ * Returns the index of a PlayerCharacter in `Players`, adding it if it isn't there yet.
+ */
+int32 UAllyEntitySubsystem::FindOrAddPlayer(APlayerCharacter* Player)
+{
+	const int32 Index = Players.IndexOfByKey(Player);
+
+	return Index != INDEX_NONE ? Index : Players.Add(Player);
+}
+
+/**
+ * Removes the PlayerCharacters that are no longer in the world from `Players` and moves
+ * the entities' indices to match. Entities that followed one of them are left without a
+ * PlayerCharacter.
+ */
+void UAllyEntitySubsystem::RemoveInvalidPlayers()
+{
+	if (!Players.ContainsByPredicate([](const APlayerCharacter* Player) { return !IsValid(Player); })) return;
+
+	// Work out where each PlayerCharacter that is staying ends up before moving them.
+	TArray<int32> NewIndices;
+	NewIndices.SetNumUninitialized(Players.Num());
+	int32 NumValidPlayers = 0;
+	for (int32 Index = 0; Index < Players.Num(); ++Index)
+	{
+		NewIndices[Index] = IsValid(Players[Index]) ? NumValidPlayers++ : INDEX_NONE;
+	}
+
+	for (FAllyEntity& Entity : Entities)
+	{
+		if (NewIndices.IsValidIndex(Entity.PlayerIndex)) Entity.PlayerIndex = NewIndices[Entity.PlayerIndex];
+	}
+
+	Players.RemoveAll([](const APlayerCharacter* Player) { return !IsValid(Player); });
+}
+
+/**
+ * Turns AllyCharacters that are further than `ally.Entity.DemoteDistance` from their
+ * PlayerCharacter into entities.
+ *
+ * @param Budget The number of allies that can still be turned into entities or back this frame.
+ */
+void UAllyEntitySubsystem::DemoteDistantAllies(int32& Budget)
+{
+	const TArray<AAllyAIController*>& Allies = CrowdSubsystem->GetAllies();
+	const int32 NumAllies = Allies.Num();
+	if (NumAllies == 0 || Budget <= 0) return;
+
+	const float PromoteDistance = CVarAllyEntityPromoteDistance.GetValueOnGameThread();
+	const float DemoteDistanceSquared = FMath::Square(FMath::Max(PromoteDistance, CVarAllyEntityDemoteDistance.GetValueOnGameThread()));
+
+	if (DemoteCursor >= NumAllies) DemoteCursor = 0;
+
+	// Putting an ally back in the pool removes it from the AllyCrowdSubsystem, which
+	// reorders its allies, so find every ally to demote before demoting any of them.
+	TArray<AAllyCharacter*, TInlineAllocator<16>> AlliesToDemote;
+	for (int32 Visited = 0; Visited < NumAllies && AlliesToDemote.Num() < Budget; ++Visited)
+	{
+		const AAllyAIController* Ally = Allies[DemoteCursor];
+		DemoteCursor = (DemoteCursor + 1) % NumAllies;
+
+		AAllyCharacter* AllyCharacter = Ally != nullptr ? Ally->AllyCharacter : nullptr;
+		if (AllyCharacter == nullptr || AllyCharacter->PlayerCharacter == nullptr || AllyCharacter->IsPendingKill()) continue;
+
+		if (FVector::DistSquared2D(AllyCharacter->GetActorLocation(), AllyCharacter->PlayerCharacter->GetActorLocation()) > DemoteDistanceSquared) AlliesToDemote.Add(AllyCharacter);
+	}
+
+	for (AAllyCharacter* AllyCharacter : AlliesToDemote)
+	{
+		FAllyEntity& Entity = Entities.Add_GetRef(FAllyEntity::FromAlly(*AllyCharacter));
+		Entity.PlayerIndex = FindOrAddPlayer(AllyCharacter->PlayerCharacter);
+
+		PoolSubsystem->ReleaseAlly(AllyCharacter);
+
+		++NumDemotions;
+		--Budget;
+	}
+}
+
+/**
+ * Turns entities that are within `ally.Entity.PromoteDistance` of their PlayerCharacter,
+ * or that have lost their PlayerCharacter, back into AllyCharacters.
+ *
+ * @param Budget The number of allies that can still be turned into entities or back this frame.
+ * @param bPromoteAll Whether to turn every entity back, such as when `ally.Entity.Enabled` is turned off.
+ */
+void UAllyEntitySubsystem::PromoteNearbyEntities(int32& Budget, bool bPromoteAll)
+{
+	const float PromoteDistanceSquared = FMath::Square(CVarAllyEntityPromoteDistance.GetValueOnGameThread());
+
+	// Walk backwards so that removing an entity only ever swaps in one that was already checked.
+	for (int32 Index = Entities.Num() - 1; Index >= 0 && Budget > 0; --Index)
+	{
+		const FAllyEntity& Entity = Entities[Index];
+		const bool bHasPlayer = PlayerLocations.IsValidIndex(Entity.PlayerIndex);
+
+		if (!bPromoteAll && bHasPlayer && FVector::DistSquared2D(Entity.Location, PlayerLocations[Entity.PlayerIndex]) > PromoteDistanceSquared) continue;
+
+		// Stop for this frame if the pool can't give out any more allies.
+		if (!PromoteEntity(Entity)) return;
+
+		Entities.RemoveAtSwap(Index, 1, false);
+
+		++NumPromotions;
+		--Budget;
+	}
+}
+
+/**
+ * Steps every entity forward in chunks across the task graph.
+ *
+ * @param DeltaTime The time since the last frame.
+ */
+void UAllyEntitySubsystem::SimulateEntities(float DeltaTime)
+{
+	ALLY_AI_SCOPE(STAT_AllyEntitySimulate);
+
+	const int32 ChunkSize = FMath::Max(1, CVarAllyEntityChunkSize.GetValueOnGameThread());
+	const int32 NumChunks = FMath::DivideAndRoundUp(Entities.Num(), ChunkSize);
+
+	// Each entity only reads the copied PlayerCharacter locations and writes to itself so
+	// the chunks can be stepped in any order on any thread.
+	ParallelFor(NumChunks, [this, ChunkSize, DeltaTime](int32 Chunk)
+	{
+		const int32 End = FMath::Min(Entities.Num(), (Chunk + 1) * ChunkSize);
+		for (int32 Index = Chunk * ChunkSize; Index < End; ++Index)
+		{
+			FAllyEntity& Entity = Entities[Index];
+
+			// Entities that lost their PlayerCharacter stay where they are until they are promoted.
+			if (!PlayerLocations.IsValidIndex(Entity.PlayerIndex)) continue;
+
+			Entity.Step(PlayerLocations[Entity.PlayerIndex], DeltaTime);
+		}
+	});
+}
+
+/**
+ * Moves the leading entities that have arrived at their `CurrentWaypoint` on to the next
+ * one, or back to the FOLLOW state once they are at their `EndWaypoint`.
+ */
+void UAllyEntitySubsystem::UpdateWaypointArrivals()
+{
+	for (FAllyEntity& Entity : Entities)
+	{
+		if (!Entity.bHasArrived) continue;
+
+		Entity.bHasArrived = false;
+
+		if (Entity.CurrentWaypoint == Entity.EndWaypoint || Entity.CurrentWaypoint == INDEX_NONE)
+		{
+			// Done leading so go back to following the PlayerCharacter.
+			Entity.State = AllyStates::FOLLOW;
+			FAllyAICounters::Increment(EAllyAICounter::StateTransitions);
+			continue;
+		}
+
+		// Entities don't plan a route so, like an AllyAIController whose route hasn't been
+		// planned yet, they go to the next WaypointActor towards their `EndWaypoint`.
+		const AWaypointActor* NextWaypoint = WaypointRegistry != nullptr ? WaypointRegistry->FindNextWaypoint(Entity.CurrentWaypoint, Entity.EndWaypoint) : nullptr;
+		if (NextWaypoint == nullptr)
+		{
+			// There's nowhere left to lead to so go back to following the PlayerCharacter.
+			Entity.State = AllyStates::FOLLOW;
+			FAllyAICounters::Increment(EAllyAICounter::StateTransitions);
+			continue;
+		}
+
+		Entity.CurrentWaypoint = NextWaypoint->WaypointNumber;
+		UpdateWaypointLocation(Entity);
+	}
+}
+
+/**
+ * Turns an entity back into an AllyCharacter that carries on from where the entity was.
+ *
+ * @param Entity The entity to turn back into an AllyCharacter.
+ *
+ * @return Whether an AllyCharacter could be taken from the AllyPoolSubsystem.
+ */
+bool UAllyEntitySubsystem::PromoteEntity(const FAllyEntity& Entity)
+{
+	APlayerCharacter* Player = Players.IsValidIndex(Entity.PlayerIndex) && IsValid(Players[Entity.PlayerIndex]) ? Players[Entity.PlayerIndex] : nullptr;
+
+	const FRotator Rotation = Entity.Velocity.IsNearlyZero() ? FRotator::ZeroRotator : Entity.Velocity.Rotation();
+
+	// Entities move in a straight line and never change height, so put the AllyCharacter
+	// back on the navmesh instead of inside a wall or under the floor.
+	const float ProjectionExtent = CVarAllyEntityProjectionExtent.GetValueOnGameThread();
+	const UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	FNavLocation NavLocation;
+	const bool bIsOnNavMesh = NavSys != nullptr && NavSys->ProjectPointToNavigation(Entity.Location, NavLocation, FVector(ProjectionExtent));
+
+	// Allies without a PlayerCharacter are picked up by the AllyAssignmentSubsystem.
+	AAllyCharacter* AllyCharacter = PoolSubsystem->AcquireAlly(Player, FTransform(Rotation, bIsOnNavMesh ? NavLocation.Location : Entity.Location), [&Entity](AAllyCharacter* Ally)
+	{
+		Ally->VariantName = Entity.VariantName;
+		Ally->Tuning = Entity.Tuning.Get();
+		Ally->TuningOverrides = Entity.TuningOverrides.Get();
+		Ally->bUseGroupFollow = Entity.bUseGroupFollow;
+		Ally->bUsePredictiveFollow = Entity.bUsePredictiveFollow;
+		Ally->bUseCrowdAvoidance = Entity.bUseCrowdAvoidance;
+		Ally->bUseWaypointSpatialHash = Entity.bUseWaypointSpatialHash;
+	});
+	if (AllyCharacter == nullptr) return false;
+
+	// The navmesh is at the AllyCharacter's feet so it's raised by the height of the capsule
+	// of the AllyCharacter the pool handed back, which may not be the default one.
+	if (bIsOnNavMesh && AllyCharacter->GetCapsuleComponent() != nullptr)
+	{
+		AllyCharacter->SetActorLocation(NavLocation.Location + FVector(0.f, 0.f, AllyCharacter->GetCapsuleComponent()->GetScaledCapsuleHalfHeight()), false, nullptr, ETeleportType::ResetPhysics);
+	}
+
+	if (AllyCharacter->GetCharacterMovement() != nullptr) AllyCharacter->GetCharacterMovement()->Velocity = Entity.Velocity;
+
+	// The AllyAIController starts out following so put it back in the state the entity was in.
+	// The entity already decided to sprint, so picking that back up isn't counted as a toggle.
+	AAllyAIController* Controller = Cast<AAllyAIController>(AllyCharacter->GetController());
+	if (Controller == nullptr) return true;
+
+	if (Entity.State == AllyStates::LEAD) Controller->MakeAllyLead(Entity.CurrentWaypoint, Entity.EndWaypoint, Entity.bShouldWaitForPlayer);
+	else if (Entity.bIsSprinting) AllyCharacter->SetSprinting(true);
+
+	return true;
+}
+
+/**
+ * Sets where a leading entity moves to from its `CurrentWaypoint`.
+ */
+void UAllyEntitySubsystem::UpdateWaypointLocation(FAllyEntity& Entity) const
+{
+	const AWaypointActor* Waypoint = WaypointRegistry != nullptr ? WaypointRegistry->FindWaypoint(Entity.CurrentWaypoint) : nullptr;
+
+	// Without a WaypointActor the entity counts as already being there.
+	Entity.WaypointLocation = Waypoint != nullptr ? Waypoint->GetActorLocation() : Entity.Location;
+}
+
+ETickableTickType UAllyEntitySubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Always;
+}
+
+TStatId UAllyEntitySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UAllyEntitySubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "AllyEntity.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "AllyEntitySubsystem.generated.h"
+
+class AAllyAIController;
+class APlayerCharacter;
+class UAllyCrowdSubsystem;
+class UAllyPoolSubsystem;
+class UWaypointRegistrySubsystem;
+
+/**
+ * The AllyEntitySubsystem turns AllyCharacters that are far from their PlayerCharacter
+ * into FAllyEntities and back again once they get close, so that only the allies near a
+ * PlayerCharacter pay for a character, controller, and CharacterMovementComponent. The
+ * entities are stepped in chunks across the task graph, and only a few allies are
+ * turned into entities or back each frame so that the cost stays flat.
+ */
+UCLASS()
+class FOLLOWLEADAI_API UAllyEntitySubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	/**
+	 * Called when the AllyEntitySubsystem is created for a world.
+	 */
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	/**
+	 * Called when the world the AllyEntitySubsystem belongs to is torn down.
+	 */
+	virtual void Deinitialize() override;
+
+	/**
+	 * Puts every entity of a PlayerCharacter in the LEAD state, like `AAllyAIController::MakeAllyLead`
+	 * does for the AllyCharacters.
+	 *
+	 * @param Player The PlayerCharacter that asked for the lead.
+	 * @param StartWaypoint The `WaypointNumber` of the WaypointActor to start leading from.
+	 * @param EndWaypoint The `WaypointNumber` of the WaypointActor to stop leading at.
+	 * @param bShouldWaitForPlayer Whether the entities wait for the PlayerCharacter while leading.
+	 */
+	void MakeEntitiesLead(APlayerCharacter* Player, int32 StartWaypoint, int32 EndWaypoint, bool bShouldWaitForPlayer);
+
+	/**
+	 * Returns the number of allies that are currently entities.
+	 */
+	int32 GetNumEntities() const { return Entities.Num(); }
+
+	/**
+	 * Returns how many entities have been turned back into AllyCharacters.
+	 */
+	int32 GetNumPromotions() const { return NumPromotions; }
+
+	/**
+	 * Returns how many AllyCharacters have been turned into entities.
+	 */
+	int32 GetNumDemotions() const { return NumDemotions; }
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual TStatId GetStatId() const override;
+
+private:
+	// The allies that are currently entities.
+	TArray<FAllyEntity> Entities;
+
+	// The PlayerCharacters that entities follow and lead. Entities store an index into
+	// this array so it is only compacted by `RemoveInvalidPlayers`, which fixes them up.
+	UPROPERTY()
+	TArray<APlayerCharacter*> Players;
+
+	// The location of each PlayerCharacter as of the last update, indexed like `Players`.
+	// PlayerCharacters added since then don't have one yet.
+	TArray<FVector> PlayerLocations;
+
+	// The index in the AllyCrowdSubsystem's allies that the next check for allies to turn into entities starts from.
+	int32 DemoteCursor = 0;
+
+	// The number of entities that have been turned back into AllyCharacters.
+	int32 NumPromotions = 0;
+
+	// The number of AllyCharacters that have been turned into entities.
+	int32 NumDemotions = 0;
+
+	// The AllyCrowdSubsystem that every AllyAIController is registered with.
+	UPROPERTY()
+	UAllyCrowdSubsystem* CrowdSubsystem;
+
+	// The AllyPoolSubsystem that AllyCharacters are put in while they are entities.
+	UPROPERTY()
+	UAllyPoolSubsystem* PoolSubsystem;
+
+	// The WaypointRegistrySubsystem used to find the WaypointActors that leading entities move to.
+	UPROPERTY()
+	UWaypointRegistrySubsystem* WaypointRegistry;
+
+	/**
+	 * Returns the index of a PlayerCharacter in `Players`, adding it if it isn't there yet.
+	 */
+	int32 FindOrAddPlayer(APlayerCharacter* Player);
+
+	/**
+	 * Removes the PlayerCharacters that are no longer in the world from `Players` and moves
+	 * the entities' indices to match. Entities that followed one of them are left without a
+	 * PlayerCharacter.
+	 */
+	void RemoveInvalidPlayers();
+
+	/**
+	 * Turns AllyCharacters that are further than `ally.Entity.DemoteDistance` from their
+	 * PlayerCharacter into entities.
+	 *
+	 * @param Budget The number of allies that can still be turned into entities or back this frame.
+	 */
+	void DemoteDistantAllies(int32& Budget);
+
+	/**
+	 * Turns entities that are within `ally.Entity.PromoteDistance` of their PlayerCharacter,
+	 * or that have lost their PlayerCharacter, back into AllyCharacters.
+	 *
+	 * @param Budget The number of allies that can still be turned into entities or back this frame.
+	 * @param bPromoteAll Whether to turn every entity back, such as when `ally.Entity.Enabled` is turned off.
+	 */
+	void PromoteNearbyEntities(int32& Budget, bool bPromoteAll);
+
+	/**
+	 * Steps every entity forward in chunks across the task graph.
+	 *
+	 * @param DeltaTime The time since the last frame.
+	 */
+	void SimulateEntities(float DeltaTime);
+
+	/**
+	 * Moves the leading entities that have arrived at their `CurrentWaypoint` on to the next
+	 * one, or back to the FOLLOW state once they are at their `EndWaypoint`.
+	 */
+	void UpdateWaypointArrivals();
+
+	/**
+	 * Turns an entity back into an AllyCharacter that carries on from where the entity was.
+	 *
+	 * @param Entity The entity to turn back into an AllyCharacter.
+	 *
+	 * @return Whether an AllyCharacter could be taken from the AllyPoolSubsystem.
+	 */
+	bool PromoteEntity(const FAllyEntity& Entity);
+
+	/**
+	 * Sets where a leading entity moves to from its `CurrentWaypoint`.
+	 */
+	void UpdateWaypointLocation(FAllyEntity& Entity) const;
+};
@@ -0,0 +1,177 @@
+#include "AllyFollowGroup.h"
+#include "AllyStats.h"
+#include "AllyAIController.h"
+#include "AllyCharacter.h"
+#include "../Player/PlayerCharacter.h"
+#include "NavigationData.h"
+#include "NavigationSystem.h"
+
+// How far a member can be from the shared path before it has to find its own path.
+static const float MaxDistanceFromSharedPath = 300.f;
+
+/**
+ * Adds an AllyAIController to the group and gives it the next formation slot.
+ */
+void FAllyFollowGroup::AddMember(AAllyAIController* Ally)
+{
+	if (Ally == nullptr) return;
+
+	Members.AddUnique(Ally);
+}
+
+/**
+ * Removes an AllyAIController from the group and closes the gap in the formation.
+ */
+void FAllyFollowGroup::RemoveMember(AAllyAIController* Ally)
+{
+	Members.Remove(Ally);
+
+	// Clean up any members that were destroyed without leaving the group.
+	Members.RemoveAll([](const TWeakObjectPtr<AAllyAIController>& Member) { return !Member.IsValid(); });
+}
+
+/**
+ * Finds the path that a member should follow to get to its formation slot.
+ */
+bool FAllyFollowGroup::FindMemberPath(AAllyAIController* Ally, APlayerCharacter* Player, FNavPathSharedPtr& OutPath, FVector& OutSlotLocation)
+{
+	ALLY_AI_SCOPE(STAT_AllyFollowGroupFindPath);
+
+	AAllyCharacter* AllyCharacter = Ally != nullptr ? Cast<AAllyCharacter>(Ally->GetPawn()) : nullptr;
+	if (AllyCharacter == nullptr || Player == nullptr) return false;
+
+	const int32 SlotIndex = Members.IndexOfByKey(Ally);
+	if (SlotIndex == INDEX_NONE) return false;
+
+	if (!UpdateSharedPath(Ally, Player)) return false;
+
+	// Find where the member joins the shared path.
+	const FVector AllyLocation = AllyCharacter->GetNavAgentLocation();
+	int32 JoinSegment = INDEX_NONE;
+	float JoinDistanceSquared = MAX_FLT;
+
+	for (int32 Index = 0; Index < SharedPoints.Num() - 1; ++Index)
+	{
+		const FVector ClosestPoint = FMath::ClosestPointOnSegment(AllyLocation, SharedPoints[Index], SharedPoints[Index + 1]);
+		const float DistanceSquared = FVector::DistSquared(AllyLocation, ClosestPoint);
+
+		if (DistanceSquared < JoinDistanceSquared)
+		{
+			JoinDistanceSquared = DistanceSquared;
+			JoinSegment = Index;
+		}
+	}
+
+	if (JoinSegment == INDEX_NONE || JoinDistanceSquared > FMath::Square(MaxDistanceFromSharedPath)) return false;
+
+	int32 SlotSegment = 0;
+	OutSlotLocation = GetSlotLocation(SlotIndex, AllyCharacter->GetMinDistanceFromPlayer(), AllyCharacter->GetMaxDistanceFromPlayer(), SlotSegment);
+
+	// The slot is offset to the side of the shared path so make sure it is still
+	// somewhere the member can stand, otherwise stand on the shared path instead.
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(Ally->GetWorld());
+	FNavLocation ProjectedSlot;
+	if (NavSys != nullptr && NavSys->ProjectPointToNavigation(OutSlotLocation, ProjectedSlot, FVector(FAllyFollowGroup::SlotSpacing, FAllyFollowGroup::SlotSpacing, 200.f)))
+	{
+		OutSlotLocation = ProjectedSlot.Location;
+	}
+
+	// Follow the shared path from where the member joins it up to its slot. If the
+	// member is already past its slot then it just walks straight back to it.
+	TArray<FVector> Points;
+	Points.Add(AllyLocation);
+	for (int32 Index = JoinSegment + 1; Index <= SlotSegment; ++Index) Points.Add(SharedPoints[Index]);
+	Points.Add(OutSlotLocation);
+
+	OutPath = MakeShared<FNavigationPath, ESPMode::ThreadSafe>(Points);
+	OutPath->MarkReady();
+
+	return true;
+}
+
+/**
+ * Updates the shared path from the following member furthest from the PlayerCharacter to the
+ * PlayerCharacter, unless the PlayerCharacter is still within `ally.PathCache.ReuseTolerance`
+ * of where the shared path ends.
+ */
+bool FAllyFollowGroup::UpdateSharedPath(AAllyAIController* Querier, APlayerCharacter* Player)
+{
+	const FVector PlayerLocation = Player->GetNavAgentLocation();
+
+	// Every member that asks before the PlayerCharacter has moved away gets the same shared
+	// path, no matter which frame it asks on. Members that have strayed from it find their own.
+	if (SharedPoints.Num() > 1 && FVector::Dist(PlayerLocation, SharedGoal) <= FAllyPathCache::GetReuseTolerance()) return true;
+
+	// Start the shared path at the following member that is furthest behind so that every
+	// other member is somewhere along it. Leading members are off towards a WaypointActor.
+	FVector Start = FVector::ZeroVector;
+	float FurthestDistanceSquared = -1.f;
+
+	for (const TWeakObjectPtr<AAllyAIController>& Member : Members)
+	{
+		const AAllyCharacter* MemberPawn = Member.IsValid() ? Cast<AAllyCharacter>(Member->GetPawn()) : nullptr;
+		if (MemberPawn == nullptr || MemberPawn->State != AllyStates::FOLLOW) continue;
+
+		const FVector MemberLocation = MemberPawn->GetNavAgentLocation();
+		const float DistanceSquared = FVector::DistSquared(MemberLocation, PlayerLocation);
+
+		if (DistanceSquared > FurthestDistanceSquared)
+		{
+			FurthestDistanceSquared = DistanceSquared;
+			Start = MemberLocation;
+		}
+	}
+
+	if (FurthestDistanceSquared < 0.f) return false;
+
+	FNavPathSharedPtr SharedPath = SharedPathCache.FindPath(Querier, Start, PlayerLocation);
+	if (!SharedPath.IsValid()) return false;
+
+	SharedPoints.Reset(SharedPath->GetPathPoints().Num());
+	for (const FNavPathPoint& PathPoint : SharedPath->GetPathPoints()) SharedPoints.Add(PathPoint.Location);
+
+	SharedGoal = PlayerLocation;
+	++NumSharedPathUpdates;
+
+	return SharedPoints.Num() > 1;
+}
+
+/**
+ * Returns the location of a formation slot along the shared path.
+ */
+FVector FAllyFollowGroup::GetSlotLocation(int32 SlotIndex, float MinDistance, float MaxDistance, int32& OutSegment) const
+{
+	// Spread the rows of the formation out evenly between the minimum and maximum
+	// distance from the PlayerCharacter.
+	const int32 NumRows = FMath::DivideAndRoundUp(Members.Num(), SlotsPerRow);
+	const int32 Row = SlotIndex / SlotsPerRow;
+	const int32 Column = SlotIndex % SlotsPerRow - (SlotsPerRow - 1) / 2;
+
+	const float DistanceFromPlayer = FMath::Lerp(MinDistance, MaxDistance, (Row + 0.5f) / NumRows);
+
+	// Walk backwards along the shared path from the PlayerCharacter until we have
+	// covered `DistanceFromPlayer`.
+	float Remaining = DistanceFromPlayer;
+	OutSegment = 0;
+	FVector SlotLocation = SharedPoints[0];
+
+	for (int32 Index = SharedPoints.Num() - 2; Index >= 0; --Index)
+	{
+		const float SegmentLength = FVector::Dist(SharedPoints[Index], SharedPoints[Index + 1]);
+
+		if (Remaining <= SegmentLength)
+		{
+			OutSegment = Index;
+			SlotLocation = FMath::Lerp(SharedPoints[Index + 1], SharedPoints[Index], SegmentLength > 0.f ? Remaining / SegmentLength : 0.f);
+			break;
+		}
+
+		Remaining -= SegmentLength;
+	}
+
+	// Offset the slot to the side of the shared path based on its column.
+	const FVector Direction = (SharedPoints[OutSegment + 1] - SharedPoints[OutSegment]).GetSafeNormal2D();
+	const FVector Right(-Direction.Y, Direction.X, 0.f);
+
+	return SlotLocation + Right * (Column * SlotSpacing);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AllyPathCache.h"
+
+class AAllyAIController;
+class APlayerCharacter;
+
+/**
+ * A group of AllyCharacters that follow the same PlayerCharacter. The group finds
+ * one path to the PlayerCharacter and every member follows that path to its own
+ * formation slot behind the PlayerCharacter, so the cost of finding paths doesn't
+ * grow with the number of members and members don't pile into the same spot.
+ */
+class FOLLOWLEADAI_API FAllyFollowGroup
+{
+public:
+	// How many formation slots there are side by side in each row.
+	static constexpr int32 SlotsPerRow = 3;
+
+	// The distance between two formation slots in the same row.
+	static constexpr float SlotSpacing = 120.f;
+
+public:
+	/**
+	 * Adds an AllyAIController to the group and gives it the next formation slot.
+	 */
+	void AddMember(AAllyAIController* Ally);
+
+	/**
+	 * Removes an AllyAIController from the group and closes the gap in the formation.
+	 */
+	void RemoveMember(AAllyAIController* Ally);
+
+	/**
+	 * Returns whether the group has no members left.
+	 */
+	bool IsEmpty() const { return Members.Num() == 0; }
+
+	/**
+	 * Finds the path that a member should follow to get to its formation slot.
+	 *
+	 * @param Ally The member to find the path for.
+	 * @param Player The PlayerCharacter that the group is following.
+	 * @param OutPath The path to the member's formation slot.
+	 * @param OutSlotLocation The location of the member's formation slot.
+	 *
+	 * @return Whether a path was found or not. If not, the member should find its own path.
+	 */
+	bool FindMemberPath(AAllyAIController* Ally, APlayerCharacter* Player, FNavPathSharedPtr& OutPath, FVector& OutSlotLocation);
+
+	/**
+	 * Returns the number of times the group has had to update its shared path.
+	 */
+	int32 GetNumSharedPathUpdates() const { return NumSharedPathUpdates; }
+
+private:
+	// The members of the group in formation slot order.
+	TArray<TWeakObjectPtr<AAllyAIController>> Members;
+
+	// The cache used to find the one shared path to the PlayerCharacter.
+	FAllyPathCache SharedPathCache;
+
+	// The points of the shared path to the PlayerCharacter.
+	TArray<FVector> SharedPoints;
+
+	// Where the PlayerCharacter was when the shared path was last updated, so that members
+	// keep using the same shared path until the PlayerCharacter moves away from it.
+	FVector SharedGoal = FVector::ZeroVector;
+
+	// The number of times the group has had to update its shared path.
+	int32 NumSharedPathUpdates = 0;
+
+	/**
+	 * Updates the shared path from the following member furthest from the PlayerCharacter to the
+	 * PlayerCharacter, unless the PlayerCharacter is still within `ally.PathCache.ReuseTolerance`
+	 * of where the shared path ends.
+	 *
+	 * @return Whether there is a shared path or not.
+	 */
+	bool UpdateSharedPath(AAllyAIController* Querier, APlayerCharacter* Player);
+
+	/**
+	 * Returns the location of a formation slot along the shared path.
+	 *
+	 * @param SlotIndex The index of the slot.
+	 * @param MinDistance The minimum distance the slot can be from the PlayerCharacter.
+	 * @param MaxDistance The maximum distance the slot can be from the PlayerCharacter.
+	 * @param OutSegment The index of the segment of the shared path that the slot is on.
+	 */
+	FVector GetSlotLocation(int32 SlotIndex, float MinDistance, float MaxDistance, int32& OutSegment) const;
+};
@@ -0,0 +1,303 @@
+#include "AllyFollowLeadSim.h"
+#include "AllyCrowdSubsystem.h"
+#include "../Player/PlayerCharacter.h"
+#include "../WaypointRegistrySubsystem.h"
+#include "Misc/Crc.h"
+
+/**
+ * Returns settings with the distances and speeds of the AllyCharacter and PlayerCharacter
+ * defaults and the current values of the console variables the AllyCrowdSubsystem uses.
+ */
+FAllyFollowLeadSimSettings FAllyFollowLeadSimSettings::FromGame()
+{
+	FAllyFollowLeadSimSettings Settings;
+
+	const AAllyCharacter* Ally = GetDefault<AAllyCharacter>();
+	Settings.MinDistanceFromPlayer = Ally->GetMinDistanceFromPlayer();
+	Settings.MaxDistanceFromPlayer = Ally->GetMaxDistanceFromPlayer();
+	Settings.MaxDistanceFromPlayerBeforeSprint = Ally->GetMaxDistanceFromPlayerBeforeSprint();
+	Settings.SprintHysteresis = Ally->GetSprintHysteresis();
+	Settings.MaxDistanceFromPlayerWhileLeading = Ally->GetMaxDistanceFromPlayerWhileLeading();
+	Settings.AllyWalkSpeed = Ally->GetWalkSpeed();
+	Settings.AllySprintSpeed = Ally->GetSprintSpeed();
+	Settings.AllySpeedChangeRate = Ally->GetSpeedChangeRate();
+
+	const APlayerCharacter* Player = GetDefault<APlayerCharacter>();
+	Settings.PlayerWalkSpeed = Player->GetWalkSpeed();
+	Settings.PlayerSprintSpeed = Player->GetSprintSpeed();
+
+	Settings.MinSprintToggleInterval = UAllyCrowdSubsystem::GetMinSprintToggleInterval();
+	Settings.LeadTimeSlices = UAllyCrowdSubsystem::GetLeadTimeSlices();
+
+	return Settings;
+}
+
+/**
+ * Sets up the simulation.
+ */
+FAllyFollowLeadSim::FAllyFollowLeadSim(const FAllyFollowLeadSimSettings& InSettings, const FAllyBenchmarkScript& InScript)
+	: Settings(InSettings)
+	, Script(InScript)
+	, RandomStream(InSettings.Seed)
+{
+	for (int32 Index = 0; Index < Settings.NumWaypoints; ++Index)
+	{
+		const float Angle = 2.f * PI * Index / Settings.NumWaypoints;
+		Waypoints.Add(FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.f) * Settings.WaypointLoopRadius);
+	}
+
+	// Start the allies scattered around the player, like the AllyBenchmarkGameMode does.
+	Agents.SetNum(Settings.NumAllies);
+	for (FAllySimAgent& Agent : Agents)
+	{
+		const float Angle = RandomStream.FRandRange(0.f, 2.f * PI);
+		Agent.Location = FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.f) * RandomStream.FRandRange(200.f, 1500.f);
+		Agent.Speed = Settings.AllyWalkSpeed;
+		StateStore.Add();
+		MoveToPlayer(Agent);
+	}
+}
+
+/**
+ * Runs the simulation for a number of simulated seconds.
+ */
+void FAllyFollowLeadSim::Run(float Seconds)
+{
+	// Count whole steps so that floating point error in `Time` can't change how many run.
+	const int64 NumStepsToRun = FMath::RoundToInt(Seconds / Settings.StepSeconds);
+	for (int64 StepIndex = 0; StepIndex < NumStepsToRun; ++StepIndex) Step();
+}
+
+/**
+ * Advances the simulation by a single step.
+ */
+void FAllyFollowLeadSim::Step()
+{
+	++NumSteps;
+	Time = static_cast<float>(NumSteps * static_cast<double>(Settings.StepSeconds));
+
+	StepPlayer();
+
+	// Make the sprint and lead-wait decisions for every ally at once, exactly like the
+	// AllyCrowdSubsystem does before running the tasks.
+	for (int32 Index = 0; Index < Agents.Num(); ++Index)
+	{
+		const FAllySimAgent& Agent = Agents[Index];
+
+		uint8 StateBits = FAllyStateStore::State_HasPlayer;
+		if (Agent.State == AllyStates::LEAD) StateBits |= FAllyStateStore::State_Lead;
+		if (Agent.bIsSprinting) StateBits |= FAllyStateStore::State_Sprinting;
+		if (Agent.bShouldWaitWhenLeading) StateBits |= FAllyStateStore::State_ShouldWaitWhenLeading;
+
+		StateStore.SetAlly(Index, Agent.Location, PlayerLocation, Settings.MaxDistanceFromPlayerBeforeSprint, Settings.MaxDistanceFromPlayerBeforeSprint - Settings.SprintHysteresis, Settings.MaxDistanceFromPlayerWhileLeading, StateBits);
+	}
+	StateStore.Evaluate();
+
+	for (int32 Index = 0; Index < Agents.Num(); ++Index) StepAgent(Index);
+}
+
+/**
+ * Moves the player with the script's input and broadcasts any lead requests that are due.
+ */
+void FAllyFollowLeadSim::StepPlayer()
+{
+	// The script loops so that the simulation can run for as long as needed.
+	const float Duration = FMath::Max(Script.Duration, Settings.StepSeconds);
+	const float ScriptTime = FMath::Fmod(Time, Duration);
+
+	if (ScriptTime < Settings.StepSeconds) NextLeadRequest = 0;
+
+	FVector2D Input;
+	Script.SampleInput(ScriptTime, Input, bIsPlayerSprinting);
+
+	const bool bWasPlayerMoving = bIsPlayerMoving;
+	bIsPlayerMoving = !Input.IsNearlyZero();
+
+	if (bIsPlayerMoving)
+	{
+		const float Speed = bIsPlayerSprinting ? Settings.PlayerSprintSpeed : Settings.PlayerWalkSpeed;
+		PlayerLocation += FVector(Input.GetSafeNormal(), 0.f) * Speed * Settings.StepSeconds;
+	}
+
+	// Allies that were waiting for the player start following again as soon as the
+	// player moves, like `AAllyAIController::OnPlayerMovingChanged`.
+	if (bIsPlayerMoving && !bWasPlayerMoving)
+	{
+		for (FAllySimAgent& Agent : Agents)
+		{
+			if (Agent.State == AllyStates::FOLLOW && Agent.bIsWaitingForPlayer)
+			{
+				Agent.bIsWaitingForPlayer = false;
+				Agent.NextSprintTime = Time + UAllyCrowdSubsystem::SprintInterval;
+				MoveToPlayer(Agent);
+			}
+		}
+	}
+
+	while (Script.LeadRequests.IsValidIndex(NextLeadRequest) && Script.LeadRequests[NextLeadRequest].Time <= ScriptTime)
+	{
+		MakeAllLead(Script.LeadRequests[NextLeadRequest++]);
+	}
+}
+
+/**
+ * Puts every ally in the LEAD state, like `AAllyAIController::MakeAllyLead`.
+ */
+void FAllyFollowLeadSim::MakeAllLead(const FAllyBenchmarkLeadRequest& Request)
+{
+	if (Waypoints.Num() == 0) return;
+
+	const int32 NumSlices = FMath::Max(1, Settings.LeadTimeSlices);
+
+	for (int32 Index = 0; Index < Agents.Num(); ++Index)
+	{
+		FAllySimAgent& Agent = Agents[Index];
+
+		if (Agent.State != AllyStates::LEAD) ++NumStateTransitions;
+
+		Agent.State = AllyStates::LEAD;
+		Agent.bIsWaitingForPlayer = false;
+		Agent.bShouldWaitWhenLeading = Request.bShouldWaitForPlayer;
+		Agent.CurrentWaypoint = FMath::Clamp(Request.StartWaypoint, 0, Waypoints.Num() - 1);
+		Agent.EndWaypoint = FMath::Clamp(Request.EndWaypoint, 0, Waypoints.Num() - 1);
+		Agent.LeadMoveWaypoint = INDEX_NONE;
+		Agent.NextLeadTime = Time + UAllyCrowdSubsystem::LeadInterval * float(Index % NumSlices) / NumSlices;
+	}
+}
+
+/**
+ * Moves an ally towards its player or waypoint and runs any of its tasks that are due.
+ */
+void FAllyFollowLeadSim::StepAgent(int32 Index)
+{
+	FAllySimAgent& Agent = Agents[Index];
+
+	if (Agent.State == AllyStates::FOLLOW)
+	{
+		if (Agent.bIsMoving)
+		{
+			// Ramp the speed the same way `AAllyCharacter::UpdateWalkSpeed` does.
+			const float TargetSpeed = Agent.bIsSprinting ? Settings.AllySprintSpeed : Settings.AllyWalkSpeed;
+			Agent.Speed = Settings.AllySpeedChangeRate > 0.f ? FMath::FInterpConstantTo(Agent.Speed, TargetSpeed, Settings.StepSeconds, Settings.AllySpeedChangeRate) : TargetSpeed;
+
+			if (MoveTowards(Agent.Location, PlayerLocation, Agent.Speed, Agent.AcceptanceRadius))
+			{
+				// Like `OnMoveCompleted`, keep following if the player is still moving and
+				// otherwise wait for them to start moving again.
+				if (bIsPlayerMoving)
+				{
+					MoveToPlayer(Agent);
+				}
+				else
+				{
+					Agent.bIsMoving = false;
+					Agent.bIsWaitingForPlayer = true;
+				}
+			}
+		}
+
+		if (!Agent.bIsWaitingForPlayer && Time >= Agent.NextSprintTime)
+		{
+			Agent.NextSprintTime = Time + UAllyCrowdSubsystem::SprintInterval;
+
+			if (StateStore.IsSprintFlipped(Index) && Time - Agent.LastSprintToggleTime >= Settings.MinSprintToggleInterval)
+			{
+				Agent.LastSprintToggleTime = Time;
+				Agent.bIsSprinting = StateStore.WantsSprint(Index);
+				StateStore.SetSprinting(Index, Agent.bIsSprinting);
+				++NumSprintToggles;
+			}
+		}
+	}
+	else
+	{
+		if (Time >= Agent.NextLeadTime)
+		{
+			Agent.NextLeadTime = Time + UAllyCrowdSubsystem::LeadInterval;
+
+			// Like `AAllyAIController::MoveToWaypoint`, only stop or move again when something changed.
+			if (StateStore.WantsWaitForPlayer(Index))
+			{
+				Agent.bIsMoving = false;
+			}
+			else if (!Agent.bIsMoving || Agent.LeadMoveWaypoint != Agent.CurrentWaypoint)
+			{
+				Agent.bIsMoving = true;
+				Agent.LeadMoveWaypoint = Agent.CurrentWaypoint;
+				++NumMoveRequests;
+			}
+		}
+
+		if (Agent.bIsMoving && MoveTowards(Agent.Location, Waypoints[Agent.CurrentWaypoint], Settings.AllyWalkSpeed, Settings.WaypointArrivalRadius))
+		{
+			++NumWaypointArrivals;
+
+			// The simulated waypoints are numbered by their index, and step towards the end
+			// the same way as the game's WaypointActors.
+			const int32 NextWaypoint = UWaypointRegistrySubsystem::GetNextWaypointIndex(Agent.CurrentWaypoint, Agent.CurrentWaypoint, Agent.EndWaypoint, Waypoints.Num());
+			if (NextWaypoint == INDEX_NONE)
+			{
+				// Done leading so go back to following the player.
+				Agent.State = AllyStates::FOLLOW;
+				++NumStateTransitions;
+				MoveToPlayer(Agent);
+			}
+			else
+			{
+				Agent.CurrentWaypoint = NextWaypoint;
+			}
+		}
+	}
+}
+
+/**
+ * Moves a location towards a target, returning whether it got there.
+ */
+bool FAllyFollowLeadSim::MoveTowards(FVector& Location, const FVector& Target, float Speed, float AcceptanceRadius) const
+{
+	const FVector ToTarget = Target - Location;
+	const float Distance = ToTarget.Size();
+	if (Distance <= AcceptanceRadius) return true;
+
+	const float StepDistance = FMath::Min(Speed * Settings.StepSeconds, Distance - AcceptanceRadius);
+	Location += ToTarget / Distance * StepDistance;
+
+	return Distance - StepDistance <= AcceptanceRadius;
+}
+
+/**
+ * Starts a new move to the player, like `AAllyAIController::MoveToPlayerCharacter`.
+ */
+void FAllyFollowLeadSim::MoveToPlayer(FAllySimAgent& Agent)
+{
+	Agent.AcceptanceRadius = RandomStream.FRandRange(Settings.MinDistanceFromPlayer, Settings.MaxDistanceFromPlayer);
+	Agent.bIsMoving = true;
+	++NumMoveRequests;
+}
+
+/**
+ * Returns a checksum of the state of the simulation.
+ */
+uint32 FAllyFollowLeadSim::GetChecksum() const
+{
+	uint32 Checksum = 0;
+
+	const auto AddLocation = [&Checksum](const FVector& Location)
+	{
+		const FIntVector Quantized(FMath::RoundToInt(Location.X), FMath::RoundToInt(Location.Y), FMath::RoundToInt(Location.Z));
+		Checksum = FCrc::MemCrc32(&Quantized, sizeof(Quantized), Checksum);
+	};
+
+	AddLocation(PlayerLocation);
+
+	for (const FAllySimAgent& Agent : Agents)
+	{
+		AddLocation(Agent.Location);
+
+		const uint8 Flags[] = { static_cast<uint8>(Agent.State), Agent.bIsSprinting, Agent.bIsMoving, Agent.bIsWaitingForPlayer };
+		Checksum = FCrc::MemCrc32(Flags, sizeof(Flags), Checksum);
+		Checksum = FCrc::MemCrc32(&Agent.CurrentWaypoint, sizeof(Agent.CurrentWaypoint), Checksum);
+	}
+
+	return Checksum;
+}
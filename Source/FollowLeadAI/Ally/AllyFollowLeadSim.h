@@ -0,0 +1,195 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AllyCharacter.h"
+#include "AllyStateStore.h"
+#include "../Benchmark/AllyBenchmarkScript.h"
+
+/**
+ * The settings of an FAllyFollowLeadSim. The defaults match the defaults of the
+ * AllyCharacter and PlayerCharacter, and `FromGame` picks up any changes to them.
+ */
+struct FOLLOWLEADAI_API FAllyFollowLeadSimSettings
+{
+	/**
+	 * Returns settings with the distances and speeds of the AllyCharacter and PlayerCharacter
+	 * defaults and the current values of the console variables the AllyCrowdSubsystem uses,
+	 * so that the simulation keeps making the same decisions as the game when they change.
+	 */
+	static FAllyFollowLeadSimSettings FromGame();
+
+	// The seed of the random stream that every random choice in the simulation comes from.
+	int32 Seed = 1;
+
+	// The number of simulated allies.
+	int32 NumAllies = 100;
+
+	// The length, in seconds, of a single simulation step.
+	float StepSeconds = 1.f / 30.f;
+
+	// The number of simulated waypoints, which are laid out on a loop around the start.
+	int32 NumWaypoints = 8;
+
+	// The radius, in units, of the loop the waypoints are laid out on.
+	float WaypointLoopRadius = 3000.f;
+
+	// How close, in units, an ally has to get to a waypoint to have arrived at it.
+	float WaypointArrivalRadius = 90.f;
+
+	// The same distances and speeds as the AllyCharacter.
+	float MinDistanceFromPlayer = 100.f;
+	float MaxDistanceFromPlayer = 500.f;
+	float MaxDistanceFromPlayerBeforeSprint = 600.f;
+	float SprintHysteresis = 150.f;
+	float MaxDistanceFromPlayerWhileLeading = 500.f;
+	float AllyWalkSpeed = 200.f;
+	float AllySprintSpeed = 500.f;
+	float AllySpeedChangeRate = 600.f;
+
+	// The same shortest time between two sprint toggles as `ally.Sprint.MinToggleInterval`.
+	float MinSprintToggleInterval = 1.5f;
+
+	// The same number of slices the lead interval is split into as `ally.Lead.TimeSlices`.
+	int32 LeadTimeSlices = 8;
+
+	// The same speeds as the PlayerCharacter.
+	float PlayerWalkSpeed = 200.f;
+	float PlayerSprintSpeed = 500.f;
+};
+
+/**
+ * A simulated ally.
+ */
+struct FAllySimAgent
+{
+	FVector Location = FVector::ZeroVector;
+	AllyStates State = AllyStates::FOLLOW;
+	bool bIsSprinting = false;
+	bool bIsMoving = false;
+	bool bShouldWaitWhenLeading = false;
+	bool bIsWaitingForPlayer = false;
+
+	// The current maximum speed, which moves towards the walk or sprint speed.
+	float Speed = 200.f;
+
+	// The simulation time at which the ally last started or stopped sprinting.
+	float LastSprintToggleTime = -MAX_FLT;
+
+	// The acceptance radius of the current move to the player.
+	float AcceptanceRadius = 0.f;
+
+	// The index of the waypoint the ally is leading to and the one it stops leading at.
+	int32 CurrentWaypoint = INDEX_NONE;
+	int32 EndWaypoint = INDEX_NONE;
+
+	// The index of the waypoint the last lead move was sent towards.
+	int32 LeadMoveWaypoint = INDEX_NONE;
+
+	// The simulation time at which the ally's sprint and lead tasks run next.
+	float NextSprintTime = 0.f;
+	float NextLeadTime = 0.f;
+};
+
+/**
+ * A deterministic, fixed-step simulation of the follow and lead behavior. It has no
+ * world, navmesh, timers, or physics, so allies move in straight lines, but every
+ * decision is made the same way the AllyCrowdSubsystem makes it: through an
+ * FAllyStateStore evaluated at the same intervals. The same seed, settings, and
+ * script always give the same result, which makes it usable for profiling and
+ * regression testing on a machine without a GPU.
+ */
+class FOLLOWLEADAI_API FAllyFollowLeadSim
+{
+public:
+	/**
+	 * Sets up the simulation.
+	 *
+	 * @param InSettings The settings of the simulation.
+	 * @param InScript The input and lead requests of the player, which loop.
+	 */
+	FAllyFollowLeadSim(const FAllyFollowLeadSimSettings& InSettings, const FAllyBenchmarkScript& InScript);
+
+	/**
+	 * Runs the simulation for a number of simulated seconds.
+	 */
+	void Run(float Seconds);
+
+	/**
+	 * Advances the simulation by a single step.
+	 */
+	void Step();
+
+	/**
+	 * Returns the simulated time, in seconds.
+	 */
+	float GetTime() const { return Time; }
+
+	/**
+	 * Returns a checksum of the state of the simulation, which is the same for two
+	 * runs if and only if they behaved the same, to within a centimeter.
+	 */
+	uint32 GetChecksum() const;
+
+	/**
+	 * Returns the simulated allies.
+	 */
+	const TArray<FAllySimAgent>& GetAgents() const { return Agents; }
+
+	// How many of each event happened in the simulation.
+	int32 NumMoveRequests = 0;
+	int32 NumStateTransitions = 0;
+	int32 NumSprintToggles = 0;
+	int32 NumWaypointArrivals = 0;
+
+private:
+	FAllyFollowLeadSimSettings Settings;
+	FAllyBenchmarkScript Script;
+
+	// Every random choice comes from this stream.
+	FRandomStream RandomStream;
+
+	// The simulated time, in seconds, and the number of steps taken.
+	float Time = 0.f;
+	int64 NumSteps = 0;
+
+	// The simulated player.
+	FVector PlayerLocation = FVector::ZeroVector;
+	bool bIsPlayerMoving = false;
+	bool bIsPlayerSprinting = false;
+
+	// The index of the next lead request in the script.
+	int32 NextLeadRequest = 0;
+
+	// The location of each simulated waypoint.
+	TArray<FVector> Waypoints;
+
+	TArray<FAllySimAgent> Agents;
+
+	// The same packed decisions the AllyCrowdSubsystem uses.
+	FAllyStateStore StateStore;
+
+	/**
+	 * Moves the player with the script's input and broadcasts any lead requests that are due.
+	 */
+	void StepPlayer();
+
+	/**
+	 * Puts every ally in the LEAD state, like `AAllyAIController::MakeAllyLead`.
+	 */
+	void MakeAllLead(const FAllyBenchmarkLeadRequest& Request);
+
+	/**
+	 * Moves an ally towards its player or waypoint and runs any of its tasks that are due.
+	 */
+	void StepAgent(int32 Index);
+
+	/**
+	 * Moves a location towards a target, returning whether it got there.
+	 */
+	bool MoveTowards(FVector& Location, const FVector& Target, float Speed, float AcceptanceRadius) const;
+
+	/**
+	 * Starts a new move to the player, like `AAllyAIController::MoveToPlayerCharacter`.
+	 */
+	void MoveToPlayer(FAllySimAgent& Agent);
+};
@@ -0,0 +1,142 @@
+#include "AllyLOD.h"
+#include "HAL/IConsoleManager.h"
+
+// How close, in units, an ally has to be to the camera to be in the HIGH tier.
+static TAutoConsoleVariable<float> CVarAllyLODHighDistance(
+	TEXT("ally.LOD.HighDistance"),
+	2000.f,
+	TEXT("Allies closer than this to the player's camera are in the HIGH tier."),
+	ECVF_Default);
+
+// How close, in units, an ally has to be to the camera to be in the MEDIUM tier.
+static TAutoConsoleVariable<float> CVarAllyLODMediumDistance(
+	TEXT("ally.LOD.MediumDistance"),
+	5000.f,
+	TEXT("Allies closer than this to the player's camera are in the MEDIUM tier, and everything further is in the LOW tier."),
+	ECVF_Default);
+
+// Whether allies that are off screen are moved down a tier.
+static TAutoConsoleVariable<int32> CVarAllyLODDemoteHidden(
+	TEXT("ally.LOD.DemoteHidden"),
+	1,
+	TEXT("Whether allies that are off screen are moved down one tier."),
+	ECVF_Default);
+
+// How much the sprint and lead intervals are scaled by for each tier.
+static TAutoConsoleVariable<float> CVarAllyLODMediumDecisionScale(
+	TEXT("ally.LOD.Medium.DecisionScale"),
+	2.f,
+	TEXT("How much longer than normal allies in the MEDIUM tier wait between decisions."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarAllyLODLowDecisionScale(
+	TEXT("ally.LOD.Low.DecisionScale"),
+	4.f,
+	TEXT("How much longer than normal allies in the LOW tier wait between decisions."),
+	ECVF_Default);
+
+// The shortest time, in seconds, between two follow repaths for each tier.
+static TAutoConsoleVariable<float> CVarAllyLODMediumRepathInterval(
+	TEXT("ally.LOD.Medium.RepathInterval"),
+	0.5f,
+	TEXT("The shortest time in seconds between two repaths of allies in the MEDIUM tier."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarAllyLODLowRepathInterval(
+	TEXT("ally.LOD.Low.RepathInterval"),
+	1.5f,
+	TEXT("The shortest time in seconds between two repaths of allies in the LOW tier."),
+	ECVF_Default);
+
+// How many frames apart the animation properties are updated for each tier.
+static TAutoConsoleVariable<int32> CVarAllyLODMediumAnimInterval(
+	TEXT("ally.LOD.Medium.AnimInterval"),
+	2,
+	TEXT("How many frames apart allies in the MEDIUM tier update their animation properties."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarAllyLODLowAnimInterval(
+	TEXT("ally.LOD.Low.AnimInterval"),
+	4,
+	TEXT("How many frames apart allies in the LOW tier update their animation properties."),
+	ECVF_Default);
+
+// How much the rate at which allies send their movement to clients is scaled by for each tier.
+static TAutoConsoleVariable<float> CVarAllyLODMediumNetUpdateScale(
+	TEXT("ally.LOD.Medium.NetUpdateScale"),
+	0.5f,
+	TEXT("How much the rate at which allies in the MEDIUM tier send their movement to clients is scaled by."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarAllyLODLowNetUpdateScale(
+	TEXT("ally.LOD.Low.NetUpdateScale"),
+	0.2f,
+	TEXT("How much the rate at which allies in the LOW tier send their movement to clients is scaled by."),
+	ECVF_Default);
+
+/**
+ * Returns the tier that an AllyCharacter is in.
+ */
+EAllyLODTier FAllyLOD::GetTier(float DistanceSquaredToCamera, bool bIsVisible)
+{
+	int32 Tier = static_cast<int32>(EAllyLODTier::LOW);
+	if (DistanceSquaredToCamera < FMath::Square(CVarAllyLODHighDistance.GetValueOnAnyThread())) Tier = static_cast<int32>(EAllyLODTier::HIGH);
+	else if (DistanceSquaredToCamera < FMath::Square(CVarAllyLODMediumDistance.GetValueOnAnyThread())) Tier = static_cast<int32>(EAllyLODTier::MEDIUM);
+
+	// Allies that can't be seen don't need to look or react as sharply.
+	if (!bIsVisible && CVarAllyLODDemoteHidden.GetValueOnAnyThread() != 0) Tier = FMath::Min(Tier + 1, NumTiers - 1);
+
+	return static_cast<EAllyLODTier>(Tier);
+}
+
+/**
+ * Returns how much longer than normal an AllyCharacter in a tier waits between decisions.
+ */
+float FAllyLOD::GetDecisionIntervalScale(EAllyLODTier Tier)
+{
+	switch (Tier)
+	{
+	case EAllyLODTier::MEDIUM: return FMath::Max(CVarAllyLODMediumDecisionScale.GetValueOnAnyThread(), 1.f);
+	case EAllyLODTier::LOW: return FMath::Max(CVarAllyLODLowDecisionScale.GetValueOnAnyThread(), 1.f);
+	default: return 1.f;
+	}
+}
+
+/**
+ * Returns the shortest time, in seconds, between two repaths of an AllyCharacter in a tier.
+ */
+float FAllyLOD::GetMinRepathInterval(EAllyLODTier Tier)
+{
+	switch (Tier)
+	{
+	case EAllyLODTier::MEDIUM: return FMath::Max(CVarAllyLODMediumRepathInterval.GetValueOnAnyThread(), 0.f);
+	case EAllyLODTier::LOW: return FMath::Max(CVarAllyLODLowRepathInterval.GetValueOnAnyThread(), 0.f);
+	default: return 0.f;
+	}
+}
+
+/**
+ * Returns how many frames apart an AllyCharacter in a tier updates its animation properties.
+ */
+int32 FAllyLOD::GetAnimUpdateInterval(EAllyLODTier Tier)
+{
+	switch (Tier)
+	{
+	case EAllyLODTier::MEDIUM: return FMath::Max(CVarAllyLODMediumAnimInterval.GetValueOnAnyThread(), 1);
+	case EAllyLODTier::LOW: return FMath::Max(CVarAllyLODLowAnimInterval.GetValueOnAnyThread(), 1);
+	default: return 1;
+	}
+}
+
+/**
+ * Returns how much the rate at which an AllyCharacter in a tier sends its movement to clients is scaled by.
+ */
+float FAllyLOD::GetNetUpdateFrequencyScale(EAllyLODTier Tier)
+{
+	switch (Tier)
+	{
+	case EAllyLODTier::MEDIUM: return FMath::Clamp(CVarAllyLODMediumNetUpdateScale.GetValueOnAnyThread(), 0.f, 1.f);
+	case EAllyLODTier::LOW: return FMath::Clamp(CVarAllyLODLowNetUpdateScale.GetValueOnAnyThread(), 0.f, 1.f);
+	default: return 1.f;
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AllyLOD.generated.h"
+
+/**
+ * How much attention an AllyCharacter gets based on how far it is from the
+ * PlayerCharacter's camera and whether it is on screen.
+ */
+UENUM(BlueprintType)
+enum class EAllyLODTier : uint8 {
+	HIGH	UMETA(DisplayName = "HIGH"),
+	MEDIUM	UMETA(DisplayName = "MEDIUM"),
+	LOW		UMETA(DisplayName = "LOW"),
+};
+
+/**
+ * Decides which EAllyLODTier an AllyCharacter is in and how each tier scales how
+ * often the AllyCharacter makes decisions, finds paths, and updates its animation.
+ * Every value can be changed with the `ally.LOD.*` console variables.
+ */
+struct FOLLOWLEADAI_API FAllyLOD
+{
+	// The number of tiers in EAllyLODTier.
+	static constexpr int32 NumTiers = 3;
+
+	/**
+	 * Returns the tier that an AllyCharacter is in.
+	 *
+	 * @param DistanceSquaredToCamera The squared distance from the AllyCharacter to the PlayerCharacter's camera.
+	 * @param bIsVisible Whether the AllyCharacter was rendered recently or not.
+	 */
+	static EAllyLODTier GetTier(float DistanceSquaredToCamera, bool bIsVisible);
+
+	/**
+	 * Returns how much longer than normal an AllyCharacter in a tier waits between decisions.
+	 */
+	static float GetDecisionIntervalScale(EAllyLODTier Tier);
+
+	/**
+	 * Returns the shortest time, in seconds, between two repaths of an AllyCharacter in a tier.
+	 */
+	static float GetMinRepathInterval(EAllyLODTier Tier);
+
+	/**
+	 * Returns how many frames apart an AllyCharacter in a tier updates its animation properties.
+	 */
+	static int32 GetAnimUpdateInterval(EAllyLODTier Tier);
+
+	/**
+	 * Returns how much the rate at which an AllyCharacter in a tier sends its movement to clients is scaled by.
+	 */
+	static float GetNetUpdateFrequencyScale(EAllyLODTier Tier);
+};
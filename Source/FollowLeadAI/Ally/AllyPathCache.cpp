@@ -0,0 +1,171 @@
+#include "AllyPathCache.h"
+#include "AllyStats.h"
+#include "NavigationData.h"
+#include "NavigationSystem.h"
+#include "GameFramework/Controller.h"
+#include "HAL/IConsoleManager.h"
+#include "NavFilters/NavigationQueryFilter.h"
+
+// How far the goal can move, in units, before the previous path is no longer reused as is.
+static TAutoConsoleVariable<float> CVarAllyPathCacheReuseTolerance(
+	TEXT("ally.PathCache.ReuseTolerance"),
+	50.f,
+	TEXT("How far the goal can move before an ally's previous follow path is no longer reused as is."),
+	ECVF_Default);
+
+// How far the goal can move, in units, before the previous path is thrown away.
+static TAutoConsoleVariable<float> CVarAllyPathCacheSpliceTolerance(
+	TEXT("ally.PathCache.SpliceTolerance"),
+	300.f,
+	TEXT("How far the goal can move before an ally's previous follow path is thrown away instead of having its tail re-queried."),
+	ECVF_Default);
+
+// How far an ally can stray from its previous path before the path is thrown away.
+static TAutoConsoleVariable<float> CVarAllyPathCacheMaxDeviation(
+	TEXT("ally.PathCache.MaxDeviation"),
+	100.f,
+	TEXT("How far an ally can be from its previous follow path before the path is thrown away."),
+	ECVF_Default);
+
+// Logs the combined stats of every ally's path cache.
+static FAutoConsoleCommand AllyPathCacheStatsCommand(
+	TEXT("ally.PathCache.Stats"),
+	TEXT("Logs how many ally follow paths were reused, spliced, or queried from scratch."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		const FAllyPathCacheStats& Stats = FAllyPathCache::GetGlobalStats();
+		UE_LOG(LogTemp, Display, TEXT("Ally path cache: %d hits, %d splices, %d misses, %.1f%% hit rate"), Stats.Hits, Stats.Splices, Stats.Misses, Stats.GetHitRate() * 100.f);
+	}));
+
+FAllyPathCacheStats FAllyPathCache::GlobalStats;
+
+/**
+ * Returns a path from `Start` to `Goal`, reusing or splicing the previous path
+ * when the goal hasn't moved far enough to need a full path query.
+ */
+FNavPathSharedPtr FAllyPathCache::FindPath(AController* Querier, const FVector& Start, const FVector& Goal)
+{
+	ALLY_AI_SCOPE(STAT_AllyPathCacheFindPath);
+
+	TArray<FVector> Points;
+
+	const float GoalDistance = FVector::Dist(Goal, CachedGoal);
+	const bool bCanUseCachedPath = GetPointsAhead(CachedPoints, Start, Points);
+
+	if (bCanUseCachedPath && GoalDistance <= GetReuseTolerance())
+	{
+		// The goal has barely moved so the rest of the previous path is still good.
+		++Stats.Hits;
+		++GlobalStats.Hits;
+	}
+	else if (bCanUseCachedPath && GoalDistance <= CVarAllyPathCacheSpliceTolerance.GetValueOnGameThread())
+	{
+		// The goal has moved a little so we keep the previous path and only query
+		// the short tail from the old goal to the new goal.
+		TArray<FVector> TailPoints;
+		if (!QueryPath(Querier, CachedPoints.Last(), Goal, TailPoints))
+		{
+			Invalidate();
+			return nullptr;
+		}
+
+		// The first point of the tail is the end of the previous path so skip it.
+		for (int32 Index = 1; Index < TailPoints.Num(); ++Index) Points.Add(TailPoints[Index]);
+
+		++Stats.Splices;
+		++GlobalStats.Splices;
+	}
+	else
+	{
+		// Otherwise the previous path is no good to us and we need a whole new path.
+		Points.Reset();
+		if (!QueryPath(Querier, Start, Goal, Points))
+		{
+			Invalidate();
+			return nullptr;
+		}
+
+		++Stats.Misses;
+		++GlobalStats.Misses;
+	}
+
+	CachedPoints = Points;
+	CachedGoal = Goal;
+
+	FNavPathSharedPtr Path = MakeShared<FNavigationPath, ESPMode::ThreadSafe>(Points);
+	Path->MarkReady();
+
+	return Path;
+}
+
+/**
+ * Forgets the previous path so the next request does a full path query.
+ */
+void FAllyPathCache::Invalidate()
+{
+	CachedPoints.Reset();
+	CachedGoal = FVector::ZeroVector;
+}
+
+/**
+ * Returns how far the goal can move, in units, before a previous path is no longer reused as is.
+ */
+float FAllyPathCache::GetReuseTolerance()
+{
+	return CVarAllyPathCacheReuseTolerance.GetValueOnGameThread();
+}
+
+/**
+ * Queries a path from `Start` to `Goal` on the navmesh.
+ */
+bool FAllyPathCache::QueryPath(AController* Querier, const FVector& Start, const FVector& Goal, TArray<FVector>& OutPoints)
+{
+	if (Querier == nullptr) return false;
+
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(Querier->GetWorld());
+	if (NavSys == nullptr) return false;
+
+	const ANavigationData* NavData = NavSys->GetNavDataForProps(Querier->GetNavAgentPropertiesRef());
+	if (NavData == nullptr) return false;
+
+	FPathFindingQuery Query(Querier, *NavData, Start, Goal, UNavigationQueryFilter::GetQueryFilter(*NavData, Querier, nullptr));
+	FAllyAICounters::Increment(EAllyAICounter::PathQueries);
+	FPathFindingResult Result = NavSys->FindPathSync(Querier->GetNavAgentPropertiesRef(), Query);
+	if (!Result.IsSuccessful() || !Result.Path.IsValid()) return false;
+
+	OutPoints.Reset(Result.Path->GetPathPoints().Num());
+	for (const FNavPathPoint& PathPoint : Result.Path->GetPathPoints()) OutPoints.Add(PathPoint.Location);
+
+	return OutPoints.Num() > 1;
+}
+
+/**
+ * Finds the part of a path that is still ahead of `Start`.
+ */
+bool FAllyPathCache::GetPointsAhead(const TArray<FVector>& Points, const FVector& Start, TArray<FVector>& OutPoints)
+{
+	// Find the segment of the path that `Start` is closest to.
+	int32 ClosestSegment = INDEX_NONE;
+	float ClosestDistanceSquared = MAX_FLT;
+
+	for (int32 Index = 0; Index < Points.Num() - 1; ++Index)
+	{
+		const FVector ClosestPoint = FMath::ClosestPointOnSegment(Start, Points[Index], Points[Index + 1]);
+		const float DistanceSquared = FVector::DistSquared(Start, ClosestPoint);
+
+		if (DistanceSquared < ClosestDistanceSquared)
+		{
+			ClosestDistanceSquared = DistanceSquared;
+			ClosestSegment = Index;
+		}
+	}
+
+	// If the AllyCharacter has strayed too far from the path then it can't follow it.
+	if (ClosestSegment == INDEX_NONE || ClosestDistanceSquared > FMath::Square(CVarAllyPathCacheMaxDeviation.GetValueOnGameThread())) return false;
+
+	OutPoints.Reset(Points.Num() - ClosestSegment);
+	OutPoints.Add(Start);
+	for (int32 Index = ClosestSegment + 1; Index < Points.Num(); ++Index) OutPoints.Add(Points[Index]);
+
+	return true;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AI/Navigation/NavigationTypes.h"
+
+class AController;
+
+/**
+ * How many follow paths were reused, spliced, or queried from scratch.
+ */
+struct FOLLOWLEADAI_API FAllyPathCacheStats
+{
+	// The number of times the previous path was reused as is.
+	int32 Hits = 0;
+
+	// The number of times the previous path was kept and only its tail was queried.
+	int32 Splices = 0;
+
+	// The number of times a full path had to be queried.
+	int32 Misses = 0;
+
+	/**
+	 * Returns the fraction of path requests that didn't need a full path query.
+	 */
+	float GetHitRate() const
+	{
+		const int32 Total = Hits + Splices + Misses;
+		return Total > 0 ? float(Hits + Splices) / float(Total) : 0.f;
+	}
+};
+
+/**
+ * Keeps the last path an AllyCharacter used to follow the PlayerCharacter so that
+ * the next repath can reuse it when the PlayerCharacter has barely moved.
+ */
+class FOLLOWLEADAI_API FAllyPathCache
+{
+public:
+	/**
+	 * Returns a path from `Start` to `Goal`, reusing or splicing the previous path
+	 * when the goal hasn't moved far enough to need a full path query.
+	 *
+	 * @param Querier The AllyAIController asking for the path.
+	 * @param Start Where the path should start, usually the AllyCharacter's location.
+	 * @param Goal Where the path should end, usually the PlayerCharacter's location.
+	 *
+	 * @return The path to follow, or an invalid path if no path could be found.
+	 */
+	FNavPathSharedPtr FindPath(AController* Querier, const FVector& Start, const FVector& Goal);
+
+	/**
+	 * Forgets the previous path so the next request does a full path query.
+	 */
+	void Invalidate();
+
+	/**
+	 * Returns how far the goal can move, in units, before a previous path is no longer reused as is.
+	 */
+	static float GetReuseTolerance();
+
+	/**
+	 * Finds the part of a path that is still ahead of `Start`.
+	 *
+	 * @param Points The points of the path.
+	 * @param Start The location to start from, which should be somewhere along the path.
+	 * @param OutPoints The remaining points, starting with `Start`.
+	 *
+	 * @return Whether `Start` was close enough to the path to follow it or not.
+	 */
+	static bool GetPointsAhead(const TArray<FVector>& Points, const FVector& Start, TArray<FVector>& OutPoints);
+
+	/**
+	 * Returns the stats of this path cache.
+	 */
+	const FAllyPathCacheStats& GetStats() const { return Stats; }
+
+	/**
+	 * Returns the stats of every path cache combined.
+	 */
+	static const FAllyPathCacheStats& GetGlobalStats() { return GlobalStats; }
+
+	/**
+	 * Resets the stats of every path cache combined.
+	 */
+	static void ResetGlobalStats() { GlobalStats = FAllyPathCacheStats(); }
+
+private:
+	// The points of the previous path.
+	TArray<FVector> CachedPoints;
+
+	// The goal that the previous path was found for.
+	FVector CachedGoal = FVector::ZeroVector;
+
+	// The stats of this path cache.
+	FAllyPathCacheStats Stats;
+
+	// The stats of every path cache combined.
+	static FAllyPathCacheStats GlobalStats;
+
+	/**
+	 * Queries a path from `Start` to `Goal` on the navmesh.
+	 *
+	 * @param OutPoints The points of the path that was found.
+	 *
+	 * @return Whether a path was found or not.
+	 */
+	static bool QueryPath(AController* Querier, const FVector& Start, const FVector& Goal, TArray<FVector>& OutPoints);
+};
@@ -0,0 +1,154 @@
+#include "AllyPoolSubsystem.h"
+#include "AllyAIController.h"
+#include "AllyCharacter.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "HAL/IConsoleManager.h"
+#include "Kismet/GameplayStatics.h"
+#include "UObject/UObjectIterator.h"
+
+// Logs how many AllyCharacters are waiting in the pool of every world.
+static FAutoConsoleCommand AllyPoolStatsCommand(
+	TEXT("ally.Pool.Stats"),
+	TEXT("Logs how many allies are waiting in the pool and how many had to be spawned because it was empty."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		for (TObjectIterator<UAllyPoolSubsystem> It; It; ++It)
+		{
+			if (It->HasAnyFlags(RF_ClassDefaultObject) || It->GetWorld() == nullptr) continue;
+
+			UE_LOG(LogTemp, Display, TEXT("Ally pool in %s: %d pooled, %d spawned on demand"), *It->GetWorld()->GetName(), It->GetNumPooled(), It->GetNumSpawnedOnDemand());
+		}
+	}));
+
+/**
+ * Called when the world the AllyPoolSubsystem belongs to is torn down.
+ */
+void UAllyPoolSubsystem::Deinitialize()
+{
+	PooledAllies.Reset();
+
+	Super::Deinitialize();
+}
+
+/**
+ * Spawns AllyCharacters into the pool ahead of time.
+ *
+ * @param Count The number of AllyCharacters the pool should hold afterwards.
+ */
+void UAllyPoolSubsystem::Prewarm(int32 Count)
+{
+	PooledAllies.Reserve(Count);
+
+	while (PooledAllies.Num() < Count)
+	{
+		AAllyCharacter* Ally = SpawnAlly(FTransform::Identity);
+		if (Ally == nullptr) return;
+
+		// Pooled allies are created out of play. Their AllyAIController registered with
+		// the AllyCrowdSubsystem when it started so take it straight back out again.
+		AAllyAIController* Controller = Cast<AAllyAIController>(Ally->GetController());
+		if (Controller != nullptr) Controller->DeactivateAlly();
+
+		SetAllyInPlay(Ally, false);
+		PooledAllies.Add(Ally);
+	}
+}
+
+/**
+ * Takes an AllyCharacter out of the pool, or spawns one if the pool is empty, and
+ * starts it following a PlayerCharacter.
+ */
+AAllyCharacter* UAllyPoolSubsystem::AcquireAlly(APlayerCharacter* PlayerCharacter, const FTransform& Transform, TFunction<void(AAllyCharacter*)> Configure)
+{
+	AAllyCharacter* Ally = nullptr;
+
+	// Skip over any pooled allies that were destroyed by something else. They stay in the
+	// pool, pending kill, until the next garbage collection clears them out.
+	while (!IsValid(Ally) && PooledAllies.Num() > 0) Ally = PooledAllies.Pop(false);
+
+	if (!IsValid(Ally))
+	{
+		Ally = SpawnAlly(Transform);
+		if (Ally == nullptr) return nullptr;
+
+		++NumSpawnedOnDemand;
+	}
+	else
+	{
+		Ally->SetActorTransform(Transform, false, nullptr, ETeleportType::ResetPhysics);
+		SetAllyInPlay(Ally, true);
+	}
+
+	// The AllyAIController is kept with its AllyCharacter in the pool but spawn a new one
+	// if it was destroyed.
+	AAllyAIController* Controller = Cast<AAllyAIController>(Ally->GetController());
+	if (Controller == nullptr)
+	{
+		Ally->SpawnDefaultController();
+		Controller = Cast<AAllyAIController>(Ally->GetController());
+	}
+
+	if (Configure) Configure(Ally);
+
+	// Configuring may have picked a different variant, tuning, or way of arriving at
+	// waypoints than the AllyCharacter had.
+	Ally->ApplyVariant();
+	Ally->ApplyTuning();
+	Ally->ApplyWaypointSpatialHash();
+
+	if (Controller != nullptr) Controller->ActivateAlly(PlayerCharacter);
+
+	return Ally;
+}
+
+/**
+ * Stops an AllyCharacter and puts it back in the pool.
+ *
+ * @param Ally The AllyCharacter to put back.
+ */
+void UAllyPoolSubsystem::ReleaseAlly(AAllyCharacter* Ally)
+{
+	if (Ally == nullptr || Ally->IsPendingKill() || PooledAllies.Contains(Ally)) return;
+
+	AAllyAIController* Controller = Cast<AAllyAIController>(Ally->GetController());
+	if (Controller != nullptr) Controller->DeactivateAlly();
+	else Ally->ResetAllyState();
+
+	SetAllyInPlay(Ally, false);
+	PooledAllies.Add(Ally);
+}
+
+/**
+ * Spawns a new AllyCharacter with its AllyAIController, without a PlayerCharacter.
+ */
+AAllyCharacter* UAllyPoolSubsystem::SpawnAlly(const FTransform& Transform)
+{
+	UWorld* World = GetWorld();
+	if (World == nullptr) return nullptr;
+
+	AAllyCharacter* Ally = World->SpawnActorDeferred<AAllyCharacter>(AllyClass != nullptr ? *AllyClass : AAllyCharacter::StaticClass(), Transform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+	if (Ally == nullptr) return nullptr;
+
+	Ally->AIControllerClass = AAllyAIController::StaticClass();
+	Ally->AutoPossessAI = EAutoPossessAI::Spawned;
+
+	UGameplayStatics::FinishSpawningActor(Ally, Transform);
+
+	return Ally;
+}
+
+/**
+ * Shows or hides an AllyCharacter and turns its collision and ticking on or off.
+ */
+void UAllyPoolSubsystem::SetAllyInPlay(AAllyCharacter* Ally, bool bInPlay)
+{
+	Ally->SetActorHiddenInGame(!bInPlay);
+	Ally->SetActorEnableCollision(bInPlay);
+	Ally->SetActorTickEnabled(bInPlay);
+
+	// The movement and animation are what cost the most per frame so make sure they stop too.
+	if (Ally->GetCharacterMovement() != nullptr) Ally->GetCharacterMovement()->SetComponentTickEnabled(bInPlay);
+	if (Ally->GetMesh() != nullptr) Ally->GetMesh()->SetComponentTickEnabled(bInPlay);
+}
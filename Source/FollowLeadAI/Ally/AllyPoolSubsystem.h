@@ -0,0 +1,91 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "AllyPoolSubsystem.generated.h"
+
+class AAllyCharacter;
+class APlayerCharacter;
+
+/**
+ * The AllyPoolSubsystem keeps AllyCharacters, together with their AllyAIControllers,
+ * out of play so that allies that come and go in waves can be reused instead of
+ * paying for a full spawn and destroy every time.
+ */
+UCLASS()
+class FOLLOWLEADAI_API UAllyPoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/**
+	 * Called when the world the AllyPoolSubsystem belongs to is torn down.
+	 */
+	virtual void Deinitialize() override;
+
+	/**
+	 * Spawns AllyCharacters into the pool ahead of time, for example while a level loads.
+	 *
+	 * @param Count The number of AllyCharacters the pool should hold afterwards.
+	 */
+	void Prewarm(int32 Count);
+
+	/**
+	 * Takes an AllyCharacter out of the pool, or spawns one if the pool is empty, and
+	 * starts it following a PlayerCharacter.
+	 *
+	 * @param PlayerCharacter The PlayerCharacter the AllyCharacter should follow.
+	 * @param Transform Where to put the AllyCharacter.
+	 * @param Configure Called to set the AllyCharacter up before it starts following.
+	 *
+	 * @return The AllyCharacter, or nullptr if one couldn't be spawned.
+	 */
+	AAllyCharacter* AcquireAlly(APlayerCharacter* PlayerCharacter, const FTransform& Transform, TFunction<void(AAllyCharacter*)> Configure = nullptr);
+
+	/**
+	 * Stops an AllyCharacter and puts it back in the pool.
+	 *
+	 * @param Ally The AllyCharacter to put back.
+	 */
+	void ReleaseAlly(AAllyCharacter* Ally);
+
+	/**
+	 * Sets the class of the AllyCharacters that the pool spawns. Call it before prewarming
+	 * since AllyCharacters already in the pool keep their class.
+	 *
+	 * @param InAllyClass The class to spawn, such as AAllyCompactCharacter.
+	 */
+	void SetAllyClass(TSubclassOf<AAllyCharacter> InAllyClass) { AllyClass = InAllyClass; }
+
+	/**
+	 * Returns the number of AllyCharacters waiting in the pool.
+	 */
+	int32 GetNumPooled() const { return PooledAllies.Num(); }
+
+	/**
+	 * Returns the number of AllyCharacters that had to be spawned because the pool was empty.
+	 */
+	int32 GetNumSpawnedOnDemand() const { return NumSpawnedOnDemand; }
+
+private:
+	// The AllyCharacters that are out of play and ready to be reused.
+	UPROPERTY()
+	TArray<AAllyCharacter*> PooledAllies;
+
+	// The class of the AllyCharacters that the pool spawns, or AAllyCharacter if not set.
+	UPROPERTY()
+	TSubclassOf<AAllyCharacter> AllyClass;
+
+	// The number of AllyCharacters that had to be spawned because the pool was empty.
+	int32 NumSpawnedOnDemand = 0;
+
+	/**
+	 * Spawns a new AllyCharacter with its AllyAIController, without a PlayerCharacter.
+	 */
+	AAllyCharacter* SpawnAlly(const FTransform& Transform);
+
+	/**
+	 * Shows or hides an AllyCharacter and turns its collision and ticking on or off.
+	 */
+	static void SetAllyInPlay(AAllyCharacter* Ally, bool bInPlay);
+};
@@ -0,0 +1,219 @@
+#include "AllyReplicatedState.h"
+#include "AllyCharacter.h"
+#include "../WaypointActor.h"
+#include "../WaypointRegistrySubsystem.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "UObject/UObjectIterator.h"
+
+int64 FAllyNetStats::TotalStateBits = 0;
+int64 FAllyNetStats::WindowStateBits = 0;
+float FAllyNetStats::LastStateBitsPerSecond = 0.f;
+FAllyRateWindow FAllyNetStats::Window(1.0);
+
+// The number of flag bits at the start of every serialized FAllyReplicatedState.
+static constexpr int32 AllyReplicatedStateFlagBits = 4;
+
+// Logs how much ally state the server is sending, or resets the stats with `ally.Net.Stats reset`.
+static FAutoConsoleCommand AllyNetStatsCommand(
+	TEXT("ally.Net.Stats"),
+	TEXT("Logs how many bits of ally state the server sends per second in total and per replicated ally. Pass 'reset' to reset the stats."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+		{
+			FAllyNetStats::Reset();
+			return;
+		}
+
+		// Only the allies that a server is actually replicating count towards the average.
+		int32 NumReplicatedAllies = 0;
+		for (TObjectIterator<AAllyCharacter> It; It; ++It)
+		{
+			if (It->HasAnyFlags(RF_ClassDefaultObject) || It->IsPendingKill() || It->IsHidden()) continue;
+
+			const UWorld* World = It->GetWorld();
+			if (World == nullptr || World->GetNetMode() == NM_Standalone || World->GetNetMode() == NM_Client) continue;
+
+			++NumReplicatedAllies;
+		}
+
+		const float BitsPerSecond = FAllyNetStats::GetStateBitsPerSecond();
+		const float BytesPerAlly = NumReplicatedAllies > 0 ? BitsPerSecond / 8.f / NumReplicatedAllies : 0.f;
+
+		UE_LOG(LogTemp, Display, TEXT("Ally net: %d replicated allies, %.0f state bits per second, %.2f bytes per second per ally, %lld bits total"),
+			NumReplicatedAllies, BitsPerSecond, BytesPerAlly, FAllyNetStats::GetTotalStateBits());
+	}));
+
+/**
+ * Returns how many bytes `FArchive::SerializeIntPacked` writes for a value, which
+ * stores seven bits of the value in each byte.
+ */
+static int32 GetPackedIntBytes(uint32 Value)
+{
+	int32 NumBytes = 1;
+	while ((Value >>= 7) > 0) ++NumBytes;
+
+	return NumBytes;
+}
+
+/**
+ * Packs the state of an AllyCharacter.
+ *
+ * @param AllyCharacter The AllyCharacter to pack.
+ * @param WaypointRegistry The registry used to turn WaypointActors into indices.
+ */
+FAllyReplicatedState FAllyReplicatedState::Pack(const AAllyCharacter& AllyCharacter, const UWaypointRegistrySubsystem* WaypointRegistry)
+{
+	FAllyReplicatedState Packed;
+	Packed.bIsLeading = AllyCharacter.State == AllyStates::LEAD;
+	Packed.bIsSprinting = AllyCharacter.bIsSprinting;
+
+	// The rest of the state only means something while leading, and leaving it at its
+	// defaults while following means it doesn't make the state look changed.
+	if (!Packed.bIsLeading) return Packed;
+
+	Packed.bIsAtCurrentWaypoint = AllyCharacter.bIsAtCurrentWaypoint;
+	Packed.bShouldWaitForPlayer = AllyCharacter.bShouldWaitForPlayerWhenLeading;
+
+	const auto Quantize = [WaypointRegistry](const AWaypointActor* Waypoint) -> uint16
+	{
+		if (Waypoint == nullptr || WaypointRegistry == nullptr) return NoWaypoint;
+
+		const int32 Index = WaypointRegistry->FindWaypointIndex(Waypoint->WaypointNumber);
+		return Index != INDEX_NONE && Index < MAX_uint16 ? static_cast<uint16>(Index + 1) : NoWaypoint;
+	};
+
+	Packed.CurrentWaypoint = Quantize(AllyCharacter.CurrentWaypoint);
+	Packed.EndWaypoint = Quantize(AllyCharacter.EndWaypoint);
+
+	return Packed;
+}
+
+/**
+ * Writes the packed state back to an AllyCharacter.
+ *
+ * @param AllyCharacter The AllyCharacter to write to.
+ * @param WaypointRegistry The registry used to turn indices back into WaypointActors.
+ */
+void FAllyReplicatedState::Unpack(AAllyCharacter& AllyCharacter, const UWaypointRegistrySubsystem* WaypointRegistry) const
+{
+	AllyCharacter.State = bIsLeading ? AllyStates::LEAD : AllyStates::FOLLOW;
+	AllyCharacter.bIsAtCurrentWaypoint = bIsAtCurrentWaypoint;
+	AllyCharacter.bShouldWaitForPlayerWhenLeading = bShouldWaitForPlayer;
+
+	// The server already counted the sprint toggle, so the client only copies it.
+	if (bIsSprinting != AllyCharacter.bIsSprinting) AllyCharacter.SetSprinting(bIsSprinting);
+
+	const auto Dequantize = [WaypointRegistry](uint16 Waypoint) -> AWaypointActor*
+	{
+		if (Waypoint == NoWaypoint || WaypointRegistry == nullptr) return nullptr;
+
+		const TArray<AWaypointActor*>& Waypoints = WaypointRegistry->GetWaypoints();
+		return Waypoints.IsValidIndex(Waypoint - 1) ? Waypoints[Waypoint - 1] : nullptr;
+	};
+
+	AllyCharacter.CurrentWaypoint = Dequantize(CurrentWaypoint);
+	AllyCharacter.EndWaypoint = Dequantize(EndWaypoint);
+}
+
+/**
+ * Reads or writes the packed state to the network.
+ */
+bool FAllyReplicatedState::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	uint8 Flags = 0;
+	if (Ar.IsSaving())
+	{
+		Flags = static_cast<uint8>(bIsLeading | (bIsSprinting << 1) | (bIsAtCurrentWaypoint << 2) | (bShouldWaitForPlayer << 3));
+		FAllyNetStats::AddStateBits(GetNumSerializedBits());
+	}
+
+	Ar.SerializeBits(&Flags, AllyReplicatedStateFlagBits);
+
+	if (Ar.IsLoading())
+	{
+		bIsLeading = Flags & 1;
+		bIsSprinting = (Flags >> 1) & 1;
+		bIsAtCurrentWaypoint = (Flags >> 2) & 1;
+		bShouldWaitForPlayer = (Flags >> 3) & 1;
+	}
+
+	// Waypoint indices are small so they nearly always fit in a single packed byte.
+	uint32 PackedCurrentWaypoint = CurrentWaypoint;
+	uint32 PackedEndWaypoint = EndWaypoint;
+	if (bIsLeading)
+	{
+		Ar.SerializeIntPacked(PackedCurrentWaypoint);
+		Ar.SerializeIntPacked(PackedEndWaypoint);
+	}
+	else
+	{
+		PackedCurrentWaypoint = NoWaypoint;
+		PackedEndWaypoint = NoWaypoint;
+	}
+
+	if (Ar.IsLoading())
+	{
+		CurrentWaypoint = static_cast<uint16>(FMath::Min<uint32>(PackedCurrentWaypoint, MAX_uint16));
+		EndWaypoint = static_cast<uint16>(FMath::Min<uint32>(PackedEndWaypoint, MAX_uint16));
+	}
+
+	bOutSuccess = !Ar.IsError();
+	return true;
+}
+
+/**
+ * Returns how many bits `NetSerialize` writes for this state.
+ */
+int32 FAllyReplicatedState::GetNumSerializedBits() const
+{
+	int32 NumBits = AllyReplicatedStateFlagBits;
+	if (bIsLeading) NumBits += (GetPackedIntBytes(CurrentWaypoint) + GetPackedIntBytes(EndWaypoint)) * 8;
+
+	return NumBits;
+}
+
+/**
+ * Counts the bits of one serialized FAllyReplicatedState.
+ */
+void FAllyNetStats::AddStateBits(int32 NumBits)
+{
+	RollWindow();
+
+	TotalStateBits += NumBits;
+	WindowStateBits += NumBits;
+}
+
+/**
+ * Returns how many bits of ally state were sent during the last full second.
+ */
+float FAllyNetStats::GetStateBitsPerSecond()
+{
+	RollWindow();
+
+	return LastStateBitsPerSecond;
+}
+
+/**
+ * Sets the stats back to zero.
+ */
+void FAllyNetStats::Reset()
+{
+	TotalStateBits = 0;
+	WindowStateBits = 0;
+	LastStateBitsPerSecond = 0.f;
+	Window.Reset();
+}
+
+/**
+ * Moves on to a new window once the current one is a second old.
+ */
+void FAllyNetStats::RollWindow()
+{
+	double RateScale = 0.0;
+	if (!Window.Roll(RateScale)) return;
+
+	LastStateBitsPerSecond = static_cast<float>(WindowStateBits * RateScale);
+	WindowStateBits = 0;
+}
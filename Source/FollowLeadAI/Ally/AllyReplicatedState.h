@@ -0,0 +1,144 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AllyStats.h"
+#include "Engine/NetSerialization.h"
+#include "AllyReplicatedState.generated.h"
+
+class AAllyCharacter;
+class UWaypointRegistrySubsystem;
+
+/**
+ * The part of an AllyCharacter's state that clients need to animate and show it, packed
+ * into as few bits as possible. The flags take one bit each and the WaypointActors are
+ * sent as their index in the WaypointRegistrySubsystem, which every machine builds the
+ * same way from the level, instead of as object references. The waypoints are only sent
+ * while the AllyCharacter is leading since nothing reads them while it is following.
+ */
+USTRUCT()
+struct FOLLOWLEADAI_API FAllyReplicatedState
+{
+	GENERATED_BODY()
+
+	// The value of `CurrentWaypoint` and `EndWaypoint` when there isn't a WaypointActor.
+	static constexpr uint16 NoWaypoint = 0;
+
+	// Indicates whether the AllyCharacter is in the LEAD state instead of the FOLLOW state.
+	uint8 bIsLeading : 1;
+
+	// Indicates whether the AllyCharacter is sprinting or not.
+	uint8 bIsSprinting : 1;
+
+	// Indicates whether the AllyCharacter has arrived at its `CurrentWaypoint`.
+	uint8 bIsAtCurrentWaypoint : 1;
+
+	// Indicates whether the AllyCharacter waits for the PlayerCharacter when leading.
+	uint8 bShouldWaitForPlayer : 1;
+
+	// The index of the `CurrentWaypoint` in the WaypointRegistrySubsystem plus one.
+	uint16 CurrentWaypoint = NoWaypoint;
+
+	// The index of the `EndWaypoint` in the WaypointRegistrySubsystem plus one.
+	uint16 EndWaypoint = NoWaypoint;
+
+	FAllyReplicatedState()
+		: bIsLeading(false)
+		, bIsSprinting(false)
+		, bIsAtCurrentWaypoint(false)
+		, bShouldWaitForPlayer(false)
+	{
+	}
+
+	/**
+	 * Packs the state of an AllyCharacter.
+	 *
+	 * @param AllyCharacter The AllyCharacter to pack.
+	 * @param WaypointRegistry The registry used to turn WaypointActors into indices.
+	 */
+	static FAllyReplicatedState Pack(const AAllyCharacter& AllyCharacter, const UWaypointRegistrySubsystem* WaypointRegistry);
+
+	/**
+	 * Writes the packed state back to an AllyCharacter.
+	 *
+	 * @param AllyCharacter The AllyCharacter to write to.
+	 * @param WaypointRegistry The registry used to turn indices back into WaypointActors.
+	 */
+	void Unpack(AAllyCharacter& AllyCharacter, const UWaypointRegistrySubsystem* WaypointRegistry) const;
+
+	/**
+	 * Reads or writes the packed state to the network.
+	 */
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+
+	/**
+	 * Returns how many bits `NetSerialize` writes for this state.
+	 */
+	int32 GetNumSerializedBits() const;
+
+	bool operator==(const FAllyReplicatedState& Other) const
+	{
+		return bIsLeading == Other.bIsLeading
+			&& bIsSprinting == Other.bIsSprinting
+			&& bIsAtCurrentWaypoint == Other.bIsAtCurrentWaypoint
+			&& bShouldWaitForPlayer == Other.bShouldWaitForPlayer
+			&& CurrentWaypoint == Other.CurrentWaypoint
+			&& EndWaypoint == Other.EndWaypoint;
+	}
+
+	bool operator!=(const FAllyReplicatedState& Other) const { return !(*this == Other); }
+};
+
+template<>
+struct TStructOpsTypeTraits<FAllyReplicatedState> : public TStructOpsTypeTraitsBase2<FAllyReplicatedState>
+{
+	enum
+	{
+		WithNetSerializer = true,
+		WithIdenticalViaEquality = true,
+	};
+};
+
+/**
+ * Counts how many bits of ally state the server sends so that the bandwidth used per
+ * AllyCharacter can be read with `ally.Net.Stats`. Only touched on the game thread.
+ */
+struct FOLLOWLEADAI_API FAllyNetStats
+{
+	/**
+	 * Counts the bits of one serialized FAllyReplicatedState.
+	 */
+	static void AddStateBits(int32 NumBits);
+
+	/**
+	 * Returns how many bits of ally state were sent during the last full second.
+	 */
+	static float GetStateBitsPerSecond();
+
+	/**
+	 * Returns how many bits of ally state have been sent since the stats were reset.
+	 */
+	static int64 GetTotalStateBits() { return TotalStateBits; }
+
+	/**
+	 * Sets the stats back to zero.
+	 */
+	static void Reset();
+
+private:
+	// The number of bits sent since the stats were reset.
+	static int64 TotalStateBits;
+
+	// The number of bits sent since `Window` started.
+	static int64 WindowStateBits;
+
+	// The number of bits per second during the last full window.
+	static float LastStateBitsPerSecond;
+
+	// The current one second window.
+	static FAllyRateWindow Window;
+
+	/**
+	 * Moves on to a new window once the current one is a second old.
+	 */
+	static void RollWindow();
+};
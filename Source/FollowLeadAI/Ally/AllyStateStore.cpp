@@ -0,0 +1,176 @@
+#include "AllyStateStore.h"
+#include "AllyStats.h"
+#include "Math/VectorRegister.h"
+
+/**
+ * Adds a new ally to the end of the store.
+ *
+ * @return The index of the new ally.
+ */
+int32 FAllyStateStore::Add()
+{
+	const int32 Index = NumAllies;
+	ResizePadded(NumAllies + 1);
+
+	return Index;
+}
+
+/**
+ * Removes an ally by moving the last ally into its slot.
+ *
+ * @param Index The index of the ally to remove.
+ */
+void FAllyStateStore::RemoveAtSwap(int32 Index)
+{
+	if (Index < 0 || Index >= NumAllies) return;
+
+	const int32 Last = NumAllies - 1;
+	if (Index != Last)
+	{
+		AllyX[Index] = AllyX[Last];
+		AllyY[Index] = AllyY[Last];
+		AllyZ[Index] = AllyZ[Last];
+		PlayerX[Index] = PlayerX[Last];
+		PlayerY[Index] = PlayerY[Last];
+		PlayerZ[Index] = PlayerZ[Last];
+		SprintDistancesSquared[Index] = SprintDistancesSquared[Last];
+		SprintExitDistancesSquared[Index] = SprintExitDistancesSquared[Last];
+		LeadWaitDistancesSquared[Index] = LeadWaitDistancesSquared[Last];
+		DistancesSquared[Index] = DistancesSquared[Last];
+		States[Index] = States[Last];
+		Decisions[Index] = Decisions[Last];
+	}
+
+	ResizePadded(Last);
+}
+
+/**
+ * Removes every ally from the store.
+ */
+void FAllyStateStore::Reset()
+{
+	ResizePadded(0);
+}
+
+/**
+ * Copies the state of a single ally into the store.
+ */
+void FAllyStateStore::SetAlly(int32 Index, const FVector& AllyLocation, const FVector& PlayerLocation, float SprintDistance, float SprintExitDistance, float LeadWaitDistance, uint8 StateBits)
+{
+	AllyX[Index] = AllyLocation.X;
+	AllyY[Index] = AllyLocation.Y;
+	AllyZ[Index] = AllyLocation.Z;
+	PlayerX[Index] = PlayerLocation.X;
+	PlayerY[Index] = PlayerLocation.Y;
+	PlayerZ[Index] = PlayerLocation.Z;
+	SprintDistancesSquared[Index] = FMath::Square(SprintDistance);
+	SprintExitDistancesSquared[Index] = FMath::Square(FMath::Min(SprintExitDistance, SprintDistance));
+	LeadWaitDistancesSquared[Index] = FMath::Square(LeadWaitDistance);
+	States[Index] = StateBits;
+}
+
+/**
+ * Makes the follow, sprint, and lead-wait decisions for every ally in the store.
+ */
+void FAllyStateStore::Evaluate()
+{
+	ALLY_AI_SCOPE(STAT_AllyCrowdEvaluate);
+
+	Evaluate(0, NumAllies);
+}
+
+/**
+ * Makes the follow, sprint, and lead-wait decisions for a range of allies.
+ *
+ * @param StartIndex The index of the first ally, which must be a multiple of four.
+ * @param EndIndex The index after the last ally.
+ */
+void FAllyStateStore::Evaluate(int32 StartIndex, int32 EndIndex)
+{
+	check(StartIndex % 4 == 0);
+
+	// The last batch of the range is evaluated whole, padding lanes included.
+	const int32 EndPadded = FMath::Min(Align(EndIndex, 4), AllyX.Num());
+
+	for (int32 Index = StartIndex; Index < EndPadded; Index += 4)
+	{
+		// Get the squared distance from four allies to their PlayerCharacters at
+		// once. Comparing squared distances against squared thresholds gives the
+		// same answer as `GetDistanceTo` without needing a square root.
+		const VectorRegister DeltaX = VectorSubtract(VectorLoadAligned(&AllyX[Index]), VectorLoadAligned(&PlayerX[Index]));
+		const VectorRegister DeltaY = VectorSubtract(VectorLoadAligned(&AllyY[Index]), VectorLoadAligned(&PlayerY[Index]));
+		const VectorRegister DeltaZ = VectorSubtract(VectorLoadAligned(&AllyZ[Index]), VectorLoadAligned(&PlayerZ[Index]));
+
+		VectorRegister DistanceSquared = VectorMultiply(DeltaX, DeltaX);
+		DistanceSquared = VectorMultiplyAdd(DeltaY, DeltaY, DistanceSquared);
+		DistanceSquared = VectorMultiplyAdd(DeltaZ, DeltaZ, DistanceSquared);
+		VectorStoreAligned(DistanceSquared, &DistancesSquared[Index]);
+
+		const int32 SprintMask = VectorMaskBits(VectorCompareGE(DistanceSquared, VectorLoadAligned(&SprintDistancesSquared[Index])));
+		const int32 KeepSprintingMask = VectorMaskBits(VectorCompareGE(DistanceSquared, VectorLoadAligned(&SprintExitDistancesSquared[Index])));
+		const int32 WaitMask = VectorMaskBits(VectorCompareGE(DistanceSquared, VectorLoadAligned(&LeadWaitDistancesSquared[Index])));
+
+		for (int32 Lane = 0; Lane < 4; ++Lane)
+		{
+			const uint8 State = States[Index + Lane];
+
+			// Allies without a PlayerCharacter have nothing to compare against so
+			// they never sprint or wait.
+			if ((State & State_HasPlayer) == 0)
+			{
+				Decisions[Index + Lane] = Decision_None;
+				continue;
+			}
+
+			// An ally that is already sprinting keeps going until it is inside the exit
+			// distance, and one that isn't only starts once it is past the sprint distance.
+			const int32 ActiveSprintMask = (State & State_Sprinting) ? KeepSprintingMask : SprintMask;
+
+			uint8 Decision = Decision_None;
+			if (ActiveSprintMask & (1 << Lane)) Decision |= Decision_Sprint;
+			if ((WaitMask & (1 << Lane)) && (State & State_ShouldWaitWhenLeading)) Decision |= Decision_WaitForPlayer;
+
+			Decisions[Index + Lane] = Decision;
+		}
+	}
+}
+
+/**
+ * Updates the sprint bit of an ally after its sprint decision was written back.
+ */
+void FAllyStateStore::SetSprinting(int32 Index, bool bIsSprinting)
+{
+	if (bIsSprinting) States[Index] |= State_Sprinting;
+	else States[Index] &= ~State_Sprinting;
+}
+
+/**
+ * Resizes every array to hold `NewNum` allies, padded up to a multiple of four.
+ */
+void FAllyStateStore::ResizePadded(int32 NewNum)
+{
+	NumAllies = NewNum;
+
+	const int32 NumPadded = Align(NewNum, 4);
+
+	AllyX.SetNumZeroed(NumPadded, false);
+	AllyY.SetNumZeroed(NumPadded, false);
+	AllyZ.SetNumZeroed(NumPadded, false);
+	PlayerX.SetNumZeroed(NumPadded, false);
+	PlayerY.SetNumZeroed(NumPadded, false);
+	PlayerZ.SetNumZeroed(NumPadded, false);
+	SprintDistancesSquared.SetNumZeroed(NumPadded, false);
+	SprintExitDistancesSquared.SetNumZeroed(NumPadded, false);
+	LeadWaitDistancesSquared.SetNumZeroed(NumPadded, false);
+	DistancesSquared.SetNumZeroed(NumPadded, false);
+	States.SetNumZeroed(NumPadded, false);
+	Decisions.SetNumZeroed(NumPadded, false);
+
+	// Clear the padding lanes so that an ally removed from the end doesn't leave
+	// stale state behind in a lane that gets evaluated with the rest of its batch.
+	for (int32 Index = NewNum; Index < NumPadded; ++Index)
+	{
+		States[Index] = State_None;
+		Decisions[Index] = Decision_None;
+	}
+}
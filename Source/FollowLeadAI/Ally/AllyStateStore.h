@@ -0,0 +1,155 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * A packed, structure-of-arrays copy of the state that the ally decisions need.
+ * The AllyCrowdSubsystem syncs it from the AllyCharacters once per frame and then
+ * evaluates the follow, sprint, and lead-wait decisions for every ally at once so
+ * that the decisions are made over contiguous memory, four allies at a time.
+ */
+struct FOLLOWLEADAI_API FAllyStateStore
+{
+public:
+	// The bits describing the state of an ally at the time it was synced.
+	enum EStateBits : uint8
+	{
+		State_None						= 0,
+		State_Lead						= 1 << 0,
+		State_Sprinting					= 1 << 1,
+		State_ShouldWaitWhenLeading		= 1 << 2,
+		State_HasPlayer					= 1 << 3,
+	};
+
+	// The bits describing what an ally should be doing after an evaluation.
+	enum EDecisionBits : uint8
+	{
+		Decision_None			= 0,
+		Decision_Sprint			= 1 << 0,
+		Decision_WaitForPlayer	= 1 << 1,
+	};
+
+public:
+	/**
+	 * Adds a new ally to the end of the store.
+	 *
+	 * @return The index of the new ally.
+	 */
+	int32 Add();
+
+	/**
+	 * Removes an ally by moving the last ally into its slot, which matches how
+	 * the AllyCrowdSubsystem removes allies from its own arrays.
+	 *
+	 * @param Index The index of the ally to remove.
+	 */
+	void RemoveAtSwap(int32 Index);
+
+	/**
+	 * Removes every ally from the store.
+	 */
+	void Reset();
+
+	/**
+	 * Returns the number of allies in the store.
+	 */
+	int32 Num() const { return NumAllies; }
+
+	/**
+	 * Copies the state of a single ally into the store.
+	 *
+	 * @param Index The index of the ally.
+	 * @param AllyLocation The location of the AllyCharacter.
+	 * @param PlayerLocation The location of the PlayerCharacter the ally is following.
+	 * @param SprintDistance The distance from the PlayerCharacter at which the ally starts sprinting.
+	 * @param SprintExitDistance The distance from the PlayerCharacter at which a sprinting ally stops sprinting.
+	 * @param LeadWaitDistance The distance from the PlayerCharacter at which a leading ally waits.
+	 * @param StateBits The `EStateBits` of the ally.
+	 */
+	void SetAlly(int32 Index, const FVector& AllyLocation, const FVector& PlayerLocation, float SprintDistance, float SprintExitDistance, float LeadWaitDistance, uint8 StateBits);
+
+	/**
+	 * Makes the follow, sprint, and lead-wait decisions for every ally in the store.
+	 */
+	void Evaluate();
+
+	/**
+	 * Makes the follow, sprint, and lead-wait decisions for a range of allies. Ranges that
+	 * don't overlap only touch their own allies so they can be evaluated on different threads.
+	 *
+	 * @param StartIndex The index of the first ally, which must be a multiple of four.
+	 * @param EndIndex The index after the last ally.
+	 */
+	void Evaluate(int32 StartIndex, int32 EndIndex);
+
+	/**
+	 * Returns whether the ally was leading when it was last synced.
+	 */
+	bool IsLeading(int32 Index) const { return (States[Index] & State_Lead) != 0; }
+
+	/**
+	 * Returns whether the ally should be sprinting as of the last evaluation.
+	 */
+	bool WantsSprint(int32 Index) const { return (Decisions[Index] & Decision_Sprint) != 0; }
+
+	/**
+	 * Returns whether the ally's sprint decision differs from whether it is sprinting.
+	 */
+	bool IsSprintFlipped(int32 Index) const { return WantsSprint(Index) != ((States[Index] & State_Sprinting) != 0); }
+
+	/**
+	 * Returns whether a leading ally should wait for the PlayerCharacter to catch up.
+	 */
+	bool WantsWaitForPlayer(int32 Index) const { return (Decisions[Index] & Decision_WaitForPlayer) != 0; }
+
+	/**
+	 * Returns the squared distance between the ally and its PlayerCharacter as of
+	 * the last evaluation.
+	 */
+	float GetDistanceSquaredToPlayer(int32 Index) const { return DistancesSquared[Index]; }
+
+	/**
+	 * Updates the sprint bit of an ally after its sprint decision was written back
+	 * so that it doesn't get reported as flipped again before the next sync.
+	 */
+	void SetSprinting(int32 Index, bool bIsSprinting);
+
+private:
+	// The number of allies in the store. The arrays below are padded up to a
+	// multiple of four so the evaluation never has to handle a partial batch.
+	int32 NumAllies = 0;
+
+	// The location of each AllyCharacter, one array per component.
+	TArray<float, TAlignedHeapAllocator<16>> AllyX;
+	TArray<float, TAlignedHeapAllocator<16>> AllyY;
+	TArray<float, TAlignedHeapAllocator<16>> AllyZ;
+
+	// The location of the PlayerCharacter each ally is following, one array per component.
+	TArray<float, TAlignedHeapAllocator<16>> PlayerX;
+	TArray<float, TAlignedHeapAllocator<16>> PlayerY;
+	TArray<float, TAlignedHeapAllocator<16>> PlayerZ;
+
+	// The squared distances at which each ally starts sprinting.
+	TArray<float, TAlignedHeapAllocator<16>> SprintDistancesSquared;
+
+	// The squared distances at which each sprinting ally stops sprinting, which are closer
+	// than where it starts so that an ally near the threshold doesn't keep switching.
+	TArray<float, TAlignedHeapAllocator<16>> SprintExitDistancesSquared;
+
+	// The squared distances at which each leading ally waits for the PlayerCharacter.
+	TArray<float, TAlignedHeapAllocator<16>> LeadWaitDistancesSquared;
+
+	// The squared distance between each ally and its PlayerCharacter from the last evaluation.
+	TArray<float, TAlignedHeapAllocator<16>> DistancesSquared;
+
+	// The `EStateBits` of each ally.
+	TArray<uint8> States;
+
+	// The `EDecisionBits` of each ally from the last evaluation.
+	TArray<uint8> Decisions;
+
+	/**
+	 * Resizes every array to hold `NewNum` allies, padded up to a multiple of four.
+	 */
+	void ResizePadded(int32 NewNum);
+};
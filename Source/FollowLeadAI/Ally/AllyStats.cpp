@@ -0,0 +1,184 @@
+#include "AllyStats.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_STAT(STAT_AllyCrowdTick);
+DEFINE_STAT(STAT_AllyCrowdUpdateLODTiers);
+DEFINE_STAT(STAT_AllyCrowdSyncStateStore);
+DEFINE_STAT(STAT_AllyCrowdEvaluate);
+DEFINE_STAT(STAT_AllyCrowdWaypointArrivals);
+DEFINE_STAT(STAT_AllyCrowdSprintTask);
+DEFINE_STAT(STAT_AllyCrowdSendQueuedMoves);
+DEFINE_STAT(STAT_AllyCrowdReplicatedStates);
+DEFINE_STAT(STAT_AllyAssignmentTick);
+DEFINE_STAT(STAT_AllyEntityTick);
+DEFINE_STAT(STAT_AllyEntitySimulate);
+DEFINE_STAT(STAT_AllyOnMoveCompleted);
+DEFINE_STAT(STAT_AllyMoveToPlayerCharacter);
+DEFINE_STAT(STAT_AllyMoveToWaypoint);
+DEFINE_STAT(STAT_AllyOnPlayerMovingChanged);
+DEFINE_STAT(STAT_AllyMakeAllyLead);
+DEFINE_STAT(STAT_AllyOnComponentEnterBoxCollider);
+DEFINE_STAT(STAT_AllyPathCacheFindPath);
+DEFINE_STAT(STAT_AllyFollowGroupFindPath);
+
+DEFINE_STAT(STAT_AllyMoveRequests);
+DEFINE_STAT(STAT_AllyPathQueries);
+DEFINE_STAT(STAT_AllyStateTransitions);
+DEFINE_STAT(STAT_AllySprintToggles);
+DEFINE_STAT(STAT_AllyFailedMoves);
+
+int64 FAllyAICounters::Totals[static_cast<int32>(EAllyAICounter::Num)] = {};
+int32 FAllyAICounters::WindowCounts[static_cast<int32>(EAllyAICounter::Num)] = {};
+float FAllyAICounters::LastRates[static_cast<int32>(EAllyAICounter::Num)] = {};
+FAllyRateWindow FAllyAICounters::SecondWindow(1.0);
+int32 FAllyAICounters::MinuteWindowCounts[static_cast<int32>(EAllyAICounter::Num)] = {};
+float FAllyAICounters::LastMinuteRates[static_cast<int32>(EAllyAICounter::Num)] = {};
+FAllyRateWindow FAllyAICounters::MinuteWindow(60.0);
+
+// Logs the ally AI counters, or resets them with `ally.Stats reset`.
+static FAutoConsoleCommand AllyStatsCommand(
+	TEXT("ally.Stats"),
+	TEXT("Logs how many move requests, path queries, state transitions, sprint toggles, and failed moves the allies made in total, per second, and per minute. Pass 'reset' to reset the counters."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+		{
+			FAllyAICounters::Reset();
+			return;
+		}
+
+		for (int32 Index = 0; Index < static_cast<int32>(EAllyAICounter::Num); ++Index)
+		{
+			const EAllyAICounter Counter = static_cast<EAllyAICounter>(Index);
+			UE_LOG(LogTemp, Display, TEXT("Ally %s: %lld total, %.1f per second, %.1f per minute"), FAllyAICounters::GetName(Counter), FAllyAICounters::GetTotal(Counter), FAllyAICounters::GetPerSecond(Counter), FAllyAICounters::GetPerMinute(Counter));
+		}
+	}));
+
+/**
+ * Starts a new window if the current one is at least `Length` seconds old.
+ *
+ * @param OutRateScale What a count from the window that ended is multiplied by to get a rate per `Length` seconds.
+ */
+bool FAllyRateWindow::Roll(double& OutRateScale)
+{
+	const double NowSeconds = FPlatformTime::Seconds();
+	const double ElapsedSeconds = NowSeconds - StartSeconds;
+	if (ElapsedSeconds < Length) return false;
+
+	// A window that went on for longer than `Length`, because nothing was counted for a
+	// while, is still turned into a rate per `Length` seconds.
+	OutRateScale = Length / ElapsedSeconds;
+	StartSeconds = NowSeconds;
+
+	return true;
+}
+
+/**
+ * Counts one of an event.
+ */
+void FAllyAICounters::Increment(EAllyAICounter Counter)
+{
+	RollWindow();
+
+	++Totals[static_cast<int32>(Counter)];
+	++WindowCounts[static_cast<int32>(Counter)];
+	++MinuteWindowCounts[static_cast<int32>(Counter)];
+
+	switch (Counter)
+	{
+	case EAllyAICounter::MoveRequests: INC_DWORD_STAT(STAT_AllyMoveRequests); break;
+	case EAllyAICounter::PathQueries: INC_DWORD_STAT(STAT_AllyPathQueries); break;
+	case EAllyAICounter::StateTransitions: INC_DWORD_STAT(STAT_AllyStateTransitions); break;
+	case EAllyAICounter::SprintToggles: INC_DWORD_STAT(STAT_AllySprintToggles); break;
+	case EAllyAICounter::FailedMoves: INC_DWORD_STAT(STAT_AllyFailedMoves); break;
+	default: break;
+	}
+}
+
+/**
+ * Returns how many of an event have happened since the counters were reset.
+ */
+int64 FAllyAICounters::GetTotal(EAllyAICounter Counter)
+{
+	return Totals[static_cast<int32>(Counter)];
+}
+
+/**
+ * Returns how many of an event happened during the last full second.
+ */
+float FAllyAICounters::GetPerSecond(EAllyAICounter Counter)
+{
+	RollWindow();
+
+	return LastRates[static_cast<int32>(Counter)];
+}
+
+/**
+ * Returns how many of an event happened during the last full minute.
+ */
+float FAllyAICounters::GetPerMinute(EAllyAICounter Counter)
+{
+	RollWindow();
+
+	return LastMinuteRates[static_cast<int32>(Counter)];
+}
+
+/**
+ * Returns the display name of an event.
+ */
+const TCHAR* FAllyAICounters::GetName(EAllyAICounter Counter)
+{
+	switch (Counter)
+	{
+	case EAllyAICounter::MoveRequests: return TEXT("move requests");
+	case EAllyAICounter::PathQueries: return TEXT("path queries");
+	case EAllyAICounter::StateTransitions: return TEXT("state transitions");
+	case EAllyAICounter::SprintToggles: return TEXT("sprint toggles");
+	case EAllyAICounter::FailedMoves: return TEXT("failed moves");
+	default: return TEXT("unknown");
+	}
+}
+
+/**
+ * Sets every counter back to zero.
+ */
+void FAllyAICounters::Reset()
+{
+	for (int32 Index = 0; Index < static_cast<int32>(EAllyAICounter::Num); ++Index)
+	{
+		Totals[Index] = 0;
+		WindowCounts[Index] = 0;
+		LastRates[Index] = 0.f;
+		MinuteWindowCounts[Index] = 0;
+		LastMinuteRates[Index] = 0.f;
+	}
+
+	SecondWindow.Reset();
+	MinuteWindow.Reset();
+}
+
+/**
+ * Moves on to a new window once the current one is a second old, and to a new minute
+ * long window once that one is a minute old.
+ */
+void FAllyAICounters::RollWindow()
+{
+	double RateScale = 0.0;
+
+	if (MinuteWindow.Roll(RateScale))
+	{
+		for (int32 Index = 0; Index < static_cast<int32>(EAllyAICounter::Num); ++Index)
+		{
+			LastMinuteRates[Index] = static_cast<float>(MinuteWindowCounts[Index] * RateScale);
+			MinuteWindowCounts[Index] = 0;
+		}
+	}
+
+	if (!SecondWindow.Roll(RateScale)) return;
+
+	for (int32 Index = 0; Index < static_cast<int32>(EAllyAICounter::Num); ++Index)
+	{
+		LastRates[Index] = static_cast<float>(WindowCounts[Index] * RateScale);
+		WindowCounts[Index] = 0;
+	}
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+// The stat group that every ally AI stat belongs to, shown with `stat AllyAI`.
+DECLARE_STATS_GROUP(TEXT("AllyAI"), STATGROUP_AllyAI, STATCAT_Advanced);
+
+// The time spent in each of the ally AI's hot paths.
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Crowd Tick"), STAT_AllyCrowdTick, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Crowd Update LOD Tiers"), STAT_AllyCrowdUpdateLODTiers, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Crowd Sync State Store"), STAT_AllyCrowdSyncStateStore, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Crowd Evaluate Decisions"), STAT_AllyCrowdEvaluate, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Crowd Waypoint Arrivals"), STAT_AllyCrowdWaypointArrivals, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Crowd Sprint Task"), STAT_AllyCrowdSprintTask, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Crowd Send Queued Moves"), STAT_AllyCrowdSendQueuedMoves, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Crowd Replicated States"), STAT_AllyCrowdReplicatedStates, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Assignment Tick"), STAT_AllyAssignmentTick, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Entity Tick"), STAT_AllyEntityTick, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Entity Simulate"), STAT_AllyEntitySimulate, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("OnMoveCompleted"), STAT_AllyOnMoveCompleted, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("MoveToPlayerCharacter"), STAT_AllyMoveToPlayerCharacter, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("MoveToWaypoint"), STAT_AllyMoveToWaypoint, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("OnPlayerMovingChanged"), STAT_AllyOnPlayerMovingChanged, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("MakeAllyLead"), STAT_AllyMakeAllyLead, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("OnComponentEnterBoxCollider"), STAT_AllyOnComponentEnterBoxCollider, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Path Cache Find Path"), STAT_AllyPathCacheFindPath, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Follow Group Find Path"), STAT_AllyFollowGroupFindPath, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+
+// How many of each ally AI event happened this frame.
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Move Requests"), STAT_AllyMoveRequests, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Path Queries"), STAT_AllyPathQueries, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("State Transitions"), STAT_AllyStateTransitions, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Sprint Toggles"), STAT_AllySprintToggles, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Failed Moves"), STAT_AllyFailedMoves, STATGROUP_AllyAI, FOLLOWLEADAI_API);
+
+// Times the enclosing scope both for `stat AllyAI` and for Unreal Insights, where it
+// shows up under the stat's name instead of the generic timer and overlap buckets.
+#define ALLY_AI_SCOPE(Stat) \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	TRACE_CPUPROFILER_EVENT_SCOPE(Stat)
+
+/**
+ * The ally AI events that are counted by FAllyAICounters.
+ */
+enum class EAllyAICounter : uint8
+{
+	MoveRequests,
+	PathQueries,
+	StateTransitions,
+	SprintToggles,
+	FailedMoves,
+	Num,
+};
+
+/**
+ * A window of platform time that counts are turned into rates over. Once the window is at
+ * least `Length` seconds old a new one is started, even if nothing was counted for a while.
+ */
+struct FOLLOWLEADAI_API FAllyRateWindow
+{
+	explicit constexpr FAllyRateWindow(double InLength) : Length(InLength) {}
+
+	/**
+	 * Starts a new window if the current one is at least `Length` seconds old.
+	 *
+	 * @param OutRateScale What a count from the window that ended is multiplied by to get a rate per `Length` seconds.
+	 *
+	 * @return Whether a new window was started.
+	 */
+	bool Roll(double& OutRateScale);
+
+	/**
+	 * Starts a new window now.
+	 */
+	void Reset() { StartSeconds = FPlatformTime::Seconds(); }
+
+private:
+	// How long, in seconds, a window lasts.
+	double Length;
+
+	// The platform time at which the current window started.
+	double StartSeconds = 0.0;
+};
+
+/**
+ * Counts ally AI events over the whole session, over the last full second, and over the
+ * last full minute so that the rates can be read in a live build with `ally.Stats`
+ * without a stats capture.
+ * The counters are only touched on the game thread.
+ */
+struct FOLLOWLEADAI_API FAllyAICounters
+{
+	/**
+	 * Counts one of an event.
+	 *
+	 * @param Counter The event to count.
+	 */
+	static void Increment(EAllyAICounter Counter);
+
+	/**
+	 * Returns how many of an event have happened since the counters were reset.
+	 */
+	static int64 GetTotal(EAllyAICounter Counter);
+
+	/**
+	 * Returns how many of an event happened during the last full second.
+	 */
+	static float GetPerSecond(EAllyAICounter Counter);
+
+	/**
+	 * Returns how many of an event happened during the last full minute.
+	 */
+	static float GetPerMinute(EAllyAICounter Counter);
+
+	/**
+	 * Returns the display name of an event.
+	 */
+	static const TCHAR* GetName(EAllyAICounter Counter);
+
+	/**
+	 * Sets every counter back to zero.
+	 */
+	static void Reset();
+
+private:
+	// The number of each event since the counters were reset.
+	static int64 Totals[static_cast<int32>(EAllyAICounter::Num)];
+
+	// The number of each event since `SecondWindow` started.
+	static int32 WindowCounts[static_cast<int32>(EAllyAICounter::Num)];
+
+	// The number of each event per second during the last full window.
+	static float LastRates[static_cast<int32>(EAllyAICounter::Num)];
+
+	// The current one second window.
+	static FAllyRateWindow SecondWindow;
+
+	// The number of each event since `MinuteWindow` started.
+	static int32 MinuteWindowCounts[static_cast<int32>(EAllyAICounter::Num)];
+
+	// The number of each event per minute during the last full minute long window.
+	static float LastMinuteRates[static_cast<int32>(EAllyAICounter::Num)];
+
+	// The current one minute window.
+	static FAllyRateWindow MinuteWindow;
+
+	/**
+	 * Moves on to a new window once the current one is a second old, and to a new
+	 * minute long window once that one is a minute old.
+	 */
+	static void RollWindow();
+};
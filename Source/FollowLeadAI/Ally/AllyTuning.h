@@ -0,0 +1,145 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "AllyTuning.generated.h"
+
+/**
+ * The distances and speeds of a kind of AllyCharacter, shared by every AllyCharacter
+ * that points at it so that they can be tuned together in one place instead of on
+ * every placed AllyCharacter. AllyCharacters without one use the defaults below.
+ */
+UCLASS(BlueprintType)
+class FOLLOWLEADAI_API UAllyTuning : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	// The minimum distance the AllyCharacter should be from the PlayerCharacter.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Distances)
+	float MinDistanceFromPlayer = 100.f;
+
+	// The maximum distance the AllyCharacter should be from the PlayerCharacter.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Distances)
+	float MaxDistanceFromPlayer = 500.f;
+
+	// The maximum distance the AllyCharacter can be from the PlayerCharacter before
+	// they start sprinting to catch up to the PlayerCharacter.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Distances)
+	float MaxDistanceFromPlayerBeforeSprint = 600.f;
+
+	// How much closer than `MaxDistanceFromPlayerBeforeSprint` the AllyCharacter has to get
+	// to the PlayerCharacter before it stops sprinting.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Distances)
+	float SprintHysteresis = 150.f;
+
+	// The maximum distance the PlayerCharacter can be from the AllyCharacter when
+	// leading before the AllyCharacter waits for them to catch up.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Distances)
+	float MaxDistanceFromPlayerWhileLeading = 500.f;
+
+	// How far ahead, in seconds, the PlayerCharacter's location is predicted for predictive following.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Distances)
+	float FollowPredictionTime = 0.75f;
+
+	// The speed at which the AllyCharacter should walk at.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Movement)
+	float WalkSpeed = 200.f;
+
+	// The speed at which the AllyCharacter should sprint at.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Movement)
+	float SprintSpeed = 500.f;
+
+	// How quickly, in units per second per second, the AllyCharacter's maximum speed moves
+	// between `WalkSpeed` and `SprintSpeed`. 0 switches between them straight away.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Movement)
+	float SpeedChangeRate = 600.f;
+};
+
+/**
+ * The distances and speeds that a single AllyCharacter uses instead of its UAllyTuning.
+ * Only the values whose `bOverride_` flag is set are used. It's only created for the
+ * AllyCharacters that need it so the rest don't pay for a copy of every value.
+ */
+UCLASS(EditInlineNew, DefaultToInstanced, CollapseCategories)
+class FOLLOWLEADAI_API UAllyTuningOverrides : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	// Whether `MinDistanceFromPlayer` is used instead of the UAllyTuning's.
+	UPROPERTY(EditAnywhere, Category = Overrides, meta = (PinHiddenByDefault, InlineEditConditionToggle))
+	uint8 bOverride_MinDistanceFromPlayer : 1;
+
+	// Whether `MaxDistanceFromPlayer` is used instead of the UAllyTuning's.
+	UPROPERTY(EditAnywhere, Category = Overrides, meta = (PinHiddenByDefault, InlineEditConditionToggle))
+	uint8 bOverride_MaxDistanceFromPlayer : 1;
+
+	// Whether `MaxDistanceFromPlayerBeforeSprint` is used instead of the UAllyTuning's.
+	UPROPERTY(EditAnywhere, Category = Overrides, meta = (PinHiddenByDefault, InlineEditConditionToggle))
+	uint8 bOverride_MaxDistanceFromPlayerBeforeSprint : 1;
+
+	// Whether `SprintHysteresis` is used instead of the UAllyTuning's.
+	UPROPERTY(EditAnywhere, Category = Overrides, meta = (PinHiddenByDefault, InlineEditConditionToggle))
+	uint8 bOverride_SprintHysteresis : 1;
+
+	// Whether `MaxDistanceFromPlayerWhileLeading` is used instead of the UAllyTuning's.
+	UPROPERTY(EditAnywhere, Category = Overrides, meta = (PinHiddenByDefault, InlineEditConditionToggle))
+	uint8 bOverride_MaxDistanceFromPlayerWhileLeading : 1;
+
+	// Whether `FollowPredictionTime` is used instead of the UAllyTuning's.
+	UPROPERTY(EditAnywhere, Category = Overrides, meta = (PinHiddenByDefault, InlineEditConditionToggle))
+	uint8 bOverride_FollowPredictionTime : 1;
+
+	// Whether `WalkSpeed` is used instead of the UAllyTuning's.
+	UPROPERTY(EditAnywhere, Category = Overrides, meta = (PinHiddenByDefault, InlineEditConditionToggle))
+	uint8 bOverride_WalkSpeed : 1;
+
+	// Whether `SprintSpeed` is used instead of the UAllyTuning's.
+	UPROPERTY(EditAnywhere, Category = Overrides, meta = (PinHiddenByDefault, InlineEditConditionToggle))
+	uint8 bOverride_SprintSpeed : 1;
+
+	// Whether `SpeedChangeRate` is used instead of the UAllyTuning's.
+	UPROPERTY(EditAnywhere, Category = Overrides, meta = (PinHiddenByDefault, InlineEditConditionToggle))
+	uint8 bOverride_SpeedChangeRate : 1;
+
+	// The minimum distance the AllyCharacter should be from the PlayerCharacter.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Overrides, meta = (EditCondition = "bOverride_MinDistanceFromPlayer"))
+	float MinDistanceFromPlayer = 100.f;
+
+	// The maximum distance the AllyCharacter should be from the PlayerCharacter.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Overrides, meta = (EditCondition = "bOverride_MaxDistanceFromPlayer"))
+	float MaxDistanceFromPlayer = 500.f;
+
+	// The maximum distance the AllyCharacter can be from the PlayerCharacter before
+	// they start sprinting to catch up to the PlayerCharacter.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Overrides, meta = (EditCondition = "bOverride_MaxDistanceFromPlayerBeforeSprint"))
+	float MaxDistanceFromPlayerBeforeSprint = 600.f;
+
+	// How much closer than `MaxDistanceFromPlayerBeforeSprint` the AllyCharacter has to get
+	// to the PlayerCharacter before it stops sprinting.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Overrides, meta = (EditCondition = "bOverride_SprintHysteresis"))
+	float SprintHysteresis = 150.f;
+
+	// The maximum distance the PlayerCharacter can be from the AllyCharacter when
+	// leading before the AllyCharacter waits for them to catch up.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Overrides, meta = (EditCondition = "bOverride_MaxDistanceFromPlayerWhileLeading"))
+	float MaxDistanceFromPlayerWhileLeading = 500.f;
+
+	// How far ahead, in seconds, the PlayerCharacter's location is predicted for predictive following.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Overrides, meta = (EditCondition = "bOverride_FollowPredictionTime"))
+	float FollowPredictionTime = 0.75f;
+
+	// The speed at which the AllyCharacter should walk at.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Overrides, meta = (EditCondition = "bOverride_WalkSpeed"))
+	float WalkSpeed = 200.f;
+
+	// The speed at which the AllyCharacter should sprint at.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Overrides, meta = (EditCondition = "bOverride_SprintSpeed"))
+	float SprintSpeed = 500.f;
+
+	// How quickly, in units per second per second, the AllyCharacter's maximum speed moves
+	// between `WalkSpeed` and `SprintSpeed`. 0 switches between them straight away.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Overrides, meta = (EditCondition = "bOverride_SpeedChangeRate"))
+	float SpeedChangeRate = 600.f;
+};
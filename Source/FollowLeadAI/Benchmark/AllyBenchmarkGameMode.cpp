@@ -0,0 +1,377 @@
+#include "AllyBenchmarkGameMode.h"
+#include "../Ally/AllyAIController.h"
+#include "../Ally/AllyAssetSettings.h"
+#include "../Ally/AllyAssetSubsystem.h"
+#include "../Ally/AllyCharacter.h"
+#include "../Ally/AllyCompactCharacter.h"
+#include "../Ally/AllyCrowdSubsystem.h"
+#include "../Ally/AllyEntitySubsystem.h"
+#include "../Ally/AllyPathCache.h"
+#include "../Ally/AllyPoolSubsystem.h"
+#include "../Ally/AllyTuning.h"
+#include "../Player/PlayerCharacter.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMemory.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "NavigationSystem.h"
+
+/**
+ * Sets the default values for the AllyBenchmarkGameMode.
+ */
+AAllyBenchmarkGameMode::AAllyBenchmarkGameMode()
+{
+	// The benchmark plays the script back and measures every frame.
+	PrimaryActorTick.bCanEverTick = true;
+}
+
+/**
+ * Called before any actors are created to read the benchmark settings from the command line.
+ */
+void AAllyBenchmarkGameMode::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage)
+{
+	Super::InitGame(MapName, Options, ErrorMessage);
+
+	const TCHAR* CommandLine = FCommandLine::Get();
+	FParse::Value(CommandLine, TEXT("AllyCount="), AllyCount);
+	FParse::Value(CommandLine, TEXT("AllyBenchmarkScript="), ScriptPath);
+	FParse::Value(CommandLine, TEXT("AllyBenchmarkName="), BenchmarkName);
+	if (FParse::Param(CommandLine, TEXT("AllyGroupFollow"))) bUseGroupFollow = true;
+	if (FParse::Param(CommandLine, TEXT("AllyPredictiveFollow"))) bUsePredictiveFollow = true;
+	if (FParse::Param(CommandLine, TEXT("AllyCrowdAvoidance"))) bUseCrowdAvoidance = true;
+	if (FParse::Param(CommandLine, TEXT("AllySpatialHash"))) bUseWaypointSpatialHash = true;
+	if (FParse::Param(CommandLine, TEXT("AllyPool"))) bUsePool = true;
+	if (FParse::Param(CommandLine, TEXT("AllyCompact"))) bUseCompactAllies = true;
+	if (FParse::Param(CommandLine, TEXT("AllyEntities"))) bUseEntities = true;
+
+	FString TuningPath;
+	if (FParse::Value(CommandLine, TEXT("AllyTuning="), TuningPath))
+	{
+		Tuning = LoadObject<UAllyTuning>(nullptr, *TuningPath);
+		if (Tuning == nullptr) UE_LOG(LogTemp, Warning, TEXT("Couldn't load ally tuning %s"), *TuningPath);
+	}
+
+	int32 MovePathBudget;
+	if (FParse::Value(CommandLine, TEXT("AllyMoveBudget="), MovePathBudget))
+	{
+		if (IConsoleVariable* BudgetVariable = IConsoleManager::Get().FindConsoleVariable(TEXT("ally.Move.MaxPathQueriesPerFrame"))) BudgetVariable->Set(MovePathBudget);
+	}
+
+	int32 DecisionWorkers;
+	if (FParse::Value(CommandLine, TEXT("AllyDecisionWorkers="), DecisionWorkers))
+	{
+		if (IConsoleVariable* WorkersVariable = IConsoleManager::Get().FindConsoleVariable(TEXT("ally.Crowd.DecisionWorkers"))) WorkersVariable->Set(DecisionWorkers);
+	}
+
+	// Entities are turned back into allies from the pool so they need it to be prewarmed.
+	if (bUseEntities)
+	{
+		bUsePool = true;
+		if (IConsoleVariable* EntityVariable = IConsoleManager::Get().FindConsoleVariable(TEXT("ally.Entity.Enabled"))) EntityVariable->Set(1);
+	}
+
+	// Seed the allies' random choices so that every run makes the same choices.
+	int32 RandomSeed = 1;
+	FParse::Value(CommandLine, TEXT("AllyRandomSeed="), RandomSeed);
+	if (IConsoleVariable* SeedVariable = IConsoleManager::Get().FindConsoleVariable(TEXT("ally.Random.Seed"))) SeedVariable->Set(RandomSeed);
+
+	Script = FAllyBenchmarkScript::MakeDefault();
+	if (!ScriptPath.IsEmpty() && !FAllyBenchmarkScript::LoadFromFile(ScriptPath, Script))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Couldn't read ally benchmark script %s, using the default script"), *ScriptPath);
+		Script = FAllyBenchmarkScript::MakeDefault();
+	}
+}
+
+/**
+ * Called when the benchmark starts to spawn the AllyCharacters.
+ */
+void AAllyBenchmarkGameMode::BeginPlay()
+{
+	Super::BeginPlay();
+
+	PlayerCharacter = Cast<APlayerCharacter>(UGameplayStatics::GetPlayerCharacter(this, 0));
+	if (PlayerCharacter == nullptr)
+	{
+		UE_LOG(LogTemp, Error, TEXT("The ally benchmark needs a PlayerCharacter in the level"));
+		return;
+	}
+
+	// Spawning shouldn't be timed with the assets still streaming in, which a game would
+	// have finished doing while the level loaded.
+	UAllyAssetSubsystem* AllyAssets = GetGameInstance() != nullptr ? GetGameInstance()->GetSubsystem<UAllyAssetSubsystem>() : nullptr;
+	if (AllyAssets != nullptr) AllyAssets->WaitForPreload();
+
+	MemoryBeforeSpawn = FPlatformMemory::GetStats().UsedPhysical;
+	SpawnAllies();
+	MemoryAfterSpawn = FPlatformMemory::GetStats().UsedPhysical;
+
+	FAllyPathCache::ResetGlobalStats();
+	FAllyAICounters::Reset();
+	Frames.Reserve(FMath::CeilToInt(Script.Duration * 120.f));
+
+	LastFrameSeconds = FPlatformTime::Seconds();
+	bIsRunning = true;
+
+	UE_LOG(LogTemp, Display, TEXT("Ally benchmark %s started with %d allies for %.0f seconds"), *BenchmarkName, NumSpawned, Script.Duration);
+}
+
+/**
+ * Spawns `AllyCount` AllyCharacters on the navmesh around the PlayerCharacter.
+ */
+void AAllyBenchmarkGameMode::SpawnAllies()
+{
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	const FVector PlayerLocation = PlayerCharacter->GetActorLocation();
+
+	// Prewarming is timed separately since a game would do it while the level loads.
+	const TSubclassOf<AAllyCharacter> AllyClass = bUseCompactAllies ? AAllyCompactCharacter::StaticClass() : AAllyCharacter::StaticClass();
+
+	UAllyPoolSubsystem* Pool = bUsePool ? GetWorld()->GetSubsystem<UAllyPoolSubsystem>() : nullptr;
+	if (Pool != nullptr)
+	{
+		Pool->SetAllyClass(AllyClass);
+
+		const double PrewarmStartSeconds = FPlatformTime::Seconds();
+		Pool->Prewarm(AllyCount);
+		PrewarmMs = static_cast<float>((FPlatformTime::Seconds() - PrewarmStartSeconds) * 1000.0);
+	}
+
+	const double SpawnStartSeconds = FPlatformTime::Seconds();
+
+	// The same stream every run so that the allies always start in the same places.
+	FRandomStream SpawnStream(AllyCount);
+
+	// The allies take turns being each of the variants from the Ally Assets settings.
+	const TArray<FAllyVariant>& Variants = GetDefault<UAllyAssetSettings>()->AllyVariants;
+
+	for (int32 Index = 0; Index < AllyCount; ++Index)
+	{
+		FVector SpawnLocation = PlayerLocation + FVector(SpawnStream.VRand().GetSafeNormal2D() * SpawnStream.FRandRange(200.f, SpawnRadius));
+
+		FNavLocation NavLocation;
+		if (NavSys != nullptr && NavSys->ProjectPointToNavigation(SpawnLocation, NavLocation)) SpawnLocation = NavLocation.Location;
+		SpawnLocation.Z = PlayerLocation.Z;
+
+		if (Pool != nullptr)
+		{
+			const FName VariantName = Variants.Num() > 0 ? Variants[Index % Variants.Num()].Name : NAME_None;
+			const AAllyCharacter* PooledAlly = Pool->AcquireAlly(PlayerCharacter, FTransform(SpawnLocation), [this, VariantName](AAllyCharacter* Ally)
+			{
+				Ally->VariantName = VariantName;
+				// A pooled AllyCharacter may still have the overrides of the entity it was last made from.
+				Ally->Tuning = Tuning;
+				Ally->TuningOverrides = nullptr;
+				Ally->bUseGroupFollow = bUseGroupFollow;
+				Ally->bUsePredictiveFollow = bUsePredictiveFollow;
+				Ally->bUseCrowdAvoidance = bUseCrowdAvoidance;
+				Ally->bUseWaypointSpatialHash = bUseWaypointSpatialHash;
+			});
+			if (PooledAlly != nullptr) ++NumSpawned;
+			continue;
+		}
+
+		AAllyCharacter* Ally = GetWorld()->SpawnActorDeferred<AAllyCharacter>(AllyClass, FTransform(SpawnLocation), nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn);
+		if (Ally == nullptr) continue;
+
+		// Everything the AllyAIController needs has to be set before the AllyCharacter finishes spawning.
+		Ally->PlayerCharacter = PlayerCharacter;
+		Ally->VariantName = Variants.Num() > 0 ? Variants[Index % Variants.Num()].Name : NAME_None;
+		Ally->Tuning = Tuning;
+		Ally->bUseGroupFollow = bUseGroupFollow;
+		Ally->bUsePredictiveFollow = bUsePredictiveFollow;
+		Ally->bUseCrowdAvoidance = bUseCrowdAvoidance;
+		Ally->bUseWaypointSpatialHash = bUseWaypointSpatialHash;
+		Ally->AIControllerClass = AAllyAIController::StaticClass();
+		Ally->AutoPossessAI = EAutoPossessAI::Spawned;
+
+		UGameplayStatics::FinishSpawningActor(Ally, FTransform(SpawnLocation));
+		++NumSpawned;
+	}
+
+	SpawnMs = static_cast<float>((FPlatformTime::Seconds() - SpawnStartSeconds) * 1000.0);
+}
+
+/**
+ * Called every frame to play the script back and measure the frame.
+ */
+void AAllyBenchmarkGameMode::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (!bIsRunning) return;
+
+	ElapsedTime += DeltaSeconds;
+
+	// Drive the PlayerCharacter with the script's input for this point in time.
+	FVector2D Input;
+	bool bSprint;
+	Script.SampleInput(ElapsedTime, Input, bSprint);
+	PlayerCharacter->SetScriptedInput(Input, bSprint);
+
+	// Send any lead requests that are due.
+	while (Script.LeadRequests.IsValidIndex(NextLeadRequest) && Script.LeadRequests[NextLeadRequest].Time <= ElapsedTime)
+	{
+		const FAllyBenchmarkLeadRequest& Request = Script.LeadRequests[NextLeadRequest++];
+		PlayerCharacter->RequestAllyLead(Request.StartWaypoint, Request.EndWaypoint, Request.bShouldWaitForPlayer);
+	}
+
+	// Measure the frame.
+	const double NowSeconds = FPlatformTime::Seconds();
+	const FAllyPathCacheStats& PathStats = FAllyPathCache::GetGlobalStats();
+	const UAllyCrowdSubsystem* CrowdSubsystem = GetWorld()->GetSubsystem<UAllyCrowdSubsystem>();
+
+	FAllyBenchmarkFrame& Frame = Frames.AddDefaulted_GetRef();
+	Frame.Time = ElapsedTime;
+	Frame.FrameMs = static_cast<float>((NowSeconds - LastFrameSeconds) * 1000.0);
+	Frame.CrowdMs = CrowdSubsystem != nullptr ? static_cast<float>(CrowdSubsystem->GetLastTickSeconds() * 1000.0) : 0.f;
+	Frame.DecisionMs = CrowdSubsystem != nullptr ? static_cast<float>(CrowdSubsystem->GetLastDecisionSeconds() * 1000.0) : 0.f;
+	Frame.QueuedMoves = CrowdSubsystem != nullptr ? CrowdSubsystem->GetNumQueuedMoves() : 0;
+	Frame.PathReuses = PathStats.Hits - LastPathReuses;
+
+	// The counters only ever go up so the difference from last frame is this frame's count.
+	const auto CountThisFrame = [this](EAllyAICounter Counter)
+	{
+		const int64 Total = FAllyAICounters::GetTotal(Counter);
+		const int32 Count = static_cast<int32>(Total - LastCounterTotals[static_cast<int32>(Counter)]);
+		LastCounterTotals[static_cast<int32>(Counter)] = Total;
+		return Count;
+	};
+	Frame.PathQueries = CountThisFrame(EAllyAICounter::PathQueries);
+	Frame.MoveRequests = CountThisFrame(EAllyAICounter::MoveRequests);
+	Frame.StateTransitions = CountThisFrame(EAllyAICounter::StateTransitions);
+	Frame.SprintToggles = CountThisFrame(EAllyAICounter::SprintToggles);
+	Frame.FailedMoves = CountThisFrame(EAllyAICounter::FailedMoves);
+
+	const UAllyEntitySubsystem* EntitySubsystem = GetWorld()->GetSubsystem<UAllyEntitySubsystem>();
+	Frame.Entities = EntitySubsystem != nullptr ? EntitySubsystem->GetNumEntities() : 0;
+
+	LastFrameSeconds = NowSeconds;
+	LastPathReuses = PathStats.Hits;
+
+	if (ElapsedTime >= Script.Duration) FinishBenchmark();
+}
+
+/**
+ * Times the ally decisions for the allies as they are at the end of the benchmark split
+ * across 1, 2, 4, and 8 threads, and adds the times and speedups to the summary.
+ *
+ * @param SummaryCsv The summary to add the results to.
+ */
+void AAllyBenchmarkGameMode::MeasureDecisionScaling(FString& SummaryCsv)
+{
+	UAllyCrowdSubsystem* CrowdSubsystem = GetWorld()->GetSubsystem<UAllyCrowdSubsystem>();
+	if (CrowdSubsystem == nullptr) return;
+
+	// A single evaluation is too quick to time on its own so time a lot of them. The
+	// decisions only read the allies' synced state so repeating them changes nothing.
+	const int32 NumRuns = 200;
+	const int32 WorkerCounts[] = { 1, 2, 4, 8 };
+
+	SummaryCsv += FString::Printf(TEXT("WorkerThreads,%d\n"), FTaskGraphInterface::Get().GetNumWorkerThreads());
+
+	double SingleWorkerMs = 0.0;
+	for (const int32 NumWorkers : WorkerCounts)
+	{
+		// With too few allies for every worker to get `ally.Crowd.MinAlliesPerWorker` of them
+		// fewer workers are used, so record how many actually were alongside the timing.
+		int32 EffectiveWorkers = 1;
+		const double StartSeconds = FPlatformTime::Seconds();
+		for (int32 Run = 0; Run < NumRuns; ++Run) EffectiveWorkers = CrowdSubsystem->EvaluateDecisions(NumWorkers);
+		const double DecisionMs = (FPlatformTime::Seconds() - StartSeconds) * 1000.0 / NumRuns;
+
+		if (NumWorkers == 1) SingleWorkerMs = DecisionMs;
+
+		SummaryCsv += FString::Printf(TEXT("DecisionEffectiveWorkersWith%dWorkers,%d\n"), NumWorkers, EffectiveWorkers);
+		SummaryCsv += FString::Printf(TEXT("DecisionMsWith%dWorkers,%.4f\n"), NumWorkers, DecisionMs);
+		SummaryCsv += FString::Printf(TEXT("DecisionSpeedupWith%dWorkers,%.2f\n"), NumWorkers, SingleWorkerMs / FMath::Max(DecisionMs, 1e-6));
+	}
+}
+
+/**
+ * Writes the measured frames and a summary of them to `Saved/Benchmarks` and quits if needed.
+ */
+void AAllyBenchmarkGameMode::FinishBenchmark()
+{
+	bIsRunning = false;
+	PlayerCharacter->ClearScriptedInput();
+
+	const FString Directory = FPaths::ProjectSavedDir() / TEXT("Benchmarks");
+
+	// One row per frame.
+	FString FramesCsv = TEXT("Time,FrameMs,CrowdMs,DecisionMs,PathQueries,PathReuses,MoveRequests,StateTransitions,SprintToggles,FailedMoves,Entities,QueuedMoves\n");
+	for (const FAllyBenchmarkFrame& Frame : Frames)
+	{
+		FramesCsv += FString::Printf(TEXT("%.4f,%.4f,%.4f,%.4f,%d,%d,%d,%d,%d,%d,%d,%d\n"), Frame.Time, Frame.FrameMs, Frame.CrowdMs, Frame.DecisionMs, Frame.PathQueries, Frame.PathReuses, Frame.MoveRequests, Frame.StateTransitions, Frame.SprintToggles, Frame.FailedMoves, Frame.Entities, Frame.QueuedMoves);
+	}
+
+	// The summary is what gets compared between builds.
+	TArray<float> FrameTimes;
+	double TotalFrameMs = 0.0;
+	double TotalCrowdMs = 0.0;
+	double TotalDecisionMs = 0.0;
+	float MaxCrowdMs = 0.f;
+	int32 TotalPathQueries = 0;
+	int32 TotalPathReuses = 0;
+	int64 TotalEntities = 0;
+	int32 MaxQueuedMoves = 0;
+
+	for (const FAllyBenchmarkFrame& Frame : Frames)
+	{
+		FrameTimes.Add(Frame.FrameMs);
+		TotalFrameMs += Frame.FrameMs;
+		TotalCrowdMs += Frame.CrowdMs;
+		TotalDecisionMs += Frame.DecisionMs;
+		MaxCrowdMs = FMath::Max(MaxCrowdMs, Frame.CrowdMs);
+		TotalPathQueries += Frame.PathQueries;
+		TotalPathReuses += Frame.PathReuses;
+		TotalEntities += Frame.Entities;
+		MaxQueuedMoves = FMath::Max(MaxQueuedMoves, Frame.QueuedMoves);
+	}
+	FrameTimes.Sort();
+
+	const int32 NumFrames = FMath::Max(Frames.Num(), 1);
+	const auto Percentile = [&FrameTimes](float Fraction) { return FrameTimes.Num() > 0 ? FrameTimes[FMath::Min(FMath::FloorToInt(Fraction * FrameTimes.Num()), FrameTimes.Num() - 1)] : 0.f; };
+	const int64 MemoryPerAlly = NumSpawned > 0 ? (int64(MemoryAfterSpawn) - int64(MemoryBeforeSpawn)) / NumSpawned : 0;
+
+	FString SummaryCsv = TEXT("Metric,Value\n");
+	SummaryCsv += FString::Printf(TEXT("Allies,%d\n"), NumSpawned);
+	SummaryCsv += FString::Printf(TEXT("Frames,%d\n"), Frames.Num());
+	SummaryCsv += FString::Printf(TEXT("AvgFrameMs,%.4f\n"), TotalFrameMs / NumFrames);
+	SummaryCsv += FString::Printf(TEXT("P50FrameMs,%.4f\n"), Percentile(0.5f));
+	SummaryCsv += FString::Printf(TEXT("P95FrameMs,%.4f\n"), Percentile(0.95f));
+	SummaryCsv += FString::Printf(TEXT("P99FrameMs,%.4f\n"), Percentile(0.99f));
+	SummaryCsv += FString::Printf(TEXT("MaxFrameMs,%.4f\n"), FrameTimes.Num() > 0 ? FrameTimes.Last() : 0.f);
+	SummaryCsv += FString::Printf(TEXT("AvgCrowdMs,%.4f\n"), TotalCrowdMs / NumFrames);
+	SummaryCsv += FString::Printf(TEXT("MaxCrowdMs,%.4f\n"), MaxCrowdMs);
+	SummaryCsv += FString::Printf(TEXT("AvgDecisionMs,%.4f\n"), TotalDecisionMs / NumFrames);
+	SummaryCsv += FString::Printf(TEXT("PathQueries,%d\n"), TotalPathQueries);
+	SummaryCsv += FString::Printf(TEXT("PathReuses,%d\n"), TotalPathReuses);
+	SummaryCsv += FString::Printf(TEXT("PathQueriesPerSecond,%.2f\n"), TotalPathQueries / FMath::Max(ElapsedTime, KINDA_SMALL_NUMBER));
+	SummaryCsv += FString::Printf(TEXT("MoveRequests,%lld\n"), FAllyAICounters::GetTotal(EAllyAICounter::MoveRequests));
+	SummaryCsv += FString::Printf(TEXT("StateTransitions,%lld\n"), FAllyAICounters::GetTotal(EAllyAICounter::StateTransitions));
+	SummaryCsv += FString::Printf(TEXT("SprintToggles,%lld\n"), FAllyAICounters::GetTotal(EAllyAICounter::SprintToggles));
+	SummaryCsv += FString::Printf(TEXT("SprintTogglesPerAllyPerMinute,%.4f\n"), FAllyAICounters::GetTotal(EAllyAICounter::SprintToggles) * 60.0 / FMath::Max(ElapsedTime, KINDA_SMALL_NUMBER) / FMath::Max(NumSpawned, 1));
+	SummaryCsv += FString::Printf(TEXT("FailedMoves,%lld\n"), FAllyAICounters::GetTotal(EAllyAICounter::FailedMoves));
+	SummaryCsv += FString::Printf(TEXT("MaxQueuedMoves,%d\n"), MaxQueuedMoves);
+	SummaryCsv += FString::Printf(TEXT("AvgEntities,%.2f\n"), static_cast<double>(TotalEntities) / NumFrames);
+	SummaryCsv += FString::Printf(TEXT("MemoryPerAllyBytes,%lld\n"), MemoryPerAlly);
+	SummaryCsv += FString::Printf(TEXT("PrewarmMs,%.4f\n"), PrewarmMs);
+	SummaryCsv += FString::Printf(TEXT("SpawnMs,%.4f\n"), SpawnMs);
+
+	MeasureDecisionScaling(SummaryCsv);
+
+	const FString FramesPath = Directory / (BenchmarkName + TEXT("_Frames.csv"));
+	const FString SummaryPath = Directory / (BenchmarkName + TEXT("_Summary.csv"));
+	FFileHelper::SaveStringToFile(FramesCsv, *FramesPath);
+	FFileHelper::SaveStringToFile(SummaryCsv, *SummaryPath);
+
+	UE_LOG(LogTemp, Display, TEXT("Ally benchmark %s finished, results written to %s"), *BenchmarkName, *SummaryPath);
+
+	if (bQuitWhenFinished) FPlatformMisc::RequestExit(false);
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AllyBenchmarkScript.h"
+#include "../Ally/AllyStats.h"
+#include "../FollowLeadAIGameModeBase.h"
+#include "AllyBenchmarkGameMode.generated.h"
+
+class APlayerCharacter;
+
+/**
+ * What the AllyBenchmarkGameMode measured in a single frame.
+ */
+struct FAllyBenchmarkFrame
+{
+	// The time, in seconds since the benchmark started.
+	float Time = 0.f;
+
+	// How long the frame took, in milliseconds.
+	float FrameMs = 0.f;
+
+	// How long the AllyCrowdSubsystem's batched update took, in milliseconds.
+	float CrowdMs = 0.f;
+
+	// How long the part of the batched update that makes the ally decisions across threads took, in milliseconds.
+	float DecisionMs = 0.f;
+
+	// The number of navmesh path queries made by the allies this frame.
+	int32 PathQueries = 0;
+
+	// The number of follow paths reused without a query this frame.
+	int32 PathReuses = 0;
+
+	// The number of move requests issued by the allies this frame.
+	int32 MoveRequests = 0;
+
+	// The number of times an ally switched between FOLLOW and LEAD this frame.
+	int32 StateTransitions = 0;
+
+	// The number of times an ally started or stopped sprinting this frame.
+	int32 SprintToggles = 0;
+
+	// The number of ally moves that failed this frame.
+	int32 FailedMoves = 0;
+
+	// The number of allies that were lightweight entities at the end of the frame.
+	int32 Entities = 0;
+
+	// The number of ally moves still waiting for the path query budget at the end of the frame.
+	int32 QueuedMoves = 0;
+};
+
+/**
+ * The AllyBenchmarkGameMode spawns a number of AllyCharacters around the PlayerCharacter,
+ * drives the PlayerCharacter with an FAllyBenchmarkScript, and writes what it measured
+ * to CSV files in `Saved/Benchmarks` so that runs can be compared between builds.
+ *
+ * Everything can be set from the command line so that it can run headless, for example:
+ *
+ *   UE4Editor FollowLeadAI.uproject MainLevel?game=/Script/FollowLeadAI.AllyBenchmarkGameMode
+ *     -game -nullrhi -unattended -AllyCount=200 -AllyBenchmarkName=Baseline
+ */
+UCLASS()
+class FOLLOWLEADAI_API AAllyBenchmarkGameMode : public AFollowLeadAIGameModeBase
+{
+	GENERATED_BODY()
+
+public:
+	AAllyBenchmarkGameMode();
+
+	// The number of AllyCharacters to spawn. Set with `-AllyCount=`.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Benchmark)
+	int32 AllyCount = 100;
+
+	// How far from the PlayerCharacter, in units, the AllyCharacters are spawned.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Benchmark)
+	float SpawnRadius = 1500.f;
+
+	// The path of the script to play back. The default script is used if empty. Set with `-AllyBenchmarkScript=`.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Benchmark)
+	FString ScriptPath;
+
+	// The name the CSV files are written with. Set with `-AllyBenchmarkName=`.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Benchmark)
+	FString BenchmarkName = TEXT("AllyBenchmark");
+
+	// Whether the spawned AllyCharacters follow as a group. Set with `-AllyGroupFollow`.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Benchmark)
+	bool bUseGroupFollow = false;
+
+	// Whether the spawned AllyCharacters follow predictively. Set with `-AllyPredictiveFollow`.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Benchmark)
+	bool bUsePredictiveFollow = false;
+
+	// Whether the spawned AllyCharacters are steered by the crowd simulation. Set with `-AllyCrowdAvoidance`.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Benchmark)
+	bool bUseCrowdAvoidance = false;
+
+	// Whether the spawned AllyCharacters use the waypoint grid. Set with `-AllySpatialHash`.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Benchmark)
+	bool bUseWaypointSpatialHash = false;
+
+	// Whether the spawned AllyCharacters are AllyCompactCharacters. Set with `-AllyCompact`.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Benchmark)
+	bool bUseCompactAllies = false;
+
+	// The distances and speeds every spawned AllyCharacter shares. Set with `-AllyTuning=` and the path of a UAllyTuning asset.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Benchmark)
+	class UAllyTuning* Tuning = nullptr;
+
+	// Whether the AllyCharacters are taken from a prewarmed AllyPoolSubsystem. Set with `-AllyPool`.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Benchmark)
+	bool bUsePool = false;
+
+	// Whether allies far from the PlayerCharacter are turned into lightweight entities. Set with
+	// `-AllyEntities`, which also turns on `bUsePool` since entities hand their allies to the pool.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Benchmark)
+	bool bUseEntities = false;
+
+	// Whether the game quits once the benchmark has finished.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Benchmark)
+	bool bQuitWhenFinished = true;
+
+public:
+	/**
+	 * Called before any actors are created to read the benchmark settings from the command line.
+	 */
+	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
+
+	/**
+	 * Called when the benchmark starts to spawn the AllyCharacters.
+	 */
+	virtual void BeginPlay() override;
+
+	/**
+	 * Called every frame to play the script back and measure the frame.
+	 */
+	virtual void Tick(float DeltaSeconds) override;
+
+protected:
+	// The script being played back.
+	FAllyBenchmarkScript Script;
+
+	// The PlayerCharacter being driven by the script.
+	UPROPERTY()
+	APlayerCharacter* PlayerCharacter;
+
+	// What was measured in each frame.
+	TArray<FAllyBenchmarkFrame> Frames;
+
+	// The time, in seconds since the benchmark started.
+	float ElapsedTime = 0.f;
+
+	// The index of the next lead request in the script to broadcast.
+	int32 NextLeadRequest = 0;
+
+	// The platform time at which the last frame ended.
+	double LastFrameSeconds = 0.0;
+
+	// The FAllyAICounters totals and path cache hits at the end of the last frame.
+	int64 LastCounterTotals[static_cast<int32>(EAllyAICounter::Num)] = {};
+	int32 LastPathReuses = 0;
+
+	// The memory used by the process before and after the AllyCharacters were spawned.
+	uint64 MemoryBeforeSpawn = 0;
+	uint64 MemoryAfterSpawn = 0;
+
+	// The number of AllyCharacters that were actually spawned.
+	int32 NumSpawned = 0;
+
+	// How long, in milliseconds, prewarming the pool and spawning the AllyCharacters took.
+	float PrewarmMs = 0.f;
+	float SpawnMs = 0.f;
+
+	// Indicates whether the benchmark is running.
+	bool bIsRunning = false;
+
+protected:
+	/**
+	 * Spawns `AllyCount` AllyCharacters on the navmesh around the PlayerCharacter.
+	 */
+	void SpawnAllies();
+
+	/**
+	 * Times the ally decisions for the allies as they are at the end of the benchmark split
+	 * across 1, 2, 4, and 8 threads, and adds the times and speedups to the summary.
+	 *
+	 * @param SummaryCsv The summary to add the results to.
+	 */
+	void MeasureDecisionScaling(FString& SummaryCsv);
+
+	/**
+	 * Writes the measured frames and a summary of them to `Saved/Benchmarks` and quits if needed.
+	 */
+	void FinishBenchmark();
+};
@@ -0,0 +1,113 @@
+#include "AllyBenchmarkScript.h"
+#include "Algo/UpperBound.h"
+#include "Misc/FileHelper.h"
+
+/**
+ * Returns the script that is used when no script file is given.
+ */
+FAllyBenchmarkScript FAllyBenchmarkScript::MakeDefault()
+{
+	FAllyBenchmarkScript Script;
+	Script.Duration = 60.f;
+
+	const auto AddInput = [&Script](float Time, float Forward, float Right, bool bSprint)
+	{
+		FAllyBenchmarkInputKey Key;
+		Key.Time = Time;
+		Key.Input = FVector2D(Forward, Right);
+		Key.bSprint = bSprint;
+		Script.InputKeys.Add(Key);
+	};
+
+	// Walk a square, stop for a moment, and then sprint back along it.
+	AddInput(0.f, 1.f, 0.f, false);
+	AddInput(6.f, 0.f, 1.f, false);
+	AddInput(12.f, -1.f, 0.f, false);
+	AddInput(18.f, 0.f, -1.f, false);
+	AddInput(24.f, 0.f, 0.f, false);
+	AddInput(28.f, 1.f, 0.f, true);
+	AddInput(32.f, 0.f, 1.f, true);
+	AddInput(36.f, -1.f, 0.f, true);
+	AddInput(40.f, 0.f, -1.f, true);
+	AddInput(44.f, 0.f, 0.f, false);
+	AddInput(48.f, 1.f, 1.f, false);
+	AddInput(56.f, 0.f, 0.f, false);
+
+	FAllyBenchmarkLeadRequest FirstLead;
+	FirstLead.Time = 24.f;
+	Script.LeadRequests.Add(FirstLead);
+
+	FAllyBenchmarkLeadRequest SecondLead;
+	SecondLead.Time = 48.f;
+	SecondLead.bShouldWaitForPlayer = false;
+	Script.LeadRequests.Add(SecondLead);
+
+	return Script;
+}
+
+/**
+ * Loads a script from a file.
+ */
+bool FAllyBenchmarkScript::LoadFromFile(const FString& Path, FAllyBenchmarkScript& OutScript)
+{
+	TArray<FString> Lines;
+	if (!FFileHelper::LoadFileToStringArray(Lines, *Path)) return false;
+
+	OutScript = FAllyBenchmarkScript();
+
+	for (const FString& Line : Lines)
+	{
+		const FString Trimmed = Line.TrimStartAndEnd();
+		if (Trimmed.IsEmpty() || Trimmed.StartsWith(TEXT("#"))) continue;
+
+		TArray<FString> Fields;
+		Trimmed.ParseIntoArray(Fields, TEXT(","));
+		for (FString& Field : Fields) Field.TrimStartAndEndInline();
+
+		if (Fields[0] == TEXT("duration") && Fields.Num() >= 2)
+		{
+			OutScript.Duration = FCString::Atof(*Fields[1]);
+		}
+		else if (Fields[0] == TEXT("input") && Fields.Num() >= 5)
+		{
+			FAllyBenchmarkInputKey Key;
+			Key.Time = FCString::Atof(*Fields[1]);
+			Key.Input = FVector2D(FCString::Atof(*Fields[2]), FCString::Atof(*Fields[3]));
+			Key.bSprint = FCString::Atoi(*Fields[4]) != 0;
+			OutScript.InputKeys.Add(Key);
+		}
+		else if (Fields[0] == TEXT("lead") && Fields.Num() >= 5)
+		{
+			FAllyBenchmarkLeadRequest Request;
+			Request.Time = FCString::Atof(*Fields[1]);
+			Request.StartWaypoint = FCString::Atoi(*Fields[2]);
+			Request.EndWaypoint = FCString::Atoi(*Fields[3]);
+			Request.bShouldWaitForPlayer = FCString::Atoi(*Fields[4]) != 0;
+			OutScript.LeadRequests.Add(Request);
+		}
+		else
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Ignoring line in ally benchmark script %s: %s"), *Path, *Trimmed);
+		}
+	}
+
+	OutScript.InputKeys.StableSort([](const FAllyBenchmarkInputKey& A, const FAllyBenchmarkInputKey& B) { return A.Time < B.Time; });
+	OutScript.LeadRequests.StableSort([](const FAllyBenchmarkLeadRequest& A, const FAllyBenchmarkLeadRequest& B) { return A.Time < B.Time; });
+
+	return true;
+}
+
+/**
+ * Returns the input at a point in time, which is the input of the last key at or before it.
+ */
+void FAllyBenchmarkScript::SampleInput(float Time, FVector2D& OutInput, bool& bOutSprint) const
+{
+	OutInput = FVector2D::ZeroVector;
+	bOutSprint = false;
+
+	const int32 NextKey = Algo::UpperBoundBy(InputKeys, Time, [](const FAllyBenchmarkInputKey& Key) { return Key.Time; });
+	if (NextKey == 0) return;
+
+	OutInput = InputKeys[NextKey - 1].Input;
+	bOutSprint = InputKeys[NextKey - 1].bSprint;
+}
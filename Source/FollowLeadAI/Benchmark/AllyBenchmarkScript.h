@@ -0,0 +1,83 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * The scripted input for the PlayerCharacter from a point in time until the next key.
+ */
+struct FAllyBenchmarkInputKey
+{
+	// The time, in seconds since the benchmark started, that this key starts at.
+	float Time = 0.f;
+
+	// The forward/backward (X) and left/right (Y) axis values.
+	FVector2D Input = FVector2D::ZeroVector;
+
+	// Whether the PlayerCharacter sprints.
+	bool bSprint = false;
+};
+
+/**
+ * An `OnAllyLeadRequest` broadcast at a fixed point in time.
+ */
+struct FAllyBenchmarkLeadRequest
+{
+	// The time, in seconds since the benchmark started, that the request is broadcast at.
+	float Time = 0.f;
+
+	// The `WaypointNumber` of the waypoint to start leading from.
+	int32 StartWaypoint = 0;
+
+	// The `WaypointNumber` of the waypoint to stop leading at.
+	int32 EndWaypoint = 1;
+
+	// Whether the allies should wait for the PlayerCharacter while leading.
+	bool bShouldWaitForPlayer = true;
+};
+
+/**
+ * The input and lead requests that the AllyBenchmarkGameMode plays back so that every
+ * run of the benchmark does exactly the same thing.
+ *
+ * Scripts are plain text with one entry per line and `#` for comments:
+ *
+ *   duration,<seconds>
+ *   input,<time>,<forward>,<right>,<sprint 0|1>
+ *   lead,<time>,<start waypoint>,<end waypoint>,<wait for player 0|1>
+ */
+struct FOLLOWLEADAI_API FAllyBenchmarkScript
+{
+	// How long, in seconds, the benchmark runs for.
+	float Duration = 60.f;
+
+	// The input keys, sorted by time.
+	TArray<FAllyBenchmarkInputKey> InputKeys;
+
+	// The lead requests, sorted by time.
+	TArray<FAllyBenchmarkLeadRequest> LeadRequests;
+
+	/**
+	 * Returns the script that is used when no script file is given. The PlayerCharacter
+	 * walks a loop, sprints down one side of it, and asks for a lead twice.
+	 */
+	static FAllyBenchmarkScript MakeDefault();
+
+	/**
+	 * Loads a script from a file.
+	 *
+	 * @param Path The path of the script file.
+	 * @param OutScript The loaded script.
+	 *
+	 * @return Whether the file could be read or not.
+	 */
+	static bool LoadFromFile(const FString& Path, FAllyBenchmarkScript& OutScript);
+
+	/**
+	 * Returns the input at a point in time, which is the input of the last key at or before it.
+	 *
+	 * @param Time The time, in seconds since the benchmark started.
+	 * @param OutInput The forward/backward (X) and left/right (Y) axis values.
+	 * @param bOutSprint Whether the PlayerCharacter sprints.
+	 */
+	void SampleInput(float Time, FVector2D& OutInput, bool& bOutSprint) const;
+};
@@ -0,0 +1,92 @@
+#include "AllyFollowLeadSimCommandlet.h"
+#include "AllyBenchmarkScript.h"
+#include "../Ally/AllyFollowLeadSim.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+/**
+ * Reads the simulation settings from command line style parameters and runs it.
+ *
+ * @return The checksum of the final state of the simulation.
+ */
+static uint32 RunAllyFollowLeadSim(const TCHAR* Params, FString& OutReport)
+{
+	FAllyFollowLeadSimSettings Settings = FAllyFollowLeadSimSettings::FromGame();
+	float Seconds = 600.f;
+	FString ScriptPath;
+
+	FParse::Value(Params, TEXT("Seed="), Settings.Seed);
+	FParse::Value(Params, TEXT("Allies="), Settings.NumAllies);
+	FParse::Value(Params, TEXT("Step="), Settings.StepSeconds);
+	FParse::Value(Params, TEXT("Seconds="), Seconds);
+	FParse::Value(Params, TEXT("AllyBenchmarkScript="), ScriptPath);
+	Settings.StepSeconds = FMath::Max(Settings.StepSeconds, KINDA_SMALL_NUMBER);
+
+	FAllyBenchmarkScript Script = FAllyBenchmarkScript::MakeDefault();
+	if (!ScriptPath.IsEmpty() && !FAllyBenchmarkScript::LoadFromFile(ScriptPath, Script))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Couldn't read ally benchmark script %s, using the default script"), *ScriptPath);
+		Script = FAllyBenchmarkScript::MakeDefault();
+	}
+
+	const double StartSeconds = FPlatformTime::Seconds();
+
+	FAllyFollowLeadSim Sim(Settings, Script);
+	Sim.Run(Seconds);
+
+	const double WallSeconds = FMath::Max(FPlatformTime::Seconds() - StartSeconds, 1e-6);
+	const uint32 Checksum = Sim.GetChecksum();
+
+	OutReport = FString::Printf(TEXT("Seed,%d\nAllies,%d\nStepSeconds,%.6f\nSimulatedSeconds,%.2f\nWallSeconds,%.4f\nSpeedup,%.1f\nMsPerStep,%.4f\nMoveRequests,%d\nStateTransitions,%d\nSprintToggles,%d\nSprintTogglesPerAllyPerMinute,%.4f\nWaypointArrivals,%d\nChecksum,%08x\n"),
+		Settings.Seed, Settings.NumAllies, Settings.StepSeconds, Sim.GetTime(), WallSeconds, Sim.GetTime() / WallSeconds,
+		WallSeconds * 1000.0 / FMath::Max(FMath::RoundToInt(Seconds / Settings.StepSeconds), 1),
+		Sim.NumMoveRequests, Sim.NumStateTransitions, Sim.NumSprintToggles,
+		Sim.NumSprintToggles * 60.0 / FMath::Max(Sim.GetTime(), KINDA_SMALL_NUMBER) / FMath::Max(Settings.NumAllies, 1), Sim.NumWaypointArrivals, Checksum);
+
+	return Checksum;
+}
+
+// Runs the simulation in a running game, with the same parameters as the commandlet.
+static FAutoConsoleCommand AllySimRunCommand(
+	TEXT("ally.Sim.Run"),
+	TEXT("Runs the deterministic follow/lead simulation, for example 'ally.Sim.Run Seed=1 Allies=100 Seconds=600'."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		FString Report;
+		RunAllyFollowLeadSim(*FString::Join(Args, TEXT(" ")), Report);
+		UE_LOG(LogTemp, Display, TEXT("Ally follow/lead simulation:\n%s"), *Report);
+	}));
+
+UAllyFollowLeadSimCommandlet::UAllyFollowLeadSimCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+/**
+ * Runs the simulation with the settings given on the command line.
+ */
+int32 UAllyFollowLeadSimCommandlet::Main(const FString& Params)
+{
+	FString Report;
+	const uint32 Checksum = RunAllyFollowLeadSim(*Params, Report);
+
+	UE_LOG(LogTemp, Display, TEXT("Ally follow/lead simulation:\n%s"), *Report);
+
+	FString Name = TEXT("AllyFollowLeadSim");
+	FParse::Value(*Params, TEXT("AllyBenchmarkName="), Name);
+	FFileHelper::SaveStringToFile(TEXT("Metric,Value\n") + Report, *(FPaths::ProjectSavedDir() / TEXT("Benchmarks") / (Name + TEXT("_Summary.csv"))));
+
+	// Compare against a known checksum so that CI can tell when the behavior changed.
+	FString ExpectedChecksum;
+	if (FParse::Value(*Params, TEXT("ExpectedChecksum="), ExpectedChecksum) && FParse::HexNumber(*ExpectedChecksum) != Checksum)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Ally follow/lead simulation checksum %08x doesn't match the expected %s"), Checksum, *ExpectedChecksum);
+		return 1;
+	}
+
+	return 0;
+}
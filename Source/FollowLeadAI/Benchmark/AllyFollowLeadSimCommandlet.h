@@ -0,0 +1,30 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "AllyFollowLeadSimCommandlet.generated.h"
+
+/**
+ * Runs an FAllyFollowLeadSim headless and faster than real time, for example:
+ *
+ *   UE4Editor-Cmd FollowLeadAI.uproject -run=AllyFollowLeadSim -Seed=1 -Allies=500 -Seconds=3600
+ *
+ * It logs how long the simulation took and the checksum of the final state, which
+ * stays the same between builds as long as the follow and lead behavior doesn't change.
+ * `-ExpectedChecksum=` makes the commandlet fail when the checksum is different.
+ */
+UCLASS()
+class FOLLOWLEADAI_API UAllyFollowLeadSimCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UAllyFollowLeadSimCommandlet();
+
+	/**
+	 * Runs the simulation with the settings given on the command line.
+	 *
+	 * @return 0 if the simulation ran and matched `-ExpectedChecksum=` when it was given.
+	 */
+	virtual int32 Main(const FString& Params) override;
+};
@@ -2,4 +2,32 @@
 
 
 #include "FollowLeadAIGameModeBase.h"
+#include "Player/PlayerCharacter.h"
+#include "Engine/World.h"
 
+/**
+ * Sets the default values for the game mode.
+ */
+AFollowLeadAIGameModeBase::AFollowLeadAIGameModeBase()
+{
+	DefaultPawnClass = APlayerCharacter::StaticClass();
+}
+
+/**
+ * Spawns the PlayerCharacter for a player that joined.
+ */
+APawn* AFollowLeadAIGameModeBase::SpawnDefaultPawnAtTransform_Implementation(AController* NewPlayer, const FTransform& SpawnTransform)
+{
+	UClass* PawnClass = GetDefaultPawnClassForController(NewPlayer);
+	if (PawnClass == nullptr) return nullptr;
+
+	APawn* Pawn = GetWorld()->SpawnActorDeferred<APawn>(PawnClass, SpawnTransform, nullptr, GetInstigator(), ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn);
+	if (Pawn == nullptr) return nullptr;
+
+	// The PlayerCharacter auto possesses the first player by default, which is only
+	// meant for the one placed in the level.
+	Pawn->AutoPossessPlayer = EAutoReceiveInput::Disabled;
+	Pawn->FinishSpawning(SpawnTransform);
+
+	return Pawn;
+}
@@ -7,11 +7,21 @@
 #include "FollowLeadAIGameModeBase.generated.h"
 
 /**
- * 
+ * The game mode of the level. Players who join a listen server get a PlayerCharacter
+ * of their own, while the first player keeps using the one placed in the level.
  */
 UCLASS()
 class FOLLOWLEADAI_API AFollowLeadAIGameModeBase : public AGameModeBase
 {
 	GENERATED_BODY()
-	
+
+public:
+	// Sets default values for this game mode's properties.
+	AFollowLeadAIGameModeBase();
+
+	/**
+	 * Spawns the PlayerCharacter for a player that joined, without it trying to take
+	 * over the first player the way the PlayerCharacter placed in the level does.
+	 */
+	virtual APawn* SpawnDefaultPawnAtTransform_Implementation(AController* NewPlayer, const FTransform& SpawnTransform) override;
 };
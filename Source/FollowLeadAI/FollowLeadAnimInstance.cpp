@@ -0,0 +1,67 @@
+#include "FollowLeadAnimInstance.h"
+#include "Math/Rotator.h"
+#include "Components/CapsuleComponent.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/CharacterMovementComponent.h"
+
+/**
+ * Called on the game thread to copy what the update needs from the character.
+ */
+void FFollowLeadAnimInstanceProxy::PreUpdate(UAnimInstance* InAnimInstance, float DeltaSeconds)
+{
+	Super::PreUpdate(InAnimInstance, DeltaSeconds);
+
+	bHasSnapshot = false;
+
+	// Use the character that the FollowLeadAnimInstance found when it was initialized
+	// instead of getting and casting the Pawn being animated every frame.
+	const UFollowLeadAnimInstance* FollowLeadAnimInstance = CastChecked<UFollowLeadAnimInstance>(InAnimInstance);
+	const ACharacter* Character = FollowLeadAnimInstance->Character;
+	if (Character == nullptr || !FollowLeadAnimInstance->ShouldUpdateProperties()) return;
+
+	bHasSnapshot = true;
+	Velocity = Character->GetCharacterMovement()->Velocity;
+	CapsuleRotation = Character->GetCapsuleComponent()->GetComponentRotation();
+	bWasSprinting = FollowLeadAnimInstance->IsCharacterSprinting();
+}
+
+/**
+ * Called on a worker thread to work out the animation properties.
+ */
+void FFollowLeadAnimInstanceProxy::Update(float DeltaSeconds)
+{
+	Super::Update(DeltaSeconds);
+
+	if (!bHasSnapshot) return;
+
+	// Un-rotate the character's normalized velocity by its CapsuleComponent rotation.
+	const FVector VelocityUnrotated = CapsuleRotation.UnrotateVector(Velocity.GetSafeNormal());
+
+	// Set the animation properties based on the unrotated velocity.
+	bIsMoving = VelocityUnrotated.X > 0.1 || VelocityUnrotated.Y > 0.1;
+	bIsSprinting = bWasSprinting;
+}
+
+/**
+ * Called on the game thread to copy the animation properties back to the FollowLeadAnimInstance.
+ */
+void FFollowLeadAnimInstanceProxy::PostUpdate(UAnimInstance* InAnimInstance) const
+{
+	Super::PostUpdate(InAnimInstance);
+
+	if (!bHasSnapshot) return;
+
+	UFollowLeadAnimInstance* FollowLeadAnimInstance = CastChecked<UFollowLeadAnimInstance>(InAnimInstance);
+	FollowLeadAnimInstance->bIsMoving = bIsMoving;
+	FollowLeadAnimInstance->bIsSprinting = bIsSprinting;
+}
+
+/**
+ * Called when the FollowLeadAnimInstance is created to find the character it animates.
+ */
+void UFollowLeadAnimInstance::NativeInitializeAnimation()
+{
+	Super::NativeInitializeAnimation();
+
+	Character = Cast<ACharacter>(TryGetPawnOwner());
+}
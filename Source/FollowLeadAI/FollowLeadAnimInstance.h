@@ -0,0 +1,119 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Animation/AnimInstance.h"
+#include "Animation/AnimInstanceProxy.h"
+#include "FollowLeadAnimInstance.generated.h"
+
+class ACharacter;
+
+/**
+ * Does the work of updating a FollowLeadAnimInstance's animation properties on a worker
+ * thread. The character's velocity, rotation, and sprint state are copied once on the
+ * game thread before the update and the results are copied back after it.
+ */
+USTRUCT()
+struct FOLLOWLEADAI_API FFollowLeadAnimInstanceProxy : public FAnimInstanceProxy
+{
+	GENERATED_BODY()
+
+public:
+	FFollowLeadAnimInstanceProxy() {}
+	FFollowLeadAnimInstanceProxy(UAnimInstance* InAnimInstance) : FAnimInstanceProxy(InAnimInstance) {}
+
+protected:
+	/**
+	 * Called on the game thread to copy what the update needs from the character.
+	 */
+	virtual void PreUpdate(UAnimInstance* InAnimInstance, float DeltaSeconds) override;
+
+	/**
+	 * Called on a worker thread to work out the animation properties.
+	 */
+	virtual void Update(float DeltaSeconds) override;
+
+	/**
+	 * Called on the game thread to copy the animation properties back to the FollowLeadAnimInstance.
+	 */
+	virtual void PostUpdate(UAnimInstance* InAnimInstance) const override;
+
+private:
+	// Indicates whether the snapshot below was taken this frame or not.
+	bool bHasSnapshot = false;
+
+	// The character's velocity when the snapshot was taken.
+	FVector Velocity = FVector::ZeroVector;
+
+	// The rotation of the character's CapsuleComponent when the snapshot was taken.
+	FRotator CapsuleRotation = FRotator::ZeroRotator;
+
+	// Indicates whether the character was sprinting when the snapshot was taken.
+	bool bWasSprinting = false;
+
+	// The animation properties worked out by the last update.
+	bool bIsMoving = false;
+	bool bIsSprinting = false;
+};
+
+/**
+ * Manages the booleans needed by the animation blueprints of the AllyCharacter and the
+ * PlayerCharacter to decide what animation needs to be run.
+ */
+UCLASS(Abstract)
+class FOLLOWLEADAI_API UFollowLeadAnimInstance : public UAnimInstance
+{
+	GENERATED_BODY()
+
+	// The proxy reads the character and writes the animation properties below.
+	friend struct FFollowLeadAnimInstanceProxy;
+
+public:
+	// Indicates whether the character is moving in any direction or not.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bIsMoving;
+
+	// Indicates whether the character is sprinting or not.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bIsSprinting;
+
+	// The animation properties are updated by the FFollowLeadAnimInstanceProxy on a worker
+	// thread so this does nothing. It is only kept so that existing animation blueprints still
+	// load, and should be removed from their event graphs.
+	UFUNCTION(BlueprintCallable, Category = "UpdateAnimationProperties", meta = (DeprecatedFunction, DeprecationMessage = "The animation properties are updated on a worker thread, remove this call."))
+	void UpdateAnimationProperties() {}
+
+protected:
+	/**
+	 * Called when the FollowLeadAnimInstance is created to find the character it animates.
+	 */
+	virtual void NativeInitializeAnimation() override;
+
+	/**
+	 * Returns the proxy that updates the animation properties on a worker thread.
+	 */
+	virtual FAnimInstanceProxy* CreateAnimInstanceProxy() override { return &Proxy; }
+
+	/**
+	 * The proxy is owned by the FollowLeadAnimInstance so there is nothing to destroy.
+	 */
+	virtual void DestroyAnimInstanceProxy(FAnimInstanceProxy* InProxy) override {}
+
+	/**
+	 * Returns whether the animation properties should be updated this frame.
+	 */
+	virtual bool ShouldUpdateProperties() const { return true; }
+
+	/**
+	 * Returns whether the character being animated is sprinting.
+	 */
+	virtual bool IsCharacterSprinting() const { return false; }
+
+	// The character being animated, found once instead of every frame.
+	UPROPERTY(Transient)
+	ACharacter* Character;
+
+private:
+	// The proxy that updates the animation properties on a worker thread.
+	UPROPERTY(Transient)
+	FFollowLeadAnimInstanceProxy Proxy;
+};
@@ -1,29 +1,33 @@
 #pragma once
 
 #include "CoreMinimal.h"
-#include "Animation/AnimInstance.h"
+#include "../FollowLeadAnimInstance.h"
 #include "PlayerAnimInstance.generated.h"
 
+class APlayerCharacter;
+
 /**
  * Manages the booleans needed by the animation blueprint to decide what animation
  * needs to be run.
  */
 UCLASS()
-class FOLLOWLEADAI_API UPlayerAnimInstance : public UAnimInstance
+class FOLLOWLEADAI_API UPlayerAnimInstance : public UFollowLeadAnimInstance
 {
 	GENERATED_BODY()
 
-public:
-	// Indicates whether the PlayerCharacter is moving in any direction or not.
-	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	bool bIsMoving;
+protected:
+	/**
+	 * Called when the PlayerAnimInstance is created to find the PlayerCharacter it animates.
+	 */
+	virtual void NativeInitializeAnimation() override;
 
-	// Indicates whether the PlayerCharacter is sprinting or not.
-	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	bool bIsSprinting;
+	/**
+	 * Returns whether the PlayerCharacter is sprinting.
+	 */
+	virtual bool IsCharacterSprinting() const override;
 
-	// Used by the animation blueprint to update the animation properties above
-	// and decide what animations to play.
-	UFUNCTION(BlueprintCallable, Category = "UpdateAnimationProperties")
-	void UpdateAnimationProperties();
+private:
+	// The PlayerCharacter being animated, found once instead of every frame.
+	UPROPERTY(Transient)
+	APlayerCharacter* PlayerCharacter;
 };
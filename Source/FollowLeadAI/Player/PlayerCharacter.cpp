@@ -1,26 +1,35 @@
 #include "PlayerCharacter.h"
+#include "../Ally/AllyAssetSubsystem.h"
+#include "../Ally/AllyAssignmentSubsystem.h"
+#include "../Ally/AllyEntitySubsystem.h"
 #include "Camera/CameraComponent.h"
 #include "Components/InputComponent.h"
 #include "Components/CapsuleComponent.h"
 #include "Components/SkeletalMeshComponent.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
 #include "GameFramework/Controller.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "GameFramework/SpringArmComponent.h"
+#include "HAL/IConsoleManager.h"
+#include "Net/UnrealNetwork.h"
+
+// How often, in seconds, the PlayerCharacter's movement is sampled for allies to predict from.
+static TAutoConsoleVariable<float> CVarAllyFollowSampleInterval(
+	TEXT("ally.Follow.SampleInterval"),
+	0.05f,
+	TEXT("How often the PlayerCharacter's location and velocity are sampled for predictive following. The last 16 samples are kept."),
+	ECVF_Default);
 
 /**
  * Sets the default values for the PlayerCharacter.
  */
 APlayerCharacter::APlayerCharacter()
 {
-	// Load the resources needed for the PlayerCharacter.
-	static ConstructorHelpers::FObjectFinder<USkeletalMesh>PlayerSkeletalMeshAsset(TEXT("SkeletalMesh'/Game/Mannequin/Character/Mesh/SK_Mannequin.SK_Mannequin'"));
-	static ConstructorHelpers::FObjectFinder<UAnimBlueprint>PlayerAnimBlueprint(TEXT("AnimBlueprint'/Game/Blueprints/PlayerAnimBlueprint.PlayerAnimBlueprint'"));
-
-	// Set the SkeletalMeshComponent to the Character's mesh and adjust its properties.
+	// Set the SkeletalMeshComponent to the Character's mesh and adjust its properties. The
+	// mesh and animations themselves come from the AllyAssetSubsystem when play begins.
 	PlayerSkeletalMesh = GetMesh();
-	PlayerSkeletalMesh->SetSkeletalMesh(PlayerSkeletalMeshAsset.Object);
 	PlayerSkeletalMesh->SetRelativeLocationAndRotation(FVector(0.f, 0.f, -90.f), FRotator(0.f, -90.f, 0.f));
-	PlayerSkeletalMesh->SetAnimInstanceClass(PlayerAnimBlueprint.Object->GeneratedClass);
 
 	// Create the SpringArmComponent and attach it to the RootComponent.
 	PlayerCameraSpringArm = CreateDefaultSubobject<USpringArmComponent>(TEXT("PlayerCameraSpringArm"));
@@ -50,6 +59,102 @@ APlayerCharacter::APlayerCharacter()
 	AutoPossessPlayer = EAutoReceiveInput::Player0;
 }
 
+/**
+ * Called when the PlayerCharacter is created.
+ */
+void APlayerCharacter::BeginPlay()
+{
+	Super::BeginPlay();
+
+	UGameInstance* GameInstance = GetGameInstance();
+	UAllyAssetSubsystem* AllyAssets = GameInstance != nullptr ? GameInstance->GetSubsystem<UAllyAssetSubsystem>() : nullptr;
+	if (AllyAssets != nullptr) AllyAssets->ApplyPlayerAssets(PlayerSkeletalMesh);
+}
+
+/**
+ * Called when the PlayerCharacter is removed from the world.
+ *
+ * @param EndPlayReason Why the PlayerCharacter is being removed.
+ */
+void APlayerCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UAllyAssignmentSubsystem* AllyAssignment = GetWorld() != nullptr ? GetWorld()->GetSubsystem<UAllyAssignmentSubsystem>() : nullptr;
+	if (AllyAssignment != nullptr) AllyAssignment->UnregisterPlayer(this);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+/**
+ * Called on the server when a controller takes control of the PlayerCharacter.
+ *
+ * @param NewController The controller that now controls the PlayerCharacter.
+ */
+void APlayerCharacter::PossessedBy(AController* NewController)
+{
+	Super::PossessedBy(NewController);
+
+	// Allies are only controlled on the server so that's the only place they need to
+	// know about the PlayerCharacters they can be assigned to, and a PlayerCharacter that
+	// nobody controls, like one left in the level, shouldn't have any allies.
+	if (!HasAuthority()) return;
+
+	UAllyAssignmentSubsystem* AllyAssignment = GetWorld()->GetSubsystem<UAllyAssignmentSubsystem>();
+	if (AllyAssignment != nullptr) AllyAssignment->RegisterPlayer(this);
+}
+
+/**
+ * Called on the server when the controller lets go of the PlayerCharacter.
+ */
+void APlayerCharacter::UnPossessed()
+{
+	UAllyAssignmentSubsystem* AllyAssignment = GetWorld() != nullptr ? GetWorld()->GetSubsystem<UAllyAssignmentSubsystem>() : nullptr;
+	if (AllyAssignment != nullptr) AllyAssignment->UnregisterPlayer(this);
+
+	Super::UnPossessed();
+}
+
+/**
+ * Called every frame.
+ *
+ * @param DeltaTime The time since the last frame.
+ */
+void APlayerCharacter::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	// Keep a short history of the PlayerCharacter's movement for allies that aim for
+	// where the PlayerCharacter is going instead of where they are.
+	const float Now = GetWorld()->GetTimeSeconds();
+	if (Now - LastMotionSampleTime >= CVarAllyFollowSampleInterval.GetValueOnGameThread())
+	{
+		LastMotionSampleTime = Now;
+		MotionHistory.AddSample(Now, GetActorLocation(), GetVelocity());
+	}
+
+	// Input is processed before the PlayerCharacter ticks, so both axes have been read by
+	// now and whether the PlayerCharacter is moving is only decided once per frame.
+	if (IsLocallyControlled())
+	{
+		UpdateIsMoving();
+	}
+	// The server only gets the input of its own PlayerCharacter, so for the ones controlled
+	// by remote clients it has to decide whether they are moving from their velocity.
+	else if (HasAuthority() && GetController() != nullptr)
+	{
+		SetIsMoving(GetVelocity().SizeSquared2D() > FMath::Square(RemoteMovingSpeedThreshold));
+	}
+}
+
+/**
+ * Called to set up the properties that are replicated to clients.
+ */
+void APlayerCharacter::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME_CONDITION(APlayerCharacter, bIsSprinting, COND_SkipOwner);
+}
+
 /**
  * Called to bind functionality to input.
  *
@@ -84,6 +189,11 @@ void APlayerCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInputCom
  */
 void APlayerCharacter::MoveForwardBackward(float Value)
 {
+	if (bHasScriptedInput) Value = ScriptedInput.X;
+
+	// Keep track of the input so we know when the PlayerCharacter starts or stops moving.
+	ForwardBackwardInput = GetController() != nullptr ? Value : 0.f;
+
 	// Return early if the Controller is a nullptr or the axis input value is zero.
 	if (GetController() == nullptr || Value == 0.f) return;
 
@@ -106,6 +216,11 @@ void APlayerCharacter::MoveForwardBackward(float Value)
  */
 void APlayerCharacter::MoveLeftRight(float Value)
 {
+	if (bHasScriptedInput) Value = ScriptedInput.Y;
+
+	// Keep track of the input so we know when the PlayerCharacter starts or stops moving.
+	LeftRightInput = GetController() != nullptr ? Value : 0.f;
+
 	// Return early if the Controller is a nullptr or the `Value` is zero.
 	if (GetController() == nullptr || Value == 0.f) return;
 
@@ -120,6 +235,66 @@ void APlayerCharacter::MoveLeftRight(float Value)
 	AddMovementInput(Direction, Value);
  }
 
+/**
+ * Called once per tick, after both movement axes are updated, to broadcast
+ * `OnPlayerMovingChanged` if the PlayerCharacter started or stopped moving.
+ */
+void APlayerCharacter::UpdateIsMoving()
+{
+	SetIsMoving(ForwardBackwardInput != 0.f || LeftRightInput != 0.f);
+}
+
+/**
+ * Sets `bIsMoving` and broadcasts `OnPlayerMovingChanged` if it changed.
+ *
+ * @param bIsMovingNow Whether the PlayerCharacter is moving now.
+ */
+void APlayerCharacter::SetIsMoving(bool bIsMovingNow)
+{
+	if (bIsMovingNow == bIsMoving) return;
+
+	bIsMoving = bIsMovingNow;
+	OnPlayerMovingChanged.Broadcast(bIsMoving);
+}
+
+/**
+ * Drives the PlayerCharacter with scripted input instead of the player's input.
+ *
+ * @param Input The forward/backward (X) and left/right (Y) axis values.
+ * @param bSprint Whether the PlayerCharacter should be sprinting.
+ */
+void APlayerCharacter::SetScriptedInput(const FVector2D& Input, bool bSprint)
+{
+	bHasScriptedInput = true;
+	ScriptedInput = Input;
+
+	// The axis callbacks pick `ScriptedInput` up on the next input update but sprinting
+	// is an action so it is started or stopped straight away.
+	if (bSprint && !bIsSprinting) SprintStart();
+	else if (!bSprint && bIsSprinting) SprintStop();
+}
+
+/**
+ * Gives control of the PlayerCharacter back to the player's input.
+ */
+void APlayerCharacter::ClearScriptedInput()
+{
+	bHasScriptedInput = false;
+	ScriptedInput = FVector2D::ZeroVector;
+}
+
+/**
+ * Returns where the PlayerCharacter will be after some time if they keep moving the way they have been.
+ *
+ * @param Horizon How far ahead, in seconds, to predict.
+ */
+FVector APlayerCharacter::PredictLocation(float Horizon) const
+{
+	if (MotionHistory.Num() == 0) return GetActorLocation();
+
+	return MotionHistory.PredictLocation(Horizon, FMath::Max(WalkSpeed, SprintSpeed));
+}
+
 /**
  * Called when the sprint input action button is pressed down and it sets the
  * `bIsSprinting` boolean to `true` so the animator knows to play the sprint animation.
@@ -128,6 +303,8 @@ void APlayerCharacter::SprintStart()
 {
 	bIsSprinting = true;
 	if (GetCharacterMovement()) GetCharacterMovement()->MaxWalkSpeed = SprintSpeed;
+
+	if (!HasAuthority()) ServerSetSprinting(true);
 }
 
 /**
@@ -138,6 +315,8 @@ void APlayerCharacter::SprintStop()
 {
 	bIsSprinting = false;
 	if (GetCharacterMovement()) GetCharacterMovement()->MaxWalkSpeed = WalkSpeed;
+
+	if (!HasAuthority()) ServerSetSprinting(false);
 }
 
 /**
@@ -146,6 +325,61 @@ void APlayerCharacter::SprintStop()
 void APlayerCharacter::LeadAction()
 {
 	// Make the AllyCharacter lead the PlayerCharacter from the first waypoint to the
-	// second waypoint and waiting for the PlayerCharacter to be in range.
-	OnAllyLeadRequest.Broadcast(0, 1, true);
+	// second waypoint and waiting for the PlayerCharacter to be in range. The AllyAIControllers
+	// only exist on the server so a client has to ask the server to do it.
+	if (!HasAuthority())
+	{
+		ServerRequestAllyLead(0, 1, true);
+		return;
+	}
+
+	RequestAllyLead(0, 1, true);
+}
+
+/**
+ * Makes every ally of the PlayerCharacter lead, including the ones that are currently
+ * lightweight entities.
+ *
+ * @param StartWaypoint The `WaypointNumber` of the WaypointActor to start leading from.
+ * @param EndWaypoint The `WaypointNumber` of the WaypointActor to stop leading at.
+ * @param bShouldWaitForPlayer Whether the allies wait for the PlayerCharacter while leading.
+ */
+void APlayerCharacter::RequestAllyLead(int32 StartWaypoint, int32 EndWaypoint, bool bShouldWaitForPlayer)
+{
+	OnAllyLeadRequest.Broadcast(StartWaypoint, EndWaypoint, bShouldWaitForPlayer);
+
+	// Entities aren't AllyAIControllers so they can't bind to `OnAllyLeadRequest`.
+	UAllyEntitySubsystem* EntitySubsystem = GetWorld()->GetSubsystem<UAllyEntitySubsystem>();
+	if (EntitySubsystem != nullptr) EntitySubsystem->MakeEntitiesLead(this, StartWaypoint, EndWaypoint, bShouldWaitForPlayer);
+}
+
+/**
+ * Asks the server to make the AllyCharacters lead.
+ *
+ * @param StartWaypoint The `WaypointNumber` of the WaypointActor to start leading from.
+ * @param EndWaypoint The `WaypointNumber` of the WaypointActor to stop leading at.
+ * @param bShouldWaitForPlayer Whether the AllyCharacters wait for the PlayerCharacter while leading.
+ */
+void APlayerCharacter::ServerRequestAllyLead_Implementation(int32 StartWaypoint, int32 EndWaypoint, bool bShouldWaitForPlayer)
+{
+	RequestAllyLead(StartWaypoint, EndWaypoint, bShouldWaitForPlayer);
+}
+
+/**
+ * Rejects lead requests with waypoints that can't exist.
+ */
+bool APlayerCharacter::ServerRequestAllyLead_Validate(int32 StartWaypoint, int32 EndWaypoint, bool bShouldWaitForPlayer)
+{
+	return StartWaypoint >= 0 && EndWaypoint >= 0;
+}
+
+/**
+ * Tells the server that the PlayerCharacter started or stopped sprinting.
+ *
+ * @param bSprint Whether the PlayerCharacter is sprinting.
+ */
+void APlayerCharacter::ServerSetSprinting_Implementation(bool bSprint)
+{
+	if (bSprint) SprintStart();
+	else SprintStop();
 }
\ No newline at end of file
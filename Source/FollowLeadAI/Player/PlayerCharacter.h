@@ -2,12 +2,17 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
+#include "PlayerMotionHistory.h"
 #include "PlayerCharacter.generated.h"
 
 // Creates a delegate that's used to tell the AllyAIController to make
 // the AllyCharacter lead the way.
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FAllyLeadRequest, int32, StartWaypoint, int32, EndWaypoint, bool, bShouldWaitForPlayer);
 
+// Creates a delegate that's used to tell the AllyAIController when the
+// PlayerCharacter starts or stops moving.
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FPlayerMovingChanged, bool, bIsMoving);
+
 /**
  * PlayerCharacter is the main Character of the game controlled by the player.
  */
@@ -32,8 +37,9 @@ public:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Camera)
 	class USpringArmComponent* PlayerCameraSpringArm;
 
-	// Indicates whether the PlayerCharacter is sprinting or not.
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Animation)
+	// Indicates whether the PlayerCharacter is sprinting or not. This is replicated so
+	// that other clients play the sprint animation too.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Replicated, Category = Animation)
 	bool bIsSprinting = false;
 
 	// Broadcast when the PlayerCharacter triggers an object in the level that
@@ -42,6 +48,62 @@ public:
 	UPROPERTY(BlueprintAssignable, Category = "StateEvents")
 	FAllyLeadRequest OnAllyLeadRequest;
 
+	// Indicates whether the PlayerCharacter is being moved by input or not.
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Movement)
+	bool bIsMoving = false;
+
+	// Broadcast in the same frame that the PlayerCharacter starts or stops moving
+	// so that the AllyCharacter can react without having to keep checking.
+	UPROPERTY(BlueprintAssignable, Category = "StateEvents")
+	FPlayerMovingChanged OnPlayerMovingChanged;
+
+	/**
+	 * Drives the PlayerCharacter with scripted input instead of the player's input,
+	 * which is used by the AllyBenchmarkGameMode to replay the same path every run.
+	 *
+	 * @param Input The forward/backward (X) and left/right (Y) axis values.
+	 * @param bSprint Whether the PlayerCharacter should be sprinting.
+	 */
+	void SetScriptedInput(const FVector2D& Input, bool bSprint);
+
+	/**
+	 * Gives control of the PlayerCharacter back to the player's input.
+	 */
+	void ClearScriptedInput();
+
+	/**
+	 * Makes every ally of the PlayerCharacter lead, including the ones that are currently
+	 * lightweight entities. This must be called on the server.
+	 *
+	 * @param StartWaypoint The `WaypointNumber` of the WaypointActor to start leading from.
+	 * @param EndWaypoint The `WaypointNumber` of the WaypointActor to stop leading at.
+	 * @param bShouldWaitForPlayer Whether the allies wait for the PlayerCharacter while leading.
+	 */
+	void RequestAllyLead(int32 StartWaypoint, int32 EndWaypoint, bool bShouldWaitForPlayer);
+
+	/**
+	 * Returns where the PlayerCharacter will be after some time if they keep moving the
+	 * way they have been, based on their recent `MotionHistory`.
+	 *
+	 * @param Horizon How far ahead, in seconds, to predict.
+	 */
+	FVector PredictLocation(float Horizon) const;
+
+	/**
+	 * Returns the PlayerCharacter's recent movement.
+	 */
+	const FPlayerMotionHistory& GetMotionHistory() const { return MotionHistory; }
+
+	/**
+	 * Returns the speed at which the PlayerCharacter walks.
+	 */
+	float GetWalkSpeed() const { return WalkSpeed; }
+
+	/**
+	 * Returns the speed at which the PlayerCharacter sprints.
+	 */
+	float GetSprintSpeed() const { return SprintSpeed; }
+
 protected:
 	// The speed at which the PlayerCharacter should walk at.
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Movement)
@@ -51,7 +113,66 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Movement)
 	float SprintSpeed = 500.f;
 
+	// How fast, in units per second, a PlayerCharacter controlled by a remote client has to
+	// be moving for the server to count them as moving, since the server never sees their input.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Movement)
+	float RemoteMovingSpeedThreshold = 10.f;
+
+	// The last value of the "MoveForwardBackward" axis input.
+	float ForwardBackwardInput = 0.f;
+
+	// The last value of the "MoveLeftRight" axis input.
+	float LeftRightInput = 0.f;
+
+	// Indicates whether the PlayerCharacter is being driven by `ScriptedInput`.
+	bool bHasScriptedInput = false;
+
+	// The axis values used instead of the player's input while `bHasScriptedInput` is true.
+	FVector2D ScriptedInput = FVector2D::ZeroVector;
+
+	// The PlayerCharacter's recent locations and velocities, sampled every `ally.Follow.SampleInterval`.
+	FPlayerMotionHistory MotionHistory;
+
+	// The world time at which the last sample was added to `MotionHistory`.
+	float LastMotionSampleTime = -MAX_FLT;
+
 protected:
+	/**
+	 * Called when the PlayerCharacter is created.
+	 */
+	virtual void BeginPlay() override;
+
+	/**
+	 * Called when the PlayerCharacter is removed from the world.
+	 *
+	 * @param EndPlayReason Why the PlayerCharacter is being removed.
+	 */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/**
+	 * Called on the server when a controller takes control of the PlayerCharacter.
+	 *
+	 * @param NewController The controller that now controls the PlayerCharacter.
+	 */
+	virtual void PossessedBy(AController* NewController) override;
+
+	/**
+	 * Called on the server when the controller lets go of the PlayerCharacter.
+	 */
+	virtual void UnPossessed() override;
+
+	/**
+	 * Called every frame.
+	 *
+	 * @param DeltaTime The time since the last frame.
+	 */
+	virtual void Tick(float DeltaTime) override;
+
+	/**
+	 * Called to set up the properties that are replicated to clients.
+	 */
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
 	/**
 	 * Called when the PlayerCamera moves forward and backward.
      *
@@ -66,6 +187,19 @@ protected:
 	 */
 	void MoveLeftRight(float Value);
 
+	/**
+	 * Called once per tick, after both movement axes are updated, to broadcast
+	 * `OnPlayerMovingChanged` if the PlayerCharacter started or stopped moving.
+	 */
+	void UpdateIsMoving();
+
+	/**
+	 * Sets `bIsMoving` and broadcasts `OnPlayerMovingChanged` if it changed.
+	 *
+	 * @param bIsMovingNow Whether the PlayerCharacter is moving now.
+	 */
+	void SetIsMoving(bool bIsMovingNow);
+
 	/**
 	 * Called when the sprint input action button is pressed down.
 	 */
@@ -81,6 +215,25 @@ protected:
 	  */
 	void LeadAction();
 
+	/**
+	 * Asks the server to make the AllyCharacters lead, since they are only controlled there.
+	 *
+	 * @param StartWaypoint The `WaypointNumber` of the WaypointActor to start leading from.
+	 * @param EndWaypoint The `WaypointNumber` of the WaypointActor to stop leading at.
+	 * @param bShouldWaitForPlayer Whether the AllyCharacters wait for the PlayerCharacter while leading.
+	 */
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerRequestAllyLead(int32 StartWaypoint, int32 EndWaypoint, bool bShouldWaitForPlayer);
+
+	/**
+	 * Tells the server that the PlayerCharacter started or stopped sprinting so that the
+	 * server moves them at the same speed as the client does.
+	 *
+	 * @param bSprint Whether the PlayerCharacter is sprinting.
+	 */
+	UFUNCTION(Server, Reliable)
+	void ServerSetSprinting(bool bSprint);
+
 	/**
 	 * Called to bind functionality to input.
 	 *
@@ -0,0 +1,92 @@
+#include "PlayerMotionHistory.h"
+
+/**
+ * Adds a sample, replacing the oldest one once the buffer is full.
+ *
+ * @param Time The world time the sample was taken at.
+ * @param Location The location of the PlayerCharacter.
+ * @param Velocity The velocity of the PlayerCharacter.
+ */
+void FPlayerMotionHistory::AddSample(float Time, const FVector& Location, const FVector& Velocity)
+{
+	Head = (Head + 1) % Capacity;
+	Count = FMath::Min(Count + 1, Capacity);
+
+	Samples[Head].Time = Time;
+	Samples[Head].Location = Location;
+	Samples[Head].Velocity = Velocity;
+}
+
+/**
+ * Removes every sample.
+ */
+void FPlayerMotionHistory::Reset()
+{
+	Head = INDEX_NONE;
+	Count = 0;
+}
+
+/**
+ * Returns the newest sample.
+ */
+const FPlayerMotionSample& FPlayerMotionHistory::GetNewest() const
+{
+	check(Count > 0);
+	return Samples[Head];
+}
+
+/**
+ * Returns the oldest sample.
+ */
+const FPlayerMotionSample& FPlayerMotionHistory::GetOldest() const
+{
+	check(Count > 0);
+	return Samples[(Head - Count + 1 + Capacity) % Capacity];
+}
+
+/**
+ * Returns the average acceleration of the PlayerCharacter across every sample in the buffer.
+ */
+FVector FPlayerMotionHistory::GetAverageAcceleration() const
+{
+	if (Count < 2) return FVector::ZeroVector;
+
+	// Comparing the ends of the buffer, rather than neighbouring samples, smooths out the
+	// frame to frame noise in the CharacterMovementComponent's velocity.
+	const FPlayerMotionSample& Newest = GetNewest();
+	const FPlayerMotionSample& Oldest = GetOldest();
+
+	const float Duration = Newest.Time - Oldest.Time;
+	if (Duration <= KINDA_SMALL_NUMBER) return FVector::ZeroVector;
+
+	return (Newest.Velocity - Oldest.Velocity) / Duration;
+}
+
+/**
+ * Returns where the PlayerCharacter will be after some time if it keeps moving the way it has been.
+ *
+ * @param Horizon How far ahead, in seconds, to predict.
+ * @param MaxSpeed The fastest the PlayerCharacter can move, which caps how far ahead the prediction can be.
+ */
+FVector FPlayerMotionHistory::PredictLocation(float Horizon, float MaxSpeed) const
+{
+	if (Count == 0) return FVector::ZeroVector;
+
+	const FPlayerMotionSample& Newest = GetNewest();
+	if (Horizon <= 0.f) return Newest.Location;
+
+	// The prediction stays on the ground since the PlayerCharacter can't fly.
+	FVector Velocity = Newest.Velocity;
+	FVector Acceleration = GetAverageAcceleration();
+	Velocity.Z = 0.f;
+	Acceleration.Z = 0.f;
+
+	FVector Offset = Velocity * Horizon + 0.5f * Acceleration * Horizon * Horizon;
+
+	// A PlayerCharacter that is standing still or slowing down stops where they are instead
+	// of turning around, and one that is speeding up can't go faster than it is able to.
+	if (Velocity.IsNearlyZero() || (Offset | Velocity) < 0.f) return Newest.Location;
+	Offset = Offset.GetClampedToMaxSize2D(MaxSpeed * Horizon);
+
+	return Newest.Location + Offset;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Where a PlayerCharacter was and how fast it was moving at one point in time.
+ */
+struct FOLLOWLEADAI_API FPlayerMotionSample
+{
+	// The world time the sample was taken at.
+	float Time = 0.f;
+
+	// The location of the PlayerCharacter.
+	FVector Location = FVector::ZeroVector;
+
+	// The velocity of the PlayerCharacter's CharacterMovementComponent.
+	FVector Velocity = FVector::ZeroVector;
+};
+
+/**
+ * A small ring buffer of the PlayerCharacter's recent movement that allies use to aim
+ * for where the PlayerCharacter is going to be instead of where they are right now.
+ */
+struct FOLLOWLEADAI_API FPlayerMotionHistory
+{
+	// The number of samples that are kept.
+	static constexpr int32 Capacity = 16;
+
+	/**
+	 * Adds a sample, replacing the oldest one once the buffer is full.
+	 *
+	 * @param Time The world time the sample was taken at.
+	 * @param Location The location of the PlayerCharacter.
+	 * @param Velocity The velocity of the PlayerCharacter.
+	 */
+	void AddSample(float Time, const FVector& Location, const FVector& Velocity);
+
+	/**
+	 * Removes every sample.
+	 */
+	void Reset();
+
+	/**
+	 * Returns the number of samples in the buffer.
+	 */
+	int32 Num() const { return Count; }
+
+	/**
+	 * Returns the newest sample. The buffer must not be empty.
+	 */
+	const FPlayerMotionSample& GetNewest() const;
+
+	/**
+	 * Returns the average acceleration of the PlayerCharacter across every sample in the buffer.
+	 */
+	FVector GetAverageAcceleration() const;
+
+	/**
+	 * Returns where the PlayerCharacter will be after some time if it keeps moving and
+	 * speeding up or slowing down the way it has been.
+	 *
+	 * @param Horizon How far ahead, in seconds, to predict.
+	 * @param MaxSpeed The fastest the PlayerCharacter can move, which caps how far ahead the prediction can be.
+	 */
+	FVector PredictLocation(float Horizon, float MaxSpeed) const;
+
+private:
+	// The samples, with the newest one at `Head`.
+	FPlayerMotionSample Samples[Capacity];
+
+	// The index of the newest sample.
+	int32 Head = INDEX_NONE;
+
+	// The number of samples in the buffer.
+	int32 Count = 0;
+
+	/**
+	 * Returns the oldest sample. The buffer must not be empty.
+	 */
+	const FPlayerMotionSample& GetOldest() const;
+};
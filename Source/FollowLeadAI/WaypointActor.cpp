@@ -1,5 +1,7 @@
 #include "WaypointActor.h"
+#include "WaypointRegistrySubsystem.h"
 #include "Components/BoxComponent.h"
+#include "Engine/World.h"
 
 /**
  * Sets the default values for the WaypointActor.
@@ -12,3 +14,28 @@ AWaypointActor::AWaypointActor()
 	WaypointBoxCollider->SetBoxExtent(FVector(90.f, 90.f, 90.f));
 	WaypointBoxCollider->SetupAttachment(RootComponent);
 }
+
+/**
+ * Called when the WaypointActor is added to the level.
+ */
+void AWaypointActor::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Add this WaypointActor to the registry that every AllyCharacter looks waypoints up in.
+	UWaypointRegistrySubsystem* WaypointRegistry = GetWorld()->GetSubsystem<UWaypointRegistrySubsystem>();
+	if (WaypointRegistry != nullptr) WaypointRegistry->RegisterWaypoint(this);
+}
+
+/**
+ * Called when the WaypointActor is removed from the level.
+ *
+ * @param EndPlayReason Why the WaypointActor is being removed.
+ */
+void AWaypointActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UWaypointRegistrySubsystem* WaypointRegistry = GetWorld()->GetSubsystem<UWaypointRegistrySubsystem>();
+	if (WaypointRegistry != nullptr) WaypointRegistry->UnregisterWaypoint(this);
+
+	Super::EndPlay(EndPlayReason);
+}
@@ -22,4 +22,17 @@ public:
 	// follow waypoints in order.
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Waypoint)
 	int32 WaypointNumber = 0;
+
+protected:
+	/**
+	 * Called when the WaypointActor is added to the level.
+	 */
+	virtual void BeginPlay() override;
+
+	/**
+	 * Called when the WaypointActor is removed from the level.
+	 *
+	 * @param EndPlayReason Why the WaypointActor is being removed.
+	 */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 };
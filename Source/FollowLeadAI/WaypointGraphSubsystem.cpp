@@ -0,0 +1,270 @@
+#include "WaypointGraphSubsystem.h"
+#include "WaypointActor.h"
+#include "WaypointRegistrySubsystem.h"
+#include "Algo/Reverse.h"
+#include "Async/Async.h"
+#include "Engine/World.h"
+#include "NavigationData.h"
+#include "NavigationSystem.h"
+#include "TimerManager.h"
+#include "HAL/IConsoleManager.h"
+
+// How many of its nearest waypoints each waypoint is connected to in the WaypointGraph.
+static TAutoConsoleVariable<int32> CVarWaypointGraphMaxNeighbors(
+	TEXT("waypoint.Graph.MaxNeighbors"),
+	4,
+	TEXT("How many of its nearest waypoints each waypoint is connected to when the waypoint graph is built."),
+	ECVF_Default);
+
+// How much, in units, is added to the cost of an edge for every waypoint it skips over.
+static TAutoConsoleVariable<float> CVarWaypointGraphSkipCost(
+	TEXT("waypoint.Graph.SkipCost"),
+	0.f,
+	TEXT("How much is added to the cost of an edge in the waypoint graph for every waypoint it skips over. 0 lets leads take the shortest route, a large value makes them visit the waypoints in order."),
+	ECVF_Default);
+
+/**
+ * Returns the points of the leg of the route that ends at the waypoint at `RouteIndex`.
+ */
+bool FWaypointRoute::GetLegPoints(int32 RouteIndex, TArray<FVector>& OutPoints) const
+{
+	if (RouteIndex <= 0 || RouteIndex >= PolylineIndices.Num()) return false;
+
+	OutPoints.Reset();
+	for (int32 Index = PolylineIndices[RouteIndex - 1]; Index <= PolylineIndices[RouteIndex]; ++Index) OutPoints.Add(Polyline[Index]);
+
+	return OutPoints.Num() > 1;
+}
+
+/**
+ * Finds the cheapest route between two waypoints.
+ */
+FWaypointRoute FWaypointGraph::FindRoute(int32 StartWaypointNumber, int32 EndWaypointNumber) const
+{
+	FWaypointRoute Route;
+
+	const int32 StartNode = FindNode(StartWaypointNumber);
+	const int32 EndNode = FindNode(EndWaypointNumber);
+	if (StartNode == INDEX_NONE || EndNode == INDEX_NONE) return Route;
+
+	// Run Dijkstra's algorithm over the precomputed navmesh costs.
+	TArray<float> Costs;
+	TArray<int32> Previous;
+	TArray<int32> PreviousEdge;
+	Costs.Init(MAX_FLT, WaypointNumbers.Num());
+	Previous.Init(INDEX_NONE, WaypointNumbers.Num());
+	PreviousEdge.Init(INDEX_NONE, WaypointNumbers.Num());
+
+	typedef TPair<float, int32> FOpenNode;
+	const auto CheapestFirst = [](const FOpenNode& A, const FOpenNode& B) { return A.Key < B.Key; };
+
+	TArray<FOpenNode> Open;
+	Costs[StartNode] = 0.f;
+	Open.HeapPush(FOpenNode(0.f, StartNode), CheapestFirst);
+
+	while (Open.Num() > 0)
+	{
+		FOpenNode Current;
+		Open.HeapPop(Current, CheapestFirst, false);
+
+		if (Current.Value == EndNode) break;
+		if (Current.Key > Costs[Current.Value]) continue;
+
+		for (int32 EdgeIndex = 0; EdgeIndex < Edges[Current.Value].Num(); ++EdgeIndex)
+		{
+			const FWaypointGraphEdge& Edge = Edges[Current.Value][EdgeIndex];
+			const float Cost = Current.Key + Edge.Cost;
+
+			if (Cost < Costs[Edge.To])
+			{
+				Costs[Edge.To] = Cost;
+				Previous[Edge.To] = Current.Value;
+				PreviousEdge[Edge.To] = EdgeIndex;
+				Open.HeapPush(FOpenNode(Cost, Edge.To), CheapestFirst);
+			}
+		}
+	}
+
+	if (Costs[EndNode] == MAX_FLT) return Route;
+
+	// Walk back from the end to get the nodes along the route.
+	TArray<int32> Nodes;
+	for (int32 Node = EndNode; Node != INDEX_NONE; Node = Previous[Node]) Nodes.Insert(Node, 0);
+
+	// Stitch the edge polylines together into one polyline for the whole route.
+	Route.Polyline.Add(Locations[StartNode]);
+	Route.PolylineIndices.Add(0);
+	Route.WaypointNumbers.Add(WaypointNumbers[StartNode]);
+
+	for (int32 Index = 1; Index < Nodes.Num(); ++Index)
+	{
+		const FWaypointGraphEdge& Edge = Edges[Nodes[Index - 1]][PreviousEdge[Nodes[Index]]];
+
+		// The first point of each edge is the end of the previous one so skip it.
+		for (int32 PointIndex = 1; PointIndex < Edge.Polyline.Num(); ++PointIndex) Route.Polyline.Add(Edge.Polyline[PointIndex]);
+
+		Route.PolylineIndices.Add(Route.Polyline.Num() - 1);
+		Route.WaypointNumbers.Add(WaypointNumbers[Nodes[Index]]);
+	}
+
+	return Route;
+}
+
+/**
+ * Called when the WaypointGraphSubsystem is created for a world.
+ */
+void UWaypointGraphSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	// Build the WaypointGraph whenever the level's WaypointActors are registered.
+	UWaypointRegistrySubsystem* WaypointRegistry = Cast<UWaypointRegistrySubsystem>(Collection.InitializeDependency(UWaypointRegistrySubsystem::StaticClass()));
+	if (WaypointRegistry != nullptr) WaypointsChangedHandle = WaypointRegistry->OnWaypointsChanged.AddUObject(this, &UWaypointGraphSubsystem::OnWaypointsChanged);
+}
+
+/**
+ * Called when the world the WaypointGraphSubsystem belongs to is torn down.
+ */
+void UWaypointGraphSubsystem::Deinitialize()
+{
+	UWaypointRegistrySubsystem* WaypointRegistry = GetWorld()->GetSubsystem<UWaypointRegistrySubsystem>();
+	if (WaypointRegistry != nullptr) WaypointRegistry->OnWaypointsChanged.Remove(WaypointsChangedHandle);
+
+	Graph.Reset();
+
+	Super::Deinitialize();
+}
+
+/**
+ * Called when a WaypointActor is added to or removed from the WaypointRegistrySubsystem
+ * to rebuild the WaypointGraph on the next tick.
+ */
+void UWaypointGraphSubsystem::OnWaypointsChanged()
+{
+	UWorld* World = GetWorld();
+	if (bIsBuildPending || World == nullptr || !World->IsGameWorld()) return;
+
+	bIsBuildPending = true;
+	World->GetTimerManager().SetTimerForNextTick(FTimerDelegate::CreateUObject(this, &UWaypointGraphSubsystem::BuildGraph));
+}
+
+/**
+ * Finds the navmesh paths between the waypoints in the WaypointRegistrySubsystem and
+ * builds the WaypointGraph.
+ */
+void UWaypointGraphSubsystem::BuildGraph()
+{
+	bIsBuildPending = false;
+
+	UWorld* World = GetWorld();
+	if (World == nullptr) return;
+
+	UWaypointRegistrySubsystem* WaypointRegistry = World->GetSubsystem<UWaypointRegistrySubsystem>();
+	if (WaypointRegistry == nullptr) return;
+
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(World);
+	const ANavigationData* NavData = NavSys != nullptr ? NavSys->GetDefaultNavDataInstance() : nullptr;
+
+	// The registry already has the WaypointActors sorted by their WaypointNumbers.
+	const TArray<AWaypointActor*>& Waypoints = WaypointRegistry->GetWaypoints();
+
+	TSharedPtr<FWaypointGraph, ESPMode::ThreadSafe> NewGraph = MakeShared<FWaypointGraph, ESPMode::ThreadSafe>();
+	for (AWaypointActor* Waypoint : Waypoints)
+	{
+		NewGraph->WaypointNumbers.Add(Waypoint->WaypointNumber);
+		NewGraph->Locations.Add(Waypoint->GetActorLocation());
+	}
+	NewGraph->Edges.SetNum(Waypoints.Num());
+
+	// Without a navmesh there are no paths between the waypoints so the graph only
+	// has nodes and no routes can be planned.
+	if (NavData == nullptr)
+	{
+		Graph = NewGraph;
+		return;
+	}
+
+	const int32 MaxNeighbors = CVarWaypointGraphMaxNeighbors.GetValueOnGameThread();
+	const float SkipCost = FMath::Max(0.f, CVarWaypointGraphSkipCost.GetValueOnGameThread());
+
+	for (int32 From = 0; From < Waypoints.Num(); ++From)
+	{
+		// Connect each waypoint to its nearest neighbors, which keeps the number of
+		// path queries linear in the number of waypoints.
+		TArray<int32> Neighbors;
+		for (int32 To = 0; To < Waypoints.Num(); ++To)
+		{
+			if (To != From) Neighbors.Add(To);
+		}
+
+		const FVector FromLocation = NewGraph->Locations[From];
+		Neighbors.Sort([&NewGraph, &FromLocation](int32 A, int32 B)
+		{
+			return FVector::DistSquared(FromLocation, NewGraph->Locations[A]) < FVector::DistSquared(FromLocation, NewGraph->Locations[B]);
+		});
+		if (Neighbors.Num() > MaxNeighbors) Neighbors.SetNum(MaxNeighbors);
+
+		// Always connect the next waypoint in the registry too, so that leads can still go
+		// through the waypoints in order when they aren't among each other's nearest.
+		if (From + 1 < Waypoints.Num()) Neighbors.AddUnique(From + 1);
+
+		for (int32 To : Neighbors)
+		{
+			// Skip the pair if it was already connected from the other side.
+			if (NewGraph->Edges[From].ContainsByPredicate([To](const FWaypointGraphEdge& Edge) { return Edge.To == To; })) continue;
+
+			FWaypointGraphEdge Edge;
+			Edge.To = To;
+
+			FPathFindingQuery Query(this, *NavData, FromLocation, NewGraph->Locations[To]);
+			FPathFindingResult Result = NavSys->FindPathSync(Query);
+
+			// Without a full navmesh path between the two waypoints there is no edge.
+			if (!Result.IsSuccessful() || !Result.Path.IsValid() || Result.IsPartial()) continue;
+
+			for (const FNavPathPoint& PathPoint : Result.Path->GetPathPoints()) Edge.Polyline.Add(PathPoint.Location);
+
+			// The registry is sorted by WaypointNumber so the distance between the indices is
+			// how many waypoints the edge skips over.
+			Edge.Cost = Result.Path->GetLength() + SkipCost * (FMath::Abs(To - From) - 1);
+
+			// Paths on the navmesh work both ways so add the reverse edge too.
+			FWaypointGraphEdge ReverseEdge;
+			ReverseEdge.To = From;
+			ReverseEdge.Cost = Edge.Cost;
+			ReverseEdge.Polyline = Edge.Polyline;
+			Algo::Reverse(ReverseEdge.Polyline);
+
+			NewGraph->Edges[From].Add(MoveTemp(Edge));
+			NewGraph->Edges[To].Add(MoveTemp(ReverseEdge));
+		}
+	}
+
+	Graph = NewGraph;
+}
+
+/**
+ * Plans the route between two waypoints on a worker thread.
+ */
+void UWaypointGraphSubsystem::PlanRoute(int32 StartWaypointNumber, int32 EndWaypointNumber, FOnWaypointRoutePlanned OnPlanned)
+{
+	if (!Graph.IsValid())
+	{
+		OnPlanned.ExecuteIfBound(FWaypointRoute());
+		return;
+	}
+
+	// The worker thread holds on to the WaypointGraph it was given so that a rebuild
+	// on the game thread can't change it while the route is being planned.
+	TSharedPtr<const FWaypointGraph, ESPMode::ThreadSafe> PlanningGraph = Graph;
+
+	Async(EAsyncExecution::ThreadPool, [PlanningGraph, StartWaypointNumber, EndWaypointNumber, OnPlanned]()
+	{
+		FWaypointRoute Route = PlanningGraph->FindRoute(StartWaypointNumber, EndWaypointNumber);
+
+		AsyncTask(ENamedThreads::GameThread, [Route = MoveTemp(Route), OnPlanned]()
+		{
+			OnPlanned.ExecuteIfBound(Route);
+		});
+	});
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WaypointGraphSubsystem.generated.h"
+
+class AWaypointActor;
+
+/**
+ * A connection between two waypoints in the WaypointGraph with the navmesh path
+ * between them found ahead of time.
+ */
+struct FWaypointGraphEdge
+{
+	// The index of the node that this edge leads to.
+	int32 To = INDEX_NONE;
+
+	// The length of the navmesh path between the two waypoints.
+	float Cost = 0.f;
+
+	// The points of the navmesh path between the two waypoints.
+	TArray<FVector> Polyline;
+};
+
+/**
+ * A planned route between two waypoints.
+ */
+struct FOLLOWLEADAI_API FWaypointRoute
+{
+	// The `WaypointNumber`s of the waypoints along the route, in order.
+	TArray<int32> WaypointNumbers;
+
+	// The points of the navmesh path along the whole route.
+	TArray<FVector> Polyline;
+
+	// For each waypoint along the route, the index in `Polyline` that the waypoint is at.
+	TArray<int32> PolylineIndices;
+
+	/**
+	 * Returns whether a route was found or not.
+	 */
+	bool IsValid() const { return WaypointNumbers.Num() > 0; }
+
+	/**
+	 * Returns the points of the leg of the route that ends at the waypoint at `RouteIndex`.
+	 *
+	 * @param RouteIndex The index in `WaypointNumbers` of the waypoint the leg ends at.
+	 * @param OutPoints The points of the leg.
+	 *
+	 * @return Whether there is a leg that ends at `RouteIndex` or not.
+	 */
+	bool GetLegPoints(int32 RouteIndex, TArray<FVector>& OutPoints) const;
+};
+
+/**
+ * The waypoints of a level and the navmesh paths between them. It only holds plain
+ * data so that routes can be planned on a worker thread.
+ */
+struct FOLLOWLEADAI_API FWaypointGraph
+{
+	// The `WaypointNumber` of each node.
+	TArray<int32> WaypointNumbers;
+
+	// The location of each node.
+	TArray<FVector> Locations;
+
+	// The edges leading out of each node.
+	TArray<TArray<FWaypointGraphEdge>> Edges;
+
+	/**
+	 * Returns the index of the node with the given `WaypointNumber`.
+	 */
+	int32 FindNode(int32 WaypointNumber) const { return WaypointNumbers.IndexOfByKey(WaypointNumber); }
+
+	/**
+	 * Finds the cheapest route between two waypoints.
+	 *
+	 * @param StartWaypointNumber The `WaypointNumber` of the waypoint to start at.
+	 * @param EndWaypointNumber The `WaypointNumber` of the waypoint to end at.
+	 *
+	 * @return The route, which is not valid if the waypoints aren't connected.
+	 */
+	FWaypointRoute FindRoute(int32 StartWaypointNumber, int32 EndWaypointNumber) const;
+};
+
+// Creates a delegate that's used to hand a planned route back to whoever asked for it.
+DECLARE_DELEGATE_OneParam(FOnWaypointRoutePlanned, const FWaypointRoute&);
+
+/**
+ * The WaypointGraphSubsystem builds the WaypointGraph once the level's WaypointActors
+ * have been registered and plans lead routes on a worker thread so that starting to
+ * lead never hitches the game thread.
+ */
+UCLASS()
+class FOLLOWLEADAI_API UWaypointGraphSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/**
+	 * Called when the WaypointGraphSubsystem is created for a world.
+	 */
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	/**
+	 * Called when the world the WaypointGraphSubsystem belongs to is torn down.
+	 */
+	virtual void Deinitialize() override;
+
+	/**
+	 * Finds the navmesh paths between the waypoints in the WaypointRegistrySubsystem and
+	 * builds the WaypointGraph.
+	 */
+	void BuildGraph();
+
+	/**
+	 * Plans the route between two waypoints on a worker thread. The callback is
+	 * called on the game thread once the route has been planned.
+	 *
+	 * @param StartWaypointNumber The `WaypointNumber` of the waypoint to start at.
+	 * @param EndWaypointNumber The `WaypointNumber` of the waypoint to end at.
+	 * @param OnPlanned Called with the route once it has been planned.
+	 */
+	void PlanRoute(int32 StartWaypointNumber, int32 EndWaypointNumber, FOnWaypointRoutePlanned OnPlanned);
+
+	/**
+	 * Returns whether the WaypointGraph has been built or not.
+	 */
+	bool IsGraphBuilt() const { return Graph.IsValid(); }
+
+private:
+	// The WaypointGraph, shared with any routes that are being planned on worker threads.
+	TSharedPtr<const FWaypointGraph, ESPMode::ThreadSafe> Graph;
+
+	// The handle of the callback that rebuilds the WaypointGraph when WaypointActors are
+	// added or removed.
+	FDelegateHandle WaypointsChangedHandle;
+
+	// Indicates whether a rebuild of the WaypointGraph has been scheduled for the next tick.
+	bool bIsBuildPending = false;
+
+	/**
+	 * Called when a WaypointActor is added to or removed from the WaypointRegistrySubsystem
+	 * to rebuild the WaypointGraph on the next tick. Waiting a tick means the level's
+	 * WaypointActors, which all register in the same frame, only cause one rebuild.
+	 */
+	void OnWaypointsChanged();
+};
@@ -0,0 +1,142 @@
+#include "WaypointRegistrySubsystem.h"
+#include "WaypointActor.h"
+#include "Algo/BinarySearch.h"
+#include "Components/BoxComponent.h"
+#include "HAL/IConsoleManager.h"
+
+// The size of each cell of the grid used to check whether allies are inside a waypoint.
+static TAutoConsoleVariable<float> CVarWaypointSpatialHashCellSize(
+	TEXT("waypoint.SpatialHash.CellSize"),
+	500.f,
+	TEXT("The size of each cell of the grid used to check whether allies have arrived at a waypoint."),
+	ECVF_Default);
+
+/**
+ * Called when the world the WaypointRegistrySubsystem belongs to is torn down.
+ */
+void UWaypointRegistrySubsystem::Deinitialize()
+{
+	Waypoints.Reset();
+	SpatialHash.Reset();
+	OnWaypointsChanged.Clear();
+
+	Super::Deinitialize();
+}
+
+/**
+ * Adds a WaypointActor to the registry, keeping the registry sorted by `WaypointNumber`.
+ *
+ * @param Waypoint The WaypointActor to add.
+ */
+void UWaypointRegistrySubsystem::RegisterWaypoint(AWaypointActor* Waypoint)
+{
+	if (Waypoint == nullptr || Waypoints.Contains(Waypoint)) return;
+
+	// Insert the WaypointActor after any others with the same or lower `WaypointNumber`
+	// so that the registry never needs to be sorted as a whole.
+	const int32 InsertIndex = Algo::UpperBoundBy(Waypoints, Waypoint->WaypointNumber, [](const AWaypointActor* Other) { return Other->WaypointNumber; });
+	Waypoints.Insert(Waypoint, InsertIndex);
+
+	RebuildSpatialHash();
+	OnWaypointsChanged.Broadcast();
+}
+
+/**
+ * Removes a WaypointActor from the registry.
+ *
+ * @param Waypoint The WaypointActor to remove.
+ */
+void UWaypointRegistrySubsystem::UnregisterWaypoint(AWaypointActor* Waypoint)
+{
+	if (Waypoints.Remove(Waypoint) == 0) return;
+
+	RebuildSpatialHash();
+	OnWaypointsChanged.Broadcast();
+}
+
+/**
+ * Returns the WaypointActor with the given `WaypointNumber`, or a nullptr if there isn't one.
+ *
+ * @param WaypointNumber The `WaypointNumber` of the WaypointActor to find.
+ */
+AWaypointActor* UWaypointRegistrySubsystem::FindWaypoint(int32 WaypointNumber) const
+{
+	const int32 Index = FindWaypointIndex(WaypointNumber);
+
+	return Index != INDEX_NONE ? Waypoints[Index] : nullptr;
+}
+
+/**
+ * Returns the index in `GetWaypoints` of the WaypointActor with the given `WaypointNumber`.
+ *
+ * @param WaypointNumber The `WaypointNumber` of the WaypointActor to find.
+ */
+int32 UWaypointRegistrySubsystem::FindWaypointIndex(int32 WaypointNumber) const
+{
+	// The registry is sorted so we can binary search it instead of keeping a map.
+	const int32 Index = Algo::LowerBoundBy(Waypoints, WaypointNumber, [](const AWaypointActor* Waypoint) { return Waypoint->WaypointNumber; });
+
+	return Waypoints.IsValidIndex(Index) && Waypoints[Index]->WaypointNumber == WaypointNumber ? Index : INDEX_NONE;
+}
+
+/**
+ * Returns the WaypointActor that comes after the given one on the way to the end WaypointActor.
+ *
+ * @param WaypointNumber The `WaypointNumber` of the WaypointActor to start from.
+ * @param EndWaypointNumber The `WaypointNumber` of the WaypointActor to end at.
+ */
+AWaypointActor* UWaypointRegistrySubsystem::FindNextWaypoint(int32 WaypointNumber, int32 EndWaypointNumber) const
+{
+	const int32 NextIndex = GetNextWaypointIndex(FindWaypointIndex(WaypointNumber), WaypointNumber, EndWaypointNumber, Waypoints.Num());
+
+	return NextIndex != INDEX_NONE ? Waypoints[NextIndex] : nullptr;
+}
+
+/**
+ * Returns the index of the waypoint that comes after the one at `Index` on the way to the
+ * end waypoint, in any list of waypoints sorted by `WaypointNumber`.
+ *
+ * @param Index The index of the waypoint to start from.
+ * @param WaypointNumber The `WaypointNumber` of the waypoint to start from.
+ * @param EndWaypointNumber The `WaypointNumber` of the waypoint to end at.
+ * @param NumWaypoints The number of waypoints in the list.
+ */
+int32 UWaypointRegistrySubsystem::GetNextWaypointIndex(int32 Index, int32 WaypointNumber, int32 EndWaypointNumber, int32 NumWaypoints)
+{
+	if (Index == INDEX_NONE || WaypointNumber == EndWaypointNumber) return INDEX_NONE;
+
+	// The list is sorted so the neighbour on the end's side is the next waypoint.
+	const int32 NextIndex = EndWaypointNumber > WaypointNumber ? Index + 1 : Index - 1;
+
+	return NextIndex >= 0 && NextIndex < NumWaypoints ? NextIndex : INDEX_NONE;
+}
+
+/**
+ * Returns whether a box, such as the bounds of an AllyCharacter, overlaps a WaypointActor.
+ *
+ * @param Waypoint The WaypointActor to check.
+ * @param Box The box to check.
+ */
+bool UWaypointRegistrySubsystem::IsOverlappingWaypoint(const AWaypointActor* Waypoint, const FBox& Box) const
+{
+	if (Waypoint == nullptr) return false;
+
+	return SpatialHash.IsOverlappingWaypoint(FindWaypointIndex(Waypoint->WaypointNumber), Box);
+}
+
+/**
+ * Rebuilds the `SpatialHash` after a WaypointActor was added or removed.
+ */
+void UWaypointRegistrySubsystem::RebuildSpatialHash()
+{
+	TArray<FBox> WaypointBounds;
+	WaypointBounds.Reserve(Waypoints.Num());
+
+	for (const AWaypointActor* Waypoint : Waypoints)
+	{
+		const UBoxComponent* BoxCollider = Waypoint->WaypointBoxCollider;
+		WaypointBounds.Add(BoxCollider != nullptr ? BoxCollider->Bounds.GetBox() : FBox(Waypoint->GetActorLocation(), Waypoint->GetActorLocation()));
+	}
+
+	SpatialHash.Build(WaypointBounds, CVarWaypointSpatialHashCellSize.GetValueOnGameThread());
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WaypointSpatialHash.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WaypointRegistrySubsystem.generated.h"
+
+class AWaypointActor;
+
+// Creates a delegate that's used to tell anything that depends on the waypoints in
+// the level that a WaypointActor has been added or removed.
+DECLARE_MULTICAST_DELEGATE(FOnWaypointsChanged);
+
+/**
+ * The WaypointRegistrySubsystem keeps one sorted list of every WaypointActor in the
+ * level that is shared by every AllyCharacter, so that AllyCharacters don't have to
+ * search the level for WaypointActors or keep their own copy of them.
+ */
+UCLASS()
+class FOLLOWLEADAI_API UWaypointRegistrySubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/**
+	 * Called when the world the WaypointRegistrySubsystem belongs to is torn down.
+	 */
+	virtual void Deinitialize() override;
+
+	/**
+	 * Adds a WaypointActor to the registry, keeping the registry sorted by `WaypointNumber`.
+	 *
+	 * @param Waypoint The WaypointActor to add.
+	 */
+	void RegisterWaypoint(AWaypointActor* Waypoint);
+
+	/**
+	 * Removes a WaypointActor from the registry.
+	 *
+	 * @param Waypoint The WaypointActor to remove.
+	 */
+	void UnregisterWaypoint(AWaypointActor* Waypoint);
+
+	/**
+	 * Returns the WaypointActor with the given `WaypointNumber`, or a nullptr if there isn't one.
+	 *
+	 * @param WaypointNumber The `WaypointNumber` of the WaypointActor to find.
+	 */
+	AWaypointActor* FindWaypoint(int32 WaypointNumber) const;
+
+	/**
+	 * Returns the index in `GetWaypoints` of the WaypointActor with the given
+	 * `WaypointNumber`, or `INDEX_NONE` if there isn't one.
+	 *
+	 * @param WaypointNumber The `WaypointNumber` of the WaypointActor to find.
+	 */
+	int32 FindWaypointIndex(int32 WaypointNumber) const;
+
+	/**
+	 * Returns the WaypointActor that comes after the given one on the way to the end WaypointActor,
+	 * counting up or down depending on which side the end is on. Gaps in the numbering are skipped.
+	 *
+	 * @param WaypointNumber The `WaypointNumber` of the WaypointActor to start from.
+	 * @param EndWaypointNumber The `WaypointNumber` of the WaypointActor to end at.
+	 *
+	 * @return The next WaypointActor, or a nullptr if `WaypointNumber` is the end or isn't registered.
+	 */
+	AWaypointActor* FindNextWaypoint(int32 WaypointNumber, int32 EndWaypointNumber) const;
+
+	/**
+	 * Returns the index of the waypoint that comes after the one at `Index` on the way to the
+	 * end waypoint, in any list of waypoints sorted by `WaypointNumber`. This is shared with
+	 * the FAllyFollowLeadSim so that it steps through waypoints the same way as the game.
+	 *
+	 * @param Index The index of the waypoint to start from.
+	 * @param WaypointNumber The `WaypointNumber` of the waypoint to start from.
+	 * @param EndWaypointNumber The `WaypointNumber` of the waypoint to end at.
+	 * @param NumWaypoints The number of waypoints in the list.
+	 *
+	 * @return The index of the next waypoint, or INDEX_NONE if `WaypointNumber` is the end or there are no more waypoints.
+	 */
+	static int32 GetNextWaypointIndex(int32 Index, int32 WaypointNumber, int32 EndWaypointNumber, int32 NumWaypoints);
+
+	/**
+	 * Returns whether a box, such as the bounds of an AllyCharacter, overlaps a WaypointActor.
+	 *
+	 * @param Waypoint The WaypointActor to check.
+	 * @param Box The box to check.
+	 */
+	bool IsOverlappingWaypoint(const AWaypointActor* Waypoint, const FBox& Box) const;
+
+	/**
+	 * Returns every WaypointActor in the level sorted by `WaypointNumber`.
+	 */
+	const TArray<AWaypointActor*>& GetWaypoints() const { return Waypoints; }
+
+	/**
+	 * Broadcast when a WaypointActor is added to or removed from the registry.
+	 */
+	FOnWaypointsChanged OnWaypointsChanged;
+
+private:
+	// Every WaypointActor in the level sorted by `WaypointNumber`.
+	UPROPERTY()
+	TArray<AWaypointActor*> Waypoints;
+
+	// The grid of the bounds of every WaypointActor, indexed the same way as `Waypoints`.
+	FWaypointSpatialHash SpatialHash;
+
+	/**
+	 * Rebuilds the `SpatialHash` after a WaypointActor was added or removed.
+	 */
+	void RebuildSpatialHash();
+};
@@ -0,0 +1,80 @@
+#include "WaypointSpatialHash.h"
+
+/**
+ * Rebuilds the grid from the bounds of every waypoint.
+ *
+ * @param WaypointBounds The bounds of each waypoint, indexed the same way as the WaypointRegistrySubsystem.
+ * @param InCellSize The size of each cell of the grid.
+ */
+void FWaypointSpatialHash::Build(const TArray<FBox>& WaypointBounds, float InCellSize)
+{
+	CellSize = FMath::Max(InCellSize, 1.f);
+	Bounds = WaypointBounds;
+	Cells.Reset();
+
+	// Add each waypoint to every cell that its bounds overlap.
+	for (int32 WaypointIndex = 0; WaypointIndex < Bounds.Num(); ++WaypointIndex)
+	{
+		const FIntVector MinCell = GetCell(Bounds[WaypointIndex].Min);
+		const FIntVector MaxCell = GetCell(Bounds[WaypointIndex].Max);
+
+		for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+		{
+			for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+			{
+				for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z)
+				{
+					Cells.FindOrAdd(FIntVector(X, Y, Z)).Add(WaypointIndex);
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Removes every waypoint from the grid.
+ */
+void FWaypointSpatialHash::Reset()
+{
+	Bounds.Reset();
+	Cells.Reset();
+}
+
+/**
+ * Returns whether a box overlaps the bounds of a waypoint.
+ *
+ * @param WaypointIndex The index of the waypoint in the WaypointRegistrySubsystem.
+ * @param Box The box to check, such as the bounds of an AllyCharacter.
+ */
+bool FWaypointSpatialHash::IsOverlappingWaypoint(int32 WaypointIndex, const FBox& Box) const
+{
+	if (!Bounds.IsValidIndex(WaypointIndex)) return false;
+
+	// Look at the cells that the box touches, which is only a handful as long as the
+	// cells are bigger than the box, to see if the waypoint is listed in any of them
+	// before doing the exact check against its bounds.
+	const FIntVector MinCell = GetCell(Box.Min);
+	const FIntVector MaxCell = GetCell(Box.Max);
+
+	for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+		{
+			for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z)
+			{
+				const TArray<int32>* CellWaypoints = Cells.Find(FIntVector(X, Y, Z));
+				if (CellWaypoints != nullptr && CellWaypoints->Contains(WaypointIndex)) return Bounds[WaypointIndex].Intersect(Box);
+			}
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Returns the coordinates of the cell that a location is in.
+ */
+FIntVector FWaypointSpatialHash::GetCell(const FVector& Location) const
+{
+	return FIntVector(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize), FMath::FloorToInt(Location.Z / CellSize));
+}
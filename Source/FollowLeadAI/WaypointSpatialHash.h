@@ -0,0 +1,48 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * A uniform grid over the bounds of the waypoints in a level. Each cell lists the
+ * waypoints whose bounds overlap it so that checking whether something is inside
+ * a waypoint only has to look at the waypoints in one cell.
+ */
+struct FOLLOWLEADAI_API FWaypointSpatialHash
+{
+public:
+	/**
+	 * Rebuilds the grid from the bounds of every waypoint.
+	 *
+	 * @param WaypointBounds The bounds of each waypoint, indexed the same way as the WaypointRegistrySubsystem.
+	 * @param InCellSize The size of each cell of the grid.
+	 */
+	void Build(const TArray<FBox>& WaypointBounds, float InCellSize);
+
+	/**
+	 * Removes every waypoint from the grid.
+	 */
+	void Reset();
+
+	/**
+	 * Returns whether a box overlaps the bounds of a waypoint.
+	 *
+	 * @param WaypointIndex The index of the waypoint in the WaypointRegistrySubsystem.
+	 * @param Box The box to check, such as the bounds of an AllyCharacter.
+	 */
+	bool IsOverlappingWaypoint(int32 WaypointIndex, const FBox& Box) const;
+
+private:
+	// The size of each cell of the grid.
+	float CellSize = 500.f;
+
+	// The bounds of each waypoint.
+	TArray<FBox> Bounds;
+
+	// The indices of the waypoints whose bounds overlap each cell, keyed by cell coordinates.
+	TMap<FIntVector, TArray<int32>> Cells;
+
+	/**
+	 * Returns the coordinates of the cell that a location is in.
+	 */
+	FIntVector GetCell(const FVector& Location) const;
+};